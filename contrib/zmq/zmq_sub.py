@@ -47,6 +47,7 @@ class ZMQHandler():
         self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "hashtx")
         self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "rawblock")
         self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "rawtx")
+        self.zmqSubSocket.setsockopt_string(zmq.SUBSCRIBE, "rawflodata")
         self.zmqSubSocket.connect("tcp://127.0.0.1:%i" % port)
 
     async def handle(self) :
@@ -69,6 +70,10 @@ class ZMQHandler():
         elif topic == b"rawtx":
             print('- RAW TX ('+sequence+') -')
             print(binascii.hexlify(body))
+        elif topic == b"rawflodata":
+            print('- RAW FLODATA ('+sequence+') -')
+            print(binascii.hexlify(body[:32]), binascii.hexlify(body[32:64]))
+            print(body[64:])
         # schedule ourselves to receive the next message
         asyncio.ensure_future(self.handle())
 
@@ -5,6 +5,7 @@
 
 #include "bench.h"
 
+#include "chainparams.h"
 #include "crypto/sha256.h"
 #include "key.h"
 #include "validation.h"
@@ -19,6 +20,7 @@ main(int argc, char** argv)
     ECC_Start();
     SetupEnvironment();
     fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::MAIN); // some benchmarks use Params()
 
     benchmark::BenchRunner::RunAll();
 
@@ -0,0 +1,37 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "utilstrencodings.h"
+
+#include <string>
+#include <vector>
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+} // namespace block_bench
+
+// Hex conversion of a full block, as done by getblock verbosity 0, submitblock
+// and the REST .hex endpoints.
+
+static void HexStrBlock(benchmark::State& state)
+{
+    const std::vector<unsigned char> vBlock(std::begin(block_bench::block413567), std::end(block_bench::block413567));
+    while (state.KeepRunning()) {
+        HexStr(vBlock.begin(), vBlock.end());
+    }
+}
+
+static void ParseHexBlock(benchmark::State& state)
+{
+    const std::string strHex = HexStr(std::begin(block_bench::block413567), std::end(block_bench::block413567));
+    while (state.KeepRunning()) {
+        ParseHex(strHex);
+    }
+}
+
+BENCHMARK(HexStrBlock);
+BENCHMARK(ParseHexBlock);
@@ -0,0 +1,67 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "core_io.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "utilstrencodings.h"
+#include "version.h"
+
+#include <univalue.h>
+
+namespace block_bench {
+#include "bench/data/block413567.raw.h"
+} // namespace block_bench
+
+// Request bodies as received by the RPC server: a submitblock call carrying a
+// full block as hex, and a verbose block as returned by getblock.
+
+static void RpcParseSubmitBlock(benchmark::State& state)
+{
+    const std::string strRequest = "{\"jsonrpc\":\"1.0\",\"id\":\"bench\",\"method\":\"submitblock\",\"params\":[\"" +
+        HexStr(std::begin(block_bench::block413567), std::end(block_bench::block413567)) + "\"]}";
+
+    while (state.KeepRunning()) {
+        UniValue val;
+        assert(val.read(strRequest));
+    }
+}
+
+static void RpcParseVerboseBlock(benchmark::State& state)
+{
+    CDataStream stream((const char*)block_bench::block413567,
+            (const char*)&block_bench::block413567[sizeof(block_bench::block413567)],
+            SER_NETWORK, PROTOCOL_VERSION);
+    CBlock block;
+    stream >> block;
+
+    UniValue txs(UniValue::VARR);
+    for (const auto& tx : block.vtx) {
+        UniValue objTx(UniValue::VOBJ);
+        TxToUniv(*tx, block.GetHash(), objTx);
+        txs.push_back(objTx);
+    }
+    const std::string strBlock = txs.write();
+
+    while (state.KeepRunning()) {
+        UniValue val;
+        assert(val.read(strBlock));
+    }
+}
+
+static void RpcValueFromAmount(benchmark::State& state)
+{
+    CAmount nValue = 0;
+    while (state.KeepRunning()) {
+        ValueFromAmount(nValue);
+        nValue += 123456789;
+    }
+}
+
+BENCHMARK(RpcParseSubmitBlock);
+BENCHMARK(RpcParseVerboseBlock);
+BENCHMARK(RpcValueFromAmount);
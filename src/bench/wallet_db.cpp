@@ -0,0 +1,64 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "fs.h"
+#include "tinyformat.h"
+#include "wallet/db.h"
+#include "wallet/walletdb.h"
+
+/**
+ * A Berkeley DB environment and wallet file on disk, opened the way a running
+ * wallet opens them, so that writes pay for the same log syncs and
+ * checkpoints.
+ */
+class BenchWalletDB
+{
+public:
+    fs::path path;
+    CDBEnv env;
+    CWalletDBWrapper dbw;
+
+    BenchWalletDB() : path(fs::temp_directory_path() / fs::unique_path("flo_bench_walletdb_%%%%-%%%%")), dbw(&env, "wallet_bench.dat")
+    {
+        fs::create_directories(path);
+        bool fOpened = env.Open(path);
+        assert(fOpened);
+    }
+
+    ~BenchWalletDB()
+    {
+        env.Flush(true);
+        env.Close();
+        fs::remove_all(path);
+    }
+};
+
+// Every wallet mutation writes through its own CWalletDB, and closing it
+// flushes the database: this is the write throughput of a busy wallet.
+static void WalletDBWritePerHandle(benchmark::State& state)
+{
+    BenchWalletDB db;
+    uint64_t n = 0;
+    while (state.KeepRunning()) {
+        CWalletDB walletdb(db.dbw, "cr+");
+        walletdb.WriteName(strprintf("address%d", n++), "label");
+    }
+}
+
+// The same writes through a single handle, flushed once at the end
+static void WalletDBWriteOneHandle(benchmark::State& state)
+{
+    BenchWalletDB db;
+    CWalletDB walletdb(db.dbw, "cr+");
+    uint64_t n = 0;
+    while (state.KeepRunning()) {
+        walletdb.WriteName(strprintf("address%d", n++), "label");
+    }
+}
+
+BENCHMARK(WalletDBWritePerHandle);
+BENCHMARK(WalletDBWriteOneHandle);
@@ -14,6 +14,7 @@
 class CBlock;
 class CScript;
 class CTransaction;
+class JSONStreamWriter;
 struct CMutableTransaction;
 class uint256;
 class UniValue;
@@ -33,5 +34,8 @@ std::string FormatScript(const CScript& script);
 std::string EncodeHexTx(const CTransaction& tx, const int serializeFlags = 0);
 void ScriptPubKeyToUniv(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 void TxToUniv(const CTransaction& tx, const uint256& hashBlock, UniValue& entry, bool include_hex = true, int serialize_flags = 0);
+/** Streaming counterparts of the above; they write keys into an object the caller has already opened */
+void ScriptPubKeyToJSONStream(const CScript& scriptPubKey, JSONStreamWriter& out, bool fIncludeHex);
+void TxToJSONStream(const CTransaction& tx, const uint256& hashBlock, JSONStreamWriter& out, bool include_hex = true, int serialize_flags = 0);
 
 #endif // BITCOIN_CORE_IO_H
@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "jsonstream.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "serialize.h"
@@ -23,8 +24,22 @@ UniValue ValueFromAmount(const CAmount& amount)
     int64_t n_abs = (sign ? -amount : amount);
     int64_t quotient = n_abs / COIN;
     int64_t remainder = n_abs % COIN;
-    return UniValue(UniValue::VNUM,
-            strprintf("%s%d.%08d", sign ? "-" : "", quotient, remainder));
+    // Same as strprintf("%s%d.%08d", ...), without going through tinyformat
+    char buf[32];
+    char* const end = buf + sizeof(buf);
+    char* p = end;
+    for (int i = 0; i < 8; i++) {
+        *--p = '0' + (remainder % 10);
+        remainder /= 10;
+    }
+    *--p = '.';
+    do {
+        *--p = '0' + (quotient % 10);
+        quotient /= 10;
+    } while (quotient);
+    if (sign)
+        *--p = '-';
+    return UniValue(UniValue::VNUM, std::string(p, end));
 }
 
 std::string FormatScript(const CScript& script)
@@ -214,3 +229,90 @@ void TxToUniv(const CTransaction& tx, const uint256& hashBlock, UniValue& entry,
         entry.pushKV("hex", EncodeHexTx(tx, serialize_flags)); // the hex-encoded transaction. used the name "hex" to be consistent with the verbose output of "getrawtransaction".
     }
 }
+
+void ScriptPubKeyToJSONStream(const CScript& scriptPubKey, JSONStreamWriter& out, bool fIncludeHex)
+{
+    txnouttype type;
+    std::vector<CTxDestination> addresses;
+    int nRequired;
+
+    out.KV("asm", ScriptToAsmStr(scriptPubKey));
+    if (fIncludeHex)
+        out.KV("hex", HexStr(scriptPubKey.begin(), scriptPubKey.end()));
+
+    if (!ExtractDestinations(scriptPubKey, type, addresses, nRequired)) {
+        out.KV("type", GetTxnOutputType(type));
+        return;
+    }
+
+    out.KV("reqSigs", nRequired);
+    out.KV("type", GetTxnOutputType(type));
+
+    out.Key("addresses");
+    out.BeginArray();
+    for (const CTxDestination& addr : addresses)
+        out.Value(CBitcoinAddress(addr).ToString());
+    out.EndArray();
+}
+
+void TxToJSONStream(const CTransaction& tx, const uint256& hashBlock, JSONStreamWriter& out, bool include_hex, int serialize_flags)
+{
+    out.KV("txid", tx.GetHash().GetHex());
+    out.KV("hash", tx.GetWitnessHash().GetHex());
+    out.KV("version", tx.nVersion);
+    out.KV("size", (int)::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION));
+    out.KV("vsize", (int64_t)((GetTransactionWeight(tx) + WITNESS_SCALE_FACTOR - 1) / WITNESS_SCALE_FACTOR));
+    out.KV("locktime", (int64_t)tx.nLockTime);
+
+    out.Key("vin");
+    out.BeginArray();
+    for (const CTxIn& txin : tx.vin) {
+        out.BeginObject();
+        if (tx.IsCoinBase())
+            out.KV("coinbase", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+        else {
+            out.KV("txid", txin.prevout.hash.GetHex());
+            out.KV("vout", (int64_t)txin.prevout.n);
+            out.Key("scriptSig");
+            out.BeginObject();
+            out.KV("asm", ScriptToAsmStr(txin.scriptSig, true));
+            out.KV("hex", HexStr(txin.scriptSig.begin(), txin.scriptSig.end()));
+            out.EndObject();
+            if (!txin.scriptWitness.IsNull()) {
+                out.Key("txinwitness");
+                out.BeginArray();
+                for (const auto& item : txin.scriptWitness.stack) {
+                    out.Value(HexStr(item.begin(), item.end()));
+                }
+                out.EndArray();
+            }
+        }
+        out.KV("sequence", (int64_t)txin.nSequence);
+        out.EndObject();
+    }
+    out.EndArray();
+
+    out.Key("vout");
+    out.BeginArray();
+    for (unsigned int i = 0; i < tx.vout.size(); i++) {
+        const CTxOut& txout = tx.vout[i];
+        out.BeginObject();
+        out.KV("value", ValueFromAmount(txout.nValue));
+        out.KV("n", (int64_t)i);
+        out.Key("scriptPubKey");
+        out.BeginObject();
+        ScriptPubKeyToJSONStream(txout.scriptPubKey, out, true);
+        out.EndObject();
+        out.EndObject();
+    }
+    out.EndArray();
+
+    out.KV("floData", tx.strFloData);
+
+    if (!hashBlock.IsNull())
+        out.KV("blockhash", hashBlock.GetHex());
+
+    if (include_hex) {
+        out.KV("hex", EncodeHexTx(tx, serialize_flags));
+    }
+}
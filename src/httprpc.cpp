@@ -8,6 +8,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -22,6 +23,11 @@
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
+/** Number of bytes at the start of a request body searched for its RPC method */
+static const size_t JSONRPC_WORK_KEY_SCAN = 256;
+
+/** Maximum number of threads working on the read-only calls of one batch request */
+static int nRPCBatchConcurrency = DEFAULT_RPC_BATCH_CONCURRENCY;
 
 /** Simple one-shot callback timer to be used by the RPC mechanism to e.g.
  * re-lock the wallet.
@@ -143,6 +149,100 @@ static bool RPCAuthorized(const std::string& strAuth, std::string& strAuthUserna
     return multiUserAuthorized(strUserPass);
 }
 
+/** Skip JSON whitespace starting at pos, returns the position of the next token or npos */
+static size_t SkipJSONSpace(const std::string& str, size_t pos)
+{
+    return str.find_first_not_of(" \t\r\n", pos);
+}
+
+/** Read the JSON string starting at pos (which must be a '"'). Strings with
+ * escapes are refused, since their decoded value cannot be compared cheaply.
+ * Returns the position just past the closing quote, or npos.
+ */
+static size_t ReadPlainJSONString(const std::string& str, size_t pos, std::string& strOut)
+{
+    for (size_t end = pos + 1; end < str.size(); end++) {
+        if (str[end] == '\\')
+            return std::string::npos;
+        if (str[end] == '"') {
+            strOut = str.substr(pos + 1, end - pos - 1);
+            return end + 1;
+        }
+    }
+    return std::string::npos;
+}
+
+/** Skip the JSON value starting at pos, tracking strings, escapes and nesting.
+ * Returns the position just past the value, or npos if it does not end within str.
+ */
+static size_t SkipJSONValue(const std::string& str, size_t pos)
+{
+    int nDepth = 0;
+    bool fString = false;
+    for (; pos < str.size(); pos++) {
+        const char c = str[pos];
+        if (fString) {
+            if (c == '\\')
+                pos++;
+            else if (c == '"') {
+                fString = false;
+                if (nDepth == 0)
+                    return pos + 1;
+            }
+        } else if (c == '"') {
+            fString = true;
+        } else if (c == '{' || c == '[') {
+            nDepth++;
+        } else if (c == '}' || c == ']') {
+            if (--nDepth < 0)
+                return std::string::npos;
+            if (nDepth == 0)
+                return pos + 1;
+        } else if (nDepth == 0 && (c == ',' || c == ' ' || c == '\t' || c == '\r' || c == '\n')) {
+            return pos; // end of a number or literal
+        }
+    }
+    return std::string::npos;
+}
+
+/** Work key of a JSON-RPC request: the method of a singleton request, looked up
+ * among the top-level keys of the first part of the body only. Batches, and
+ * requests whose method cannot be found unambiguously this way, get an empty
+ * key and are served by the default work class.
+ */
+static std::string JSONRPCWorkKey(HTTPRequest* req)
+{
+    const std::string strBody = req->PeekBody(JSONRPC_WORK_KEY_SCAN);
+    size_t pos = SkipJSONSpace(strBody, 0);
+    if (pos == std::string::npos || strBody[pos] != '{')
+        return "";
+    pos = SkipJSONSpace(strBody, pos + 1);
+    while (pos != std::string::npos && strBody[pos] == '"') {
+        std::string strKey;
+        pos = ReadPlainJSONString(strBody, pos, strKey);
+        if (pos == std::string::npos)
+            return "";
+        pos = SkipJSONSpace(strBody, pos);
+        if (pos == std::string::npos || strBody[pos] != ':')
+            return "";
+        pos = SkipJSONSpace(strBody, pos + 1);
+        if (pos == std::string::npos)
+            return "";
+        if (strKey == "method") {
+            // The first top-level method is the one JSONRPCRequest::parse uses
+            std::string strMethod;
+            if (strBody[pos] != '"' || ReadPlainJSONString(strBody, pos, strMethod) == std::string::npos)
+                return "";
+            return strMethod;
+        }
+        pos = SkipJSONSpace(strBody, SkipJSONValue(strBody, pos));
+        if (pos == std::string::npos || strBody[pos] != ',')
+            return "";
+        pos = SkipJSONSpace(strBody, pos + 1);
+    }
+    return "";
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -186,6 +286,20 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (tableRPC.hasStreamCommand(jreq.strMethod)) {
+                // Same layout as JSONRPCReply, with the result written as it is produced
+                HTTPWriteJSONStreamReply(req, [&jreq](JSONStreamWriter& out) {
+                    out.BeginObject();
+                    out.Key("result");
+                    tableRPC.executeStream(jreq, out);
+                    out.Key("error");
+                    out.Null();
+                    out.KV("id", jreq.id);
+                    out.EndObject();
+                });
+                return true;
+            }
+
             UniValue result = tableRPC.execute(jreq);
 
             // Send reply
@@ -193,7 +307,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            strReply = JSONRPCExecBatch(valRequest.get_array(), [req](const std::function<void(void)>& func) {
+                return req->EnqueueHelper(func);
+            }, nRPCBatchConcurrency);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
@@ -209,6 +325,44 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+void HTTPWriteJSONStreamReply(HTTPRequest* req, const std::function<void(JSONStreamWriter&)>& produce)
+{
+    bool fStarted = false;
+    JSONStreamWriter out([req, &fStarted](const std::string& chunk) {
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartChunkedReply(HTTP_OK);
+            fStarted = true;
+        }
+        return req->WriteReplyChunk(chunk);
+    });
+
+    try {
+        produce(out);
+        if (fStarted)
+            out.Flush();
+    } catch (const JSONStreamClosed&) {
+        LogPrint(BCLog::HTTP, "%s: client of %s went away, reply abandoned\n", __func__, req->GetURI());
+        req->EndChunkedReply();
+        return;
+    } catch (...) {
+        if (!fStarted)
+            throw;
+        // Too late for an error reply; end the body so the client sees a truncated document
+        LogPrintf("%s: error while streaming reply to %s, reply truncated\n", __func__, req->GetURI());
+        req->EndChunkedReply();
+        return;
+    }
+
+    if (fStarted) {
+        req->WriteReplyChunk("\n");
+        req->EndChunkedReply();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, out.ReleaseBuffer() + "\n");
+    }
+}
+
 static bool InitRPCAuthentication()
 {
     if (gArgs.GetArg("-rpcpassword", "") == "")
@@ -233,10 +387,12 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    nRPCBatchConcurrency = std::max((int)gArgs.GetArg("-rpcbatchconcurrency", DEFAULT_RPC_BATCH_CONCURRENCY), 1);
+
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, JSONRPCWorkKey);
 #ifdef ENABLE_WALLET
     // ifdef can be removed once we switch to better endpoint support and API versioning
-    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC);
+    RegisterHTTPHandler("/wallet/", false, HTTPReq_JSONRPC, JSONRPCWorkKey);
 #endif
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
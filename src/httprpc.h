@@ -6,9 +6,13 @@
 #ifndef BITCOIN_HTTPRPC_H
 #define BITCOIN_HTTPRPC_H
 
+#include <functional>
 #include <string>
 #include <map>
 
+class HTTPRequest;
+class JSONStreamWriter;
+
 /** Start HTTP RPC subsystem.
  * Precondition; HTTP and RPC has been started.
  */
@@ -33,4 +37,11 @@ void InterruptREST();
  */
 void StopREST();
 
+/** Send the JSON document written by produce as a successful reply. The body
+ * is sent with chunked transfer encoding once it outgrows one chunk. An
+ * exception thrown by produce before any output was sent is passed on to the
+ * caller, which can still send an error reply instead.
+ */
+void HTTPWriteJSONStreamReply(HTTPRequest* req, const std::function<void(JSONStreamWriter&)>& produce);
+
 #endif
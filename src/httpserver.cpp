@@ -30,6 +30,9 @@
 
 #include "support/events.h"
 
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+
 #ifdef EVENT__HAVE_NETINET_IN_H
 #include <netinet/in.h>
 #ifdef _XOPEN_SOURCE_EXTENDED
@@ -44,9 +47,10 @@ static const size_t MAX_HEADERS_SIZE = 8192;
 class HTTPWorkItem : public HTTPClosure
 {
 public:
-    HTTPWorkItem(std::unique_ptr<HTTPRequest> _req, const std::string &_path, const HTTPRequestHandler& _func):
+    HTTPWorkItem(std::unique_ptr<HTTPRequest> _req, WorkQueue<HTTPClosure>* queue, const std::string &_path, const HTTPRequestHandler& _func):
         req(std::move(_req)), path(_path), func(_func)
     {
+        req->workQueue = queue;
     }
     void operator()() override
     {
@@ -71,6 +75,8 @@ private:
     std::mutex cs;
     std::condition_variable cond;
     std::deque<std::unique_ptr<WorkItem>> queue;
+    //! Helpers of requests already being worked on; run first, not counted against maxDepth
+    std::deque<std::unique_ptr<WorkItem>> helpers;
     bool running;
     size_t maxDepth;
     int numThreads;
@@ -116,6 +122,20 @@ public:
         cond.notify_one();
         return true;
     }
+    /** Enqueue a helper of a request that one of the worker threads is handling.
+     * More helpers than worker threads would only start after the request has
+     * been worked off, so those are refused.
+     */
+    bool EnqueueHelper(WorkItem* item)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        if (!running || helpers.size() >= (size_t)numThreads) {
+            return false;
+        }
+        helpers.emplace_back(std::unique_ptr<WorkItem>(item));
+        cond.notify_one();
+        return true;
+    }
     /** Thread function */
     void Run()
     {
@@ -124,12 +144,13 @@ public:
             std::unique_ptr<WorkItem> i;
             {
                 std::unique_lock<std::mutex> lock(cs);
-                while (running && queue.empty())
+                while (running && queue.empty() && helpers.empty())
                     cond.wait(lock);
                 if (!running)
                     break;
-                i = std::move(queue.front());
-                queue.pop_front();
+                std::deque<std::unique_ptr<WorkItem>>& next = helpers.empty() ? queue : helpers;
+                i = std::move(next.front());
+                next.pop_front();
             }
             (*i)();
         }
@@ -150,32 +171,107 @@ public:
     }
 };
 
+/** Work item running a plain function, see HTTPRequest::EnqueueHelper */
+class HTTPFunctionWorkItem final : public HTTPClosure
+{
+public:
+    HTTPFunctionWorkItem(const std::function<void(void)>& _func):
+        func(_func)
+    {
+    }
+    void operator()() override
+    {
+        func();
+    }
+
+private:
+    std::function<void(void)> func;
+};
+
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler):
-        prefix(_prefix), exactMatch(_exactMatch), handler(_handler)
+    HTTPPathHandler(std::string _prefix, bool _exactMatch, HTTPRequestHandler _handler, HTTPWorkKeyFunction _workKey):
+        prefix(_prefix), exactMatch(_exactMatch), handler(_handler), workKey(_workKey)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPWorkKeyFunction workKey;
+};
+
+/** Progress of a chunked reply: bytes queued by the worker thread, and bytes
+ * known to be written to the client's socket by the event loop.
+ */
+struct HTTPReplyProgress
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nQueued;
+    //! Bytes handed to evhttp; only touched by the event loop
+    size_t nHandedOff;
+    size_t nWritten;
+    //! Connection closed or stalled; stop producing
+    bool fClosed;
+
+    HTTPReplyProgress() : nQueued(0), nHandedOff(0), nWritten(0), fClosed(false) {}
+};
+
+/** Priority class of HTTP requests, served from its own work queue by its own
+ * worker threads so that its requests never wait behind those of other classes.
+ */
+struct HTTPWorkClass
+{
+    std::string name;
+    //! URI prefixes (starting with '/') and work keys, such as RPC method names
+    std::vector<std::string> matches;
+    size_t depth;
+    int threads;
+    std::unique_ptr<WorkQueue<HTTPClosure>> queue;
+
+    bool Match(const std::string& strURI, const std::string& key) const
+    {
+        for (const std::string& match : matches) {
+            if (match[0] == '/' ? strURI.compare(0, match.size(), match) == 0 : match == key)
+                return true;
+        }
+        return false;
+    }
+};
+
+/** libevent event loop with its own HTTP server, run by one I/O thread.
+ * All loops accept connections from the same listening sockets. */
+struct HTTPEventLoop
+{
+    struct event_base* base;
+    struct evhttp* http;
+    //! Listening sockets as registered with this loop's evhttp
+    std::vector<evhttp_bound_socket *> boundSockets;
+    std::thread thread;
+    std::future<bool> result;
+
+    HTTPEventLoop() : base(nullptr), http(nullptr) {}
 };
 
 /** HTTP module state */
 
-//! libevent event loop
+//! libevent event loop of the first I/O thread, also used for timers
 static struct event_base* eventBase = 0;
-//! HTTP server
+//! HTTP server of the first I/O thread
 struct evhttp* eventHTTP = 0;
+//! All event loops; eventBase and eventHTTP belong to the first one
+static std::vector<HTTPEventLoop> eventLoops;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
 //! Work queue for handling longer requests off the event loop thread
 static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Priority classes with their own work queues; requests matching none go to workQueue
+static std::vector<HTTPWorkClass> workClasses;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
-//! Bound listening sockets
-std::vector<evhttp_bound_socket *> boundSockets;
+//! Seconds without send progress after which a chunked reply is given up
+static int64_t nReplyStallTimeout = DEFAULT_HTTP_SERVER_TIMEOUT;
 
 /** Check if a network address is allowed to access the HTTP server */
 static bool ClientAllowed(const CNetAddr& netaddr)
@@ -216,6 +312,54 @@ static bool InitHTTPAllowList()
     return true;
 }
 
+/** Parse the -rpcworkclass specifications */
+static bool InitHTTPWorkClasses()
+{
+    workClasses.clear();
+    std::vector<std::string> specs;
+    if (gArgs.IsArgSet("-rpcworkclass"))
+        specs = gArgs.GetArgs("-rpcworkclass");
+    else
+        specs.push_back(DEFAULT_HTTP_WORKCLASS);
+    for (const std::string& strSpec : specs) {
+        if (strSpec == "0") // -norpcworkclass
+            continue;
+        std::vector<std::string> fields;
+        boost::split(fields, strSpec, boost::is_any_of(":"));
+        HTTPWorkClass wc;
+        int32_t nDepth = 0;
+        if (fields.size() == 4) {
+            wc.name = fields[0];
+            boost::split(wc.matches, fields[3], boost::is_any_of(","));
+            wc.matches.erase(std::remove(wc.matches.begin(), wc.matches.end(), ""), wc.matches.end());
+        }
+        if (wc.name.empty() || wc.matches.empty() ||
+            !ParseInt32(fields[1], &nDepth) || nDepth < 1 ||
+            !ParseInt32(fields[2], &wc.threads) || wc.threads < 1) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf("Invalid -rpcworkclass specification: %s. Expected <name>:<depth>:<threads>:<match>[,<match>...], where each match is an RPC method or a URI prefix starting with '/'.", strSpec),
+                "", CClientUIInterface::MSG_ERROR);
+            return false;
+        }
+        wc.depth = nDepth;
+        workClasses.push_back(std::move(wc));
+    }
+    return true;
+}
+
+/** Work queue serving requests for strURI with the given work key */
+static WorkQueue<HTTPClosure>* SelectWorkQueue(const std::string& strURI, const std::string& key, std::string& strClass)
+{
+    for (const HTTPWorkClass& wc : workClasses) {
+        if (wc.Match(strURI, key)) {
+            strClass = wc.name;
+            return wc.queue.get();
+        }
+    }
+    strClass = "default";
+    return workQueue;
+}
+
 /** HTTP request method as string - use for logging only */
 static std::string RequestMethodString(HTTPRequest::RequestMethod m)
 {
@@ -274,14 +418,19 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
         }
     }
 
-    // Dispatch to worker thread
+    // Dispatch to worker thread of the request's work class
     if (i != iend) {
-        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        std::string strClass;
+        WorkQueue<HTTPClosure>* queue = SelectWorkQueue(strURI, i->workKey ? i->workKey(hreq.get()) : std::string(), strClass);
+        std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(std::move(hreq), queue, path, i->handler));
+        assert(queue);
+        if (queue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else {
-            LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            if (queue == workQueue)
+                LogPrintf("WARNING: request rejected because http work queue depth exceeded, it can be increased with the -rpcworkqueue= setting\n");
+            else
+                LogPrintf("WARNING: request rejected because depth of http work class %s exceeded, it can be increased with the -rpcworkclass= setting\n", strClass);
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
         }
     } else {
@@ -297,7 +446,7 @@ static void http_reject_request_cb(struct evhttp_request* req, void*)
 }
 
 /** Event dispatcher thread */
-static bool ThreadHTTP(struct event_base* base, struct evhttp* http)
+static bool ThreadHTTP(struct event_base* base)
 {
     RenameThread("bitcoin-http");
     LogPrint(BCLog::HTTP, "Entering http event loop\n");
@@ -308,7 +457,7 @@ static bool ThreadHTTP(struct event_base* base, struct evhttp* http)
 }
 
 /** Bind HTTP server to specified addresses */
-static bool HTTPBindAddresses(struct evhttp* http)
+static bool HTTPBindAddresses(HTTPEventLoop& loop)
 {
     int defaultPort = gArgs.GetArg("-rpcport", BaseParams().RPCPort());
     std::vector<std::pair<std::string, uint16_t> > endpoints;
@@ -335,14 +484,36 @@ static bool HTTPBindAddresses(struct evhttp* http)
     // Bind addresses
     for (std::vector<std::pair<std::string, uint16_t> >::iterator i = endpoints.begin(); i != endpoints.end(); ++i) {
         LogPrint(BCLog::HTTP, "Binding RPC on address %s port %i\n", i->first, i->second);
-        evhttp_bound_socket *bind_handle = evhttp_bind_socket_with_handle(http, i->first.empty() ? nullptr : i->first.c_str(), i->second);
+        evhttp_bound_socket *bind_handle = evhttp_bind_socket_with_handle(loop.http, i->first.empty() ? nullptr : i->first.c_str(), i->second);
         if (bind_handle) {
-            boundSockets.push_back(bind_handle);
+            loop.boundSockets.push_back(bind_handle);
         } else {
             LogPrintf("Binding RPC on address %s port %i failed.\n", i->first, i->second);
         }
     }
-    return !boundSockets.empty();
+    return !loop.boundSockets.empty();
+}
+
+/** Let another event loop accept connections on the sockets bound by the first one */
+static bool HTTPShareBoundSockets(const HTTPEventLoop& first, HTTPEventLoop& loop)
+{
+#ifdef WIN32
+    return false;
+#else
+    for (evhttp_bound_socket *socket : first.boundSockets) {
+        // Each evhttp closes its own descriptor when the socket is removed from it
+        evutil_socket_t fd = dup(evhttp_bound_socket_get_fd(socket));
+        if (fd < 0)
+            return false;
+        evhttp_bound_socket *handle = evhttp_accept_socket_with_handle(loop.http, fd);
+        if (!handle) {
+            close(fd);
+            return false;
+        }
+        loop.boundSockets.push_back(handle);
+    }
+    return true;
+#endif
 }
 
 /** Simple wrapper to set thread name and run work queue */
@@ -370,6 +541,11 @@ bool InitHTTPServer()
     if (!InitHTTPAllowList())
         return false;
 
+    if (!InitHTTPWorkClasses())
+        return false;
+
+    nReplyStallTimeout = gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT);
+
     if (gArgs.GetBoolArg("-rpcssl", false)) {
         uiInterface.ThreadSafeMessageBox(
             "SSL mode for RPC (-rpcssl) is no longer supported.",
@@ -392,34 +568,55 @@ bool InitHTTPServer()
     evthread_use_pthreads();
 #endif
 
-    raii_event_base base_ctr = obtain_event_base();
+    int ioThreads = std::max((long)gArgs.GetArg("-rpciothreads", DEFAULT_HTTP_IO_THREADS), 1L);
+#ifdef WIN32
+    // Listening sockets cannot be shared between event loops here
+    ioThreads = 1;
+#endif
+    eventLoops.resize(ioThreads);
+    for (HTTPEventLoop& loop : eventLoops) {
+        raii_event_base base_ctr = obtain_event_base();
+
+        /* Create a new evhttp object to handle requests. */
+        raii_evhttp http_ctr = obtain_evhttp(base_ctr.get());
+        struct evhttp* http = http_ctr.get();
+        if (!http) {
+            LogPrintf("couldn't create evhttp. Exiting.\n");
+            return false;
+        }
 
-    /* Create a new evhttp object to handle requests. */
-    raii_evhttp http_ctr = obtain_evhttp(base_ctr.get());
-    struct evhttp* http = http_ctr.get();
-    if (!http) {
-        LogPrintf("couldn't create evhttp. Exiting.\n");
-        return false;
-    }
+        evhttp_set_timeout(http, nReplyStallTimeout);
+        evhttp_set_max_headers_size(http, MAX_HEADERS_SIZE);
+        evhttp_set_max_body_size(http, MAX_SIZE);
+        evhttp_set_gencb(http, http_request_cb, nullptr);
 
-    evhttp_set_timeout(http, gArgs.GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT));
-    evhttp_set_max_headers_size(http, MAX_HEADERS_SIZE);
-    evhttp_set_max_body_size(http, MAX_SIZE);
-    evhttp_set_gencb(http, http_request_cb, nullptr);
+        // tranfer ownership to the event loop via .release()
+        loop.base = base_ctr.release();
+        loop.http = http_ctr.release();
+    }
 
-    if (!HTTPBindAddresses(http)) {
+    if (!HTTPBindAddresses(eventLoops[0])) {
         LogPrintf("Unable to bind any endpoint for RPC server\n");
         return false;
     }
+    for (size_t i = 1; i < eventLoops.size(); i++) {
+        if (!HTTPShareBoundSockets(eventLoops[0], eventLoops[i])) {
+            LogPrintf("Unable to share RPC listening sockets with HTTP I/O thread %u\n", i);
+            return false;
+        }
+    }
 
     LogPrint(BCLog::HTTP, "Initialized HTTP server\n");
     int workQueueDepth = std::max((long)gArgs.GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
     workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
-    // tranfer ownership to eventBase/HTTP via .release()
-    eventBase = base_ctr.release();
-    eventHTTP = http_ctr.release();
+    for (HTTPWorkClass& wc : workClasses) {
+        LogPrintf("HTTP: creating work queue of depth %u for work class %s\n", wc.depth, wc.name);
+        wc.queue.reset(new WorkQueue<HTTPClosure>(wc.depth));
+    }
+    eventBase = eventLoops[0].base;
+    eventHTTP = eventLoops[0].http;
     return true;
 }
 
@@ -437,38 +634,49 @@ bool UpdateHTTPServerLogging(bool enable) {
 #endif
 }
 
-std::thread threadHTTP;
-std::future<bool> threadResult;
-
 bool StartHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Starting HTTP server\n");
     int rpcThreads = std::max((long)gArgs.GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
-    std::packaged_task<bool(event_base*, evhttp*)> task(ThreadHTTP);
-    threadResult = task.get_future();
-    threadHTTP = std::thread(std::move(task), eventBase, eventHTTP);
+    LogPrintf("HTTP: starting %d I/O threads and %d worker threads\n", eventLoops.size(), rpcThreads);
+    for (HTTPEventLoop& loop : eventLoops) {
+        std::packaged_task<bool(event_base*)> task(ThreadHTTP);
+        loop.result = task.get_future();
+        loop.thread = std::thread(std::move(task), loop.base);
+    }
 
     for (int i = 0; i < rpcThreads; i++) {
         std::thread rpc_worker(HTTPWorkQueueRun, workQueue);
         rpc_worker.detach();
     }
+    for (const HTTPWorkClass& wc : workClasses) {
+        LogPrintf("HTTP: starting %d worker threads for work class %s\n", wc.threads, wc.name);
+        for (int i = 0; i < wc.threads; i++) {
+            std::thread rpc_worker(HTTPWorkQueueRun, wc.queue.get());
+            rpc_worker.detach();
+        }
+    }
     return true;
 }
 
 void InterruptHTTPServer()
 {
     LogPrint(BCLog::HTTP, "Interrupting HTTP server\n");
-    if (eventHTTP) {
+    for (HTTPEventLoop& loop : eventLoops) {
         // Unlisten sockets
-        for (evhttp_bound_socket *socket : boundSockets) {
-            evhttp_del_accept_socket(eventHTTP, socket);
+        for (evhttp_bound_socket *socket : loop.boundSockets) {
+            evhttp_del_accept_socket(loop.http, socket);
         }
+        loop.boundSockets.clear();
         // Reject requests on current connections
-        evhttp_set_gencb(eventHTTP, http_reject_request_cb, nullptr);
+        evhttp_set_gencb(loop.http, http_reject_request_cb, nullptr);
     }
     if (workQueue)
         workQueue->Interrupt();
+    for (HTTPWorkClass& wc : workClasses) {
+        if (wc.queue)
+            wc.queue->Interrupt();
+    }
 }
 
 void StopHTTPServer()
@@ -480,28 +688,38 @@ void StopHTTPServer()
         delete workQueue;
         workQueue = nullptr;
     }
-    if (eventBase) {
-        LogPrint(BCLog::HTTP, "Waiting for HTTP event thread to exit\n");
+    for (HTTPWorkClass& wc : workClasses) {
+        if (wc.queue)
+            wc.queue->WaitExit();
+    }
+    workClasses.clear();
+    if (!eventLoops.empty()) {
+        LogPrint(BCLog::HTTP, "Waiting for HTTP event threads to exit\n");
+    }
+    for (HTTPEventLoop& loop : eventLoops) {
+        if (!loop.thread.joinable())
+            continue;
         // Give event loop a few seconds to exit (to send back last RPC responses), then break it
         // Before this was solved with event_base_loopexit, but that didn't work as expected in
         // at least libevent 2.0.21 and always introduced a delay. In libevent
         // master that appears to be solved, so in the future that solution
         // could be used again (if desirable).
         // (see discussion in https://github.com/bitcoin/bitcoin/pull/6990)
-        if (threadResult.valid() && threadResult.wait_for(std::chrono::milliseconds(2000)) == std::future_status::timeout) {
+        if (loop.result.valid() && loop.result.wait_for(std::chrono::milliseconds(2000)) == std::future_status::timeout) {
             LogPrintf("HTTP event loop did not exit within allotted time, sending loopbreak\n");
-            event_base_loopbreak(eventBase);
+            event_base_loopbreak(loop.base);
         }
-        threadHTTP.join();
+        loop.thread.join();
     }
-    if (eventHTTP) {
-        evhttp_free(eventHTTP);
-        eventHTTP = 0;
-    }
-    if (eventBase) {
-        event_base_free(eventBase);
-        eventBase = 0;
+    for (HTTPEventLoop& loop : eventLoops) {
+        if (loop.http)
+            evhttp_free(loop.http);
+        if (loop.base)
+            event_base_free(loop.base);
     }
+    eventLoops.clear();
+    eventHTTP = 0;
+    eventBase = 0;
     LogPrint(BCLog::HTTP, "Stopped HTTP server\n");
 }
 
@@ -536,8 +754,18 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Event loop that serves the connection a request arrived on */
+static struct event_base* RequestEventBase(struct evhttp_request* req)
+{
+    struct evhttp_connection* con = evhttp_request_get_connection(req);
+    return con ? evhttp_connection_get_base(con) : eventBase;
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* _req) : req(_req),
-                                                       replySent(false)
+                                                       base(RequestEventBase(_req)),
+                                                       replySent(false),
+                                                       replyChunked(false),
+                                                       workQueue(nullptr)
 {
 }
 HTTPRequest::~HTTPRequest()
@@ -546,6 +774,9 @@ HTTPRequest::~HTTPRequest()
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
+    } else if (replyChunked && req) {
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
     }
     // evhttpd cleans up the request, as long as a reply was sent.
 }
@@ -581,6 +812,17 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+std::string HTTPRequest::PeekBody(size_t nMaxSize)
+{
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return "";
+    std::string rv(std::min(evbuffer_get_length(buf), nMaxSize), '\0');
+    ev_ssize_t nCopied = evbuffer_copyout(buf, &rv[0], rv.size());
+    rv.resize(std::max(nCopied, (ev_ssize_t)0));
+    return rv;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -600,13 +842,110 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     struct evbuffer* evb = evhttp_request_get_output_buffer(req);
     assert(evb);
     evbuffer_add(evb, strReply.data(), strReply.size());
-    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+    HTTPEvent* ev = new HTTPEvent(base, true,
         std::bind(evhttp_send_reply, req, nStatus, (const char*)nullptr, (struct evbuffer *)nullptr));
     ev->trigger(0);
     replySent = true;
     req = 0; // transferred back to main thread
 }
 
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && req);
+    // Events triggered from this thread are run by the main http thread in order
+    HTTPEvent* ev = new HTTPEvent(base, true,
+        std::bind(evhttp_send_reply_start, req, nStatus, (const char*)nullptr));
+    ev->trigger(0);
+    replySent = true;
+    replyChunked = true;
+    replyProgress = std::make_shared<HTTPReplyProgress>();
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+/** Called by evhttp once the connection's output buffer has been drained */
+static void http_reply_written_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPReplyProgress* progress = static_cast<HTTPReplyProgress*>(arg);
+    std::lock_guard<std::mutex> lock(progress->cs);
+    progress->nWritten = progress->nHandedOff;
+    progress->cond.notify_all();
+}
+#endif
+
+bool HTTPRequest::WriteReplyChunk(const std::string& chunk)
+{
+    assert(replyChunked && req);
+    HTTPReplyProgress& progress = *replyProgress;
+    std::unique_lock<std::mutex> lock(progress.cs);
+    if (progress.fClosed)
+        return false;
+    if (chunk.empty())
+        return true; // an empty chunk would terminate the reply
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, chunk.data(), chunk.size());
+    progress.nQueued += chunk.size();
+    struct evhttp_request* reqSend = req;
+    std::shared_ptr<HTTPReplyProgress> progressSend = replyProgress;
+    const size_t nSize = chunk.size();
+    HTTPEvent* ev = new HTTPEvent(base, true, [reqSend, evb, progressSend, nSize]() {
+        std::unique_lock<std::mutex> lock(progressSend->cs);
+        // evhttp detaches the request from its connection when the client goes away
+        if (!evhttp_request_get_connection(reqSend)) {
+            progressSend->fClosed = true;
+            progressSend->cond.notify_all();
+        } else {
+            progressSend->nHandedOff += nSize;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+            lock.unlock();
+            evhttp_send_reply_chunk_with_cb(reqSend, evb, http_reply_written_cb, progressSend.get());
+#else
+            progressSend->nWritten = progressSend->nHandedOff;
+            progressSend->cond.notify_all();
+            lock.unlock();
+            evhttp_send_reply_chunk(reqSend, evb);
+#endif
+        }
+        evbuffer_free(evb);
+    });
+    ev->trigger(0);
+
+    while (!progress.fClosed && progress.nQueued - progress.nWritten > HTTP_REPLY_MAX_PENDING) {
+        const size_t nWrittenBefore = progress.nWritten;
+        if (progress.cond.wait_for(lock, std::chrono::seconds(nReplyStallTimeout)) == std::cv_status::timeout &&
+            progress.nWritten == nWrittenBefore) {
+            LogPrint(BCLog::HTTP, "Client stopped reading chunked reply, giving up\n");
+            progress.fClosed = true;
+        }
+    }
+    return !progress.fClosed;
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(replyChunked && req);
+    // Keeps the progress alive for the write callback registered with evhttp,
+    // which the end of the reply replaces
+    std::shared_ptr<HTTPReplyProgress> progressSend = replyProgress;
+    struct evhttp_request* reqSend = req;
+    HTTPEvent* ev = new HTTPEvent(base, true, [reqSend, progressSend]() {
+        evhttp_send_reply_end(reqSend);
+    });
+    ev->trigger(0);
+    req = 0; // transferred back to main thread
+}
+
+bool HTTPRequest::EnqueueHelper(const std::function<void(void)>& func)
+{
+    if (!workQueue)
+        return false;
+    std::unique_ptr<HTTPFunctionWorkItem> item(new HTTPFunctionWorkItem(func));
+    if (!workQueue->EnqueueHelper(item.get()))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -647,10 +986,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkKeyFunction &workKey)
 {
     LogPrint(BCLog::HTTP, "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, workKey));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
@@ -9,15 +9,24 @@
 #include <string>
 #include <stdint.h>
 #include <functional>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
+static const int DEFAULT_HTTP_IO_THREADS=1;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Number of bytes of a chunked reply that may wait to be sent before WriteReplyChunk blocks */
+static const size_t HTTP_REPLY_MAX_PENDING=4*1024*1024;
+/** Default -rpcworkclass: health checks and tip queries get a worker of their own */
+static const char* const DEFAULT_HTTP_WORKCLASS="critical:16:1:getblockcount,getbestblockhash,getblockchaininfo,getnetworkinfo,getconnectioncount,ping,/rest/chaininfo";
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+class HTTPClosure;
+struct HTTPReplyProgress;
+template <typename WorkItem> class WorkQueue;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -39,11 +48,16 @@ bool UpdateHTTPServerLogging(bool enable);
 
 /** Handler for requests to a certain HTTP path */
 typedef std::function<bool(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Work key of a request, such as its RPC method, matched against the -rpcworkclass
+ * specifications in addition to the URI. Called on the event loop thread, so it
+ * must be cheap and must not consume the request body.
+ */
+typedef std::function<std::string(HTTPRequest* req)> HTTPWorkKeyFunction;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
  * be invoked.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPWorkKeyFunction &workKey = nullptr);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -59,7 +73,16 @@ class HTTPRequest
 {
 private:
     struct evhttp_request* req;
+    //! Event loop of the connection; replies are handed to its thread
+    struct event_base* base;
     bool replySent;
+    bool replyChunked;
+    //! Send progress of a chunked reply, shared with the event loop
+    std::shared_ptr<HTTPReplyProgress> replyProgress;
+    //! Work queue of the request's work class, set when it is dispatched
+    WorkQueue<HTTPClosure>* workQueue;
+
+    friend class HTTPWorkItem;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -99,6 +122,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Get at most nMaxSize bytes from the start of the request body without
+     * consuming it.
+     */
+    std::string PeekBody(size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -115,6 +144,40 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for bodies that are produced incrementally.
+     * nStatus is the HTTP status code to send. Send the body with
+     * WriteReplyChunk and finish it with EndChunkedReply.
+     *
+     * @note Use instead of WriteReply, after all headers have been written.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Queue one chunk of a reply started with StartChunkedReply.
+     * Blocks while more than HTTP_REPLY_MAX_PENDING bytes have not been sent
+     * to the client yet, so fast producers are held to the client's pace.
+     * Returns false if the connection was closed or the client stopped reading
+     * for longer than -rpcservertimeout; further chunks are then discarded.
+     */
+    bool WriteReplyChunk(const std::string& chunk);
+
+    /**
+     * Finish a chunked reply. As this will give the request back to the
+     * main thread, do not call any other HTTPRequest methods after calling this.
+     */
+    void EndChunkedReply();
+
+    /**
+     * Run func on another worker thread of this request's work class, to help
+     * handle the request. Helpers run ahead of queued requests and do not count
+     * against the work queue depth, so they never cause other requests to be
+     * rejected. Returns false if the request has not been dispatched to a work
+     * queue, the queue is not running, or as many helpers as worker threads
+     * are already waiting.
+     */
+    bool EnqueueHelper(const std::function<void(void)>& func);
 };
 
 /** Event handler closure.
@@ -64,7 +64,9 @@
 #include <openssl/crypto.h>
 
 #if ENABLE_ZMQ
+#include "zmq/zmqabstractnotifier.h"
 #include "zmq/zmqnotificationinterface.h"
+#include "zmq/zmqrpc.h"
 #endif
 
 #ifdef USE_SSE2
@@ -80,10 +82,6 @@ static const bool DEFAULT_STOPAFTERBLOCKIMPORT = false;
 std::unique_ptr<CConnman> g_connman;
 std::unique_ptr<PeerLogicValidation> peerLogic;
 
-#if ENABLE_ZMQ
-static CZMQNotificationInterface* pzmqNotificationInterface = nullptr;
-#endif
-
 #ifdef WIN32
 // Win32 LevelDB doesn't use filedescriptors, and the ones used for
 // accessing block files don't count towards the fd_set size limit
@@ -256,10 +254,10 @@ void Shutdown()
 #endif
 
 #if ENABLE_ZMQ
-    if (pzmqNotificationInterface) {
-        UnregisterValidationInterface(pzmqNotificationInterface);
-        delete pzmqNotificationInterface;
-        pzmqNotificationInterface = nullptr;
+    if (g_zmq_notification_interface) {
+        UnregisterValidationInterface(g_zmq_notification_interface);
+        delete g_zmq_notification_interface;
+        g_zmq_notification_interface = nullptr;
     }
 #endif
 
@@ -435,6 +433,16 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubhashtx=<address>", _("Enable publish hash transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashflodata=<address>", _("Enable publish hashes of transactions with floData, and of their block, in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawflodata=<address>", _("Enable publish floData of transactions in <address>"));
+    strUsage += HelpMessageOpt("-zmqflodataprefix=<prefix>", _("Only publish floData starting with <prefix> (can be specified multiple times, default: all floData)"));
+    strUsage += HelpMessageOpt("-zmqpubhashblockhwm=<n>", strprintf(_("Set publish hash block outbound message high water mark (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqpubhashtxhwm=<n>", strprintf(_("Set publish hash transaction outbound message high water mark (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqpubrawblockhwm=<n>", strprintf(_("Set publish raw block outbound message high water mark (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqpubrawtxhwm=<n>", strprintf(_("Set publish raw transaction outbound message high water mark (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqpubhashflodatahwm=<n>", strprintf(_("Set publish hash floData outbound message high water mark (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqpubrawflodatahwm=<n>", strprintf(_("Set publish raw floData outbound message high water mark (default: %d)"), DEFAULT_ZMQ_SNDHWM));
+    strUsage += HelpMessageOpt("-zmqqueuesize=<n>", strprintf(_("Set the maximum number of notifications waiting to be published; further notifications are dropped (default: %u)"), DEFAULT_ZMQ_QUEUE_SIZE));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -517,8 +525,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcserialversion", strprintf(_("Sets the serialization of raw transaction or block hex returned in non-verbose mode, non-segwit(0) or segwit(1) (default: %d)"), DEFAULT_RPC_SERIALIZE_VERSION));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpciothreads=<n>", strprintf(_("Set the number of threads handling RPC and REST connections and network I/O (default: %d)"), DEFAULT_HTTP_IO_THREADS));
+    strUsage += HelpMessageOpt("-rpcbatchconcurrency=<n>", strprintf(_("Set the maximum number of threads working on the read-only calls of a single JSON-RPC batch, taken from the idle worker threads of its work class, 1 to run batches sequentially (default: %d)"), DEFAULT_RPC_BATCH_CONCURRENCY));
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
+        strUsage += HelpMessageOpt("-rpcworkclass=<name>:<depth>:<threads>:<match>[,<match>...]", strprintf("Serve RPC calls and REST requests matching an RPC method or URI prefix (starting with '/') from a separate work queue of the given depth with its own worker threads. Can be specified multiple times; the first matching class is used, other requests use -rpcworkqueue and -rpcthreads. Use -norpcworkclass to serve all requests from one queue (default: %s)", DEFAULT_HTTP_WORKCLASS));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
     }
 
@@ -1031,6 +1042,9 @@ bool AppInitParameterInteraction()
 #ifdef ENABLE_WALLET
     RegisterWalletRPCCommands(tableRPC);
 #endif
+#if ENABLE_ZMQ
+    RegisterZMQRPCCommands(tableRPC);
+#endif
 
     nConnectTimeout = gArgs.GetArg("-timeout", DEFAULT_CONNECT_TIMEOUT);
     if (nConnectTimeout <= 0)
@@ -1270,7 +1284,7 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     CConnman& connman = *g_connman;
 
     peerLogic.reset(new PeerLogicValidation(&connman));
-    RegisterValidationInterface(peerLogic.get());
+    RegisterValidationInterface(peerLogic.get(), "peerlogic");
     RegisterNodeSignals(GetNodeSignals());
 
     // sanitize comments per BIP-0014, format user agent and check total size
@@ -1360,10 +1374,10 @@ bool AppInitMain(boost::thread_group& threadGroup, CScheduler& scheduler)
     }
 
 #if ENABLE_ZMQ
-    pzmqNotificationInterface = CZMQNotificationInterface::Create();
+    g_zmq_notification_interface = CZMQNotificationInterface::Create();
 
-    if (pzmqNotificationInterface) {
-        RegisterValidationInterface(pzmqNotificationInterface);
+    if (g_zmq_notification_interface) {
+        RegisterValidationInterface(g_zmq_notification_interface, "zmq");
     }
 #endif
     uint64_t nMaxOutboundLimit = 0; //unlimited unless -maxuploadtarget is set
@@ -0,0 +1,197 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include <univalue.h>
+
+#include <assert.h>
+#include <stdio.h>
+
+namespace {
+/** Same escaping as UniValue's writer: control characters, '"', '\\' and DEL */
+struct JSONEscapeTable
+{
+    char esc[256][7];
+
+    JSONEscapeTable()
+    {
+        static const char* const hexdigits = "0123456789abcdef";
+        for (int i = 0; i < 256; i++) {
+            esc[i][0] = '\0';
+            if (i < 0x20 || i == 0x7f)
+                snprintf(esc[i], sizeof(esc[i]), "\\u00%c%c", hexdigits[i >> 4], hexdigits[i & 0xf]);
+        }
+        snprintf(esc[(int)'\b'], sizeof(esc[0]), "\\b");
+        snprintf(esc[(int)'\t'], sizeof(esc[0]), "\\t");
+        snprintf(esc[(int)'\n'], sizeof(esc[0]), "\\n");
+        snprintf(esc[(int)'\f'], sizeof(esc[0]), "\\f");
+        snprintf(esc[(int)'\r'], sizeof(esc[0]), "\\r");
+        snprintf(esc[(int)'"'], sizeof(esc[0]), "\\\"");
+        snprintf(esc[(int)'\\'], sizeof(esc[0]), "\\\\");
+    }
+};
+
+const JSONEscapeTable escapeTable;
+} // namespace
+
+JSONStreamWriter::JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fFlushed(false), fClosed(false), fAfterKey(false)
+{
+    buffer.reserve(nChunkSize + 1024);
+}
+
+void JSONStreamWriter::BeforeValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vNeedComma.empty()) {
+        if (vNeedComma.back())
+            buffer += ',';
+        vNeedComma.back() = true;
+    }
+}
+
+void JSONStreamWriter::AfterValue()
+{
+    if (buffer.size() >= nChunkSize)
+        Flush();
+}
+
+void JSONStreamWriter::WriteString(const std::string& str)
+{
+    buffer += '"';
+    for (unsigned char ch : str) {
+        const char* esc = escapeTable.esc[ch];
+        if (*esc)
+            buffer += esc;
+        else
+            buffer += ch;
+    }
+    buffer += '"';
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    BeforeValue();
+    buffer += '{';
+    vNeedComma.push_back(false);
+}
+
+void JSONStreamWriter::EndObject()
+{
+    assert(!vNeedComma.empty() && !fAfterKey);
+    vNeedComma.pop_back();
+    buffer += '}';
+    AfterValue();
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    BeforeValue();
+    buffer += '[';
+    vNeedComma.push_back(false);
+}
+
+void JSONStreamWriter::EndArray()
+{
+    assert(!vNeedComma.empty() && !fAfterKey);
+    vNeedComma.pop_back();
+    buffer += ']';
+    AfterValue();
+}
+
+void JSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vNeedComma.empty() && !fAfterKey);
+    BeforeValue();
+    WriteString(key);
+    buffer += ':';
+    fAfterKey = true;
+}
+
+void JSONStreamWriter::Null()
+{
+    BeforeValue();
+    buffer += "null";
+    AfterValue();
+}
+
+void JSONStreamWriter::Value(const std::string& str)
+{
+    BeforeValue();
+    WriteString(str);
+    AfterValue();
+}
+
+void JSONStreamWriter::Value(const char* psz)
+{
+    Value(std::string(psz));
+}
+
+void JSONStreamWriter::Value(bool f)
+{
+    BeforeValue();
+    buffer += f ? "true" : "false";
+    AfterValue();
+}
+
+void JSONStreamWriter::Value(int n)
+{
+    Value((int64_t)n);
+}
+
+void JSONStreamWriter::Value(unsigned int n)
+{
+    Value((uint64_t)n);
+}
+
+void JSONStreamWriter::Value(int64_t n)
+{
+    BeforeValue();
+    buffer += std::to_string(n);
+    AfterValue();
+}
+
+void JSONStreamWriter::Value(uint64_t n)
+{
+    BeforeValue();
+    buffer += std::to_string(n);
+    AfterValue();
+}
+
+void JSONStreamWriter::Value(double d)
+{
+    Value(UniValue(d));
+}
+
+void JSONStreamWriter::Value(const UniValue& val)
+{
+    BeforeValue();
+    buffer += val.write();
+    AfterValue();
+}
+
+void JSONStreamWriter::Flush()
+{
+    if (fClosed)
+        throw JSONStreamClosed();
+    if (buffer.empty())
+        return;
+    fClosed = !sink(buffer);
+    fFlushed = true;
+    buffer.clear();
+    if (fClosed)
+        throw JSONStreamClosed();
+}
+
+std::string JSONStreamWriter::ReleaseBuffer()
+{
+    std::string ret;
+    ret.swap(buffer);
+    return ret;
+}
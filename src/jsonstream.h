@@ -0,0 +1,95 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONSTREAM_H
+#define BITCOIN_JSONSTREAM_H
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class UniValue;
+
+/** Default number of buffered bytes after which a JSONStreamWriter hands output to its sink */
+static const size_t DEFAULT_JSON_STREAM_CHUNK = 64 * 1024;
+
+/**
+ * Thrown by JSONStreamWriter when its sink reports that output can no longer
+ * be delivered, e.g. because the client disconnected. It does not derive from
+ * std::exception so that a producer's error handling cannot swallow it and go
+ * on generating output nobody reads.
+ */
+struct JSONStreamClosed {};
+
+/**
+ * Incremental JSON emitter.
+ *
+ * Produces output byte-identical to UniValue::write() for the same document,
+ * without first materializing the document as a UniValue tree. Output is
+ * buffered and passed to the sink in pieces of at least nChunkSize bytes, so
+ * large results (full blocks, the verbose mempool) can be sent to the client
+ * while they are still being generated. Once the sink refuses a chunk, every
+ * further flush throws JSONStreamClosed, so the producer stops at the next
+ * chunk boundary.
+ */
+class JSONStreamWriter
+{
+public:
+    /** Receives buffered output; returns false once it can no longer be delivered */
+    typedef std::function<bool(const std::string&)> Sink;
+
+    explicit JSONStreamWriter(const Sink& sinkIn, size_t nChunkSizeIn = DEFAULT_JSON_STREAM_CHUNK);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Write an object key; must be followed by exactly one value */
+    void Key(const std::string& key);
+
+    void Null();
+    void Value(const std::string& str);
+    void Value(const char* psz);
+    void Value(bool f);
+    void Value(int n);
+    void Value(unsigned int n);
+    void Value(int64_t n);
+    void Value(uint64_t n);
+    void Value(double d);
+    /** Write an already built value, e.g. the result of ValueFromAmount() */
+    void Value(const UniValue& val);
+
+    template<typename T>
+    void KV(const std::string& key, const T& val)
+    {
+        Key(key);
+        Value(val);
+    }
+
+    /** Hand all buffered output to the sink. Throws JSONStreamClosed if the sink refuses it. */
+    void Flush();
+    /** Return buffered output without passing it to the sink, and clear the buffer */
+    std::string ReleaseBuffer();
+    /** Whether any output has been passed to the sink yet */
+    bool HasFlushed() const { return fFlushed; }
+
+private:
+    Sink sink;
+    size_t nChunkSize;
+    std::string buffer;
+    bool fFlushed;
+    bool fClosed;
+    /** One entry per open container: whether a separator is needed before the next element */
+    std::vector<bool> vNeedComma;
+    bool fAfterKey;
+
+    void BeforeValue();
+    void AfterValue();
+    void WriteString(const std::string& str);
+};
+
+#endif // BITCOIN_JSONSTREAM_H
@@ -6,14 +6,30 @@
 
 #include "keystore.h"
 
+#include "hash.h"
 #include "key.h"
 #include "pubkey.h"
+#include "random.h"
 #include "util.h"
 
 bool CKeyStore::AddKey(const CKey &key) {
     return AddKeyPubKey(key, key.GetPubKey());
 }
 
+SaltedScriptHasher::SaltedScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+size_t SaltedScriptHasher::operator()(const CScript& script) const
+{
+    return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+}
+
+void CBasicKeyStore::AddKeyScriptPubKeys(const CPubKey& pubkey)
+{
+    AssertLockHeld(cs_KeyStore);
+    setScriptPubKeys.insert(GetScriptForDestination(pubkey.GetID()));
+    setScriptPubKeys.insert(GetScriptForRawPubKey(pubkey));
+}
+
 bool CBasicKeyStore::GetPubKey(const CKeyID &address, CPubKey &vchPubKeyOut) const
 {
     CKey key;
@@ -34,6 +50,7 @@ bool CBasicKeyStore::AddKeyPubKey(const CKey& key, const CPubKey &pubkey)
 {
     LOCK(cs_KeyStore);
     mapKeys[pubkey.GetID()] = key;
+    AddKeyScriptPubKeys(pubkey);
     return true;
 }
 
@@ -44,6 +61,12 @@ bool CBasicKeyStore::AddCScript(const CScript& redeemScript)
 
     LOCK(cs_KeyStore);
     mapScripts[CScriptID(redeemScript)] = redeemScript;
+    setScriptPubKeys.insert(GetScriptForDestination(CScriptID(redeemScript)));
+    // Bare witness outputs are ours when their program was added as a script
+    int witnessversion;
+    std::vector<unsigned char> witnessprogram;
+    if (redeemScript.IsWitnessProgram(witnessversion, witnessprogram))
+        setScriptPubKeys.insert(redeemScript);
     return true;
 }
 
@@ -85,6 +108,7 @@ bool CBasicKeyStore::AddWatchOnly(const CScript &dest)
 {
     LOCK(cs_KeyStore);
     setWatchOnly.insert(dest);
+    setScriptPubKeys.insert(dest);
     CPubKey pubKey;
     if (ExtractPubKey(dest, pubKey))
         mapWatchKeys[pubKey.GetID()] = pubKey;
@@ -112,3 +136,9 @@ bool CBasicKeyStore::HaveWatchOnly() const
     LOCK(cs_KeyStore);
     return (!setWatchOnly.empty());
 }
+
+bool CBasicKeyStore::HaveScriptPubKey(const CScript& scriptPubKey) const
+{
+    LOCK(cs_KeyStore);
+    return setScriptPubKeys.count(scriptPubKey) > 0;
+}
@@ -13,6 +13,8 @@
 #include "script/standard.h"
 #include "sync.h"
 
+#include <unordered_set>
+
 #include <boost/signals2/signal.hpp>
 
 /** A virtual base class for key stores */
@@ -44,12 +46,29 @@ public:
     virtual bool RemoveWatchOnly(const CScript &dest) =0;
     virtual bool HaveWatchOnly(const CScript &dest) const =0;
     virtual bool HaveWatchOnly() const =0;
+
+    //! Whether scriptPubKey may pay to this store. Never false for a standard
+    //! script that IsMine() would consider ours.
+    virtual bool HaveScriptPubKey(const CScript& scriptPubKey) const { return true; }
+};
+
+class SaltedScriptHasher
+{
+private:
+    /** Salt */
+    const uint64_t k0, k1;
+
+public:
+    SaltedScriptHasher();
+
+    size_t operator()(const CScript& script) const;
 };
 
 typedef std::map<CKeyID, CKey> KeyMap;
 typedef std::map<CKeyID, CPubKey> WatchKeyMap;
 typedef std::map<CScriptID, CScript > ScriptMap;
 typedef std::set<CScript> WatchOnlySet;
+typedef std::unordered_set<CScript, SaltedScriptHasher> ScriptPubKeySet;
 
 /** Basic key store, that keeps keys in an address->secret map */
 class CBasicKeyStore : public CKeyStore
@@ -59,6 +78,15 @@ protected:
     WatchKeyMap mapWatchKeys;
     ScriptMap mapScripts;
     WatchOnlySet setWatchOnly;
+    /**
+     * The canonical scriptPubKeys paying to every key, script and watch-only
+     * script added to the store, so IsMine() can rule out other scripts with
+     * a single lookup. Entries are never removed.
+     */
+    ScriptPubKeySet setScriptPubKeys;
+
+    //! Add the P2PKH and P2PK scripts of pubkey to setScriptPubKeys
+    void AddKeyScriptPubKeys(const CPubKey& pubkey);
 
 public:
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey) override;
@@ -106,6 +134,8 @@ public:
     virtual bool RemoveWatchOnly(const CScript &dest) override;
     virtual bool HaveWatchOnly(const CScript &dest) const override;
     virtual bool HaveWatchOnly() const override;
+
+    virtual bool HaveScriptPubKey(const CScript& scriptPubKey) const override;
 };
 
 typedef std::vector<unsigned char, secure_allocator<unsigned char> > CKeyingMaterial;
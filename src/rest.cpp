@@ -10,7 +10,9 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "validation.h"
+#include "httprpc.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpc/blockchain.h"
 #include "rpc/server.h"
 #include "streams.h"
@@ -23,7 +25,10 @@
 
 #include <univalue.h>
 
-static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once in the URI
+static const size_t MAX_GETUTXOS_OUTPOINTS_POST = 1000; //max outpoints queried at once in a posted bin/hex request
+static const long MAX_REST_BLOCKS = 2000; //max number of blocks streamed by one /rest/blocks/ request
+static const int REST_FLODATA_READ_THREADS = 4; //number of blocks /rest/blockflodata/ reads at the same time
 
 enum RetFormat {
     RF_UNDEF,
@@ -211,6 +216,8 @@ static bool rest_block(HTTPRequest* req,
 
     CBlock block;
     CBlockIndex* pblockindex = nullptr;
+    int confirmations = -1;
+    const CBlockIndex* pnext = nullptr;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -222,6 +229,8 @@ static bool rest_block(HTTPRequest* req,
 
         if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+        GetBlockChainPosition(pblockindex, confirmations, pnext);
     }
 
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
@@ -243,10 +252,9 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        std::string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPWriteJSONStreamReply(req, [&](JSONStreamWriter& out) {
+            blockToJSONStream(block, pblockindex, confirmations, pnext, out, showTxDetails);
+        });
         return true;
     }
 
@@ -269,6 +277,107 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+/** Read a block of an active chain range. Takes cs_main, as pruning may remove the block meanwhile. */
+static bool ReadRangeBlock(CBlock& block, const CBlockIndex* pindex)
+{
+    LOCK(cs_main);
+    if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+        return false;
+    return ReadBlockFromDisk(block, pindex, Params().GetConsensus());
+}
+
+static bool rest_blocks(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    const bool fByHeight = (path.size() == 3 && path[0] == "height");
+    if (path.size() != 2 && !fByHeight)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/blocks/<hash>/<count>.<ext> or /rest/blocks/height/<height>/<count>.<ext>.");
+
+    const std::string& strCount = path.back();
+    long count = strtol(strCount.c_str(), nullptr, 10);
+    if (count < 1 || count > MAX_REST_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block count out of range: " + strCount);
+
+    // Consecutive blocks of the active chain, as of the time of the request
+    std::vector<const CBlockIndex*> blocks;
+    blocks.reserve(count);
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindex = nullptr;
+        if (fByHeight) {
+            int32_t nHeight;
+            if (!ParseInt32(path[1], &nHeight) || nHeight < 0)
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + path[1]);
+            pindex = chainActive[nHeight];
+            if (!pindex)
+                return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range: " + path[1]);
+        } else {
+            uint256 hash;
+            if (!ParseHashStr(path[0], hash))
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[0]);
+            BlockMap::const_iterator it = mapBlockIndex.find(hash);
+            if (it == mapBlockIndex.end() || !chainActive.Contains(it->second))
+                return RESTERR(req, HTTP_NOT_FOUND, path[0] + " not found in active chain");
+            pindex = it->second;
+        }
+        for (; pindex != nullptr && blocks.size() < (size_t)count; pindex = chainActive.Next(pindex))
+            blocks.push_back(pindex);
+    }
+
+    if (rf != RF_BINARY && rf != RF_HEX && rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    CBlock block;
+    if (!ReadRangeBlock(block, blocks[0]))
+        return RESTERR(req, HTTP_NOT_FOUND, blocks[0]->GetBlockHash().GetHex() + " not available");
+
+    // Blocks are read one at a time and written as chunks; WriteReplyChunk holds
+    // reading back while the client lags behind. Blocks that can no longer be
+    // read (pruned in the meantime) end the range early.
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        req->WriteHeader("Content-Type", rf == RF_BINARY ? "application/octet-stream" : "text/plain");
+        req->StartChunkedReply(HTTP_OK);
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (i > 0 && !ReadRangeBlock(block, blocks[i]))
+                break;
+            CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+            ssBlock << block;
+            if (!req->WriteReplyChunk(rf == RF_BINARY ? ssBlock.str() : HexStr(ssBlock.begin(), ssBlock.end()) + "\n"))
+                break;
+        }
+        req->EndChunkedReply();
+        return true;
+    }
+
+    default: {
+        HTTPWriteJSONStreamReply(req, [&](JSONStreamWriter& out) {
+            out.BeginArray();
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (i > 0 && !ReadRangeBlock(block, blocks[i]))
+                    break;
+                int confirmations;
+                const CBlockIndex* pnext;
+                {
+                    LOCK(cs_main);
+                    GetBlockChainPosition(blocks[i], confirmations, pnext);
+                }
+                blockToJSONStream(block, blocks[i], confirmations, pnext, out, true);
+            }
+            out.EndArray();
+        });
+        return true;
+    }
+    }
+}
+
 // A bit of a hack - dependency on a function defined in rpc/blockchain.cpp
 UniValue getblockchaininfo(const JSONRPCRequest& request);
 
@@ -332,11 +441,9 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        std::string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPWriteJSONStreamReply(req, [](JSONStreamWriter& out) {
+            mempoolToJSONStream(out, true);
+        });
         return true;
     }
     default: {
@@ -383,11 +490,11 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     }
 
     case RF_JSON: {
-        UniValue objTx(UniValue::VOBJ);
-        TxToUniv(*tx, hashBlock, objTx);
-        std::string strJSON = objTx.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
+        HTTPWriteJSONStreamReply(req, [&](JSONStreamWriter& out) {
+            out.BeginObject();
+            TxToJSONStream(*tx, hashBlock, out);
+            out.EndObject();
+        });
         return true;
     }
 
@@ -400,6 +507,20 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Look up unspent outputs for getutxos. Outputs spent in the mempool are never returned. */
+static void GetUTXOs(const CCoinsView& view, const std::vector<COutPoint>& vOutPoints, std::vector<CCoin>& outs, std::vector<bool>& hits)
+{
+    AssertLockHeld(cs_main);
+    hits.reserve(vOutPoints.size());
+    for (const COutPoint& outpoint : vOutPoints) {
+        Coin coin;
+        bool hit = view.GetCoin(outpoint, coin) && !mempool.isSpent(outpoint);
+        if (hit)
+            outs.emplace_back(std::move(coin));
+        hits.push_back(hit);
+    }
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -468,8 +589,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
                 if (fInputParsed) //don't allow sending input over URI and HTTP RAW DATA
                     return RESTERR(req, HTTP_BAD_REQUEST, "Combination of URI scheme inputs and raw post data is not allowed");
 
-                CDataStream oss(SER_NETWORK, PROTOCOL_VERSION);
-                oss << strRequestMutable;
+                CDataStream oss(strRequestMutable.data(), strRequestMutable.data() + strRequestMutable.size(), SER_NETWORK, PROTOCOL_VERSION);
                 oss >> fCheckMemPool;
                 oss >> vOutPoints;
             }
@@ -490,48 +610,44 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
     }
 
-    // limit max outpoints
-    if (vOutPoints.size() > MAX_GETUTXOS_OUTPOINTS)
-        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_GETUTXOS_OUTPOINTS, vOutPoints.size()));
+    // limit max outpoints; posted binary requests may batch more than fit in a URI
+    const size_t nMaxOutPoints = fInputParsed ? MAX_GETUTXOS_OUTPOINTS : MAX_GETUTXOS_OUTPOINTS_POST;
+    if (vOutPoints.size() > nMaxOutPoints)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", nMaxOutPoints, vOutPoints.size()));
 
     // check spentness and form a bitmap (as well as a JSON capable human-readable string representation)
     std::vector<unsigned char> bitmap;
     std::vector<CCoin> outs;
     std::string bitmapStringRepresentation;
     std::vector<bool> hits;
-    bitmap.resize((vOutPoints.size() + 7) / 8);
+    int nTipHeight;
+    uint256 hashTip;
     {
-        LOCK2(cs_main, mempool.cs);
-
-        CCoinsView viewDummy;
-        CCoinsViewCache view(&viewDummy);
-
-        CCoinsViewCache& viewChain = *pcoinsTip;
-        CCoinsViewMemPool viewMempool(&viewChain, mempool);
-
-        if (fCheckMemPool)
-            view.SetBackend(viewMempool); // switch cache backend to db+mempool in case user likes to query mempool
-
-        for (size_t i = 0; i < vOutPoints.size(); i++) {
-            bool hit = false;
-            Coin coin;
-            if (view.GetCoin(vOutPoints[i], coin) && !mempool.isSpent(vOutPoints[i])) {
-                hit = true;
-                outs.emplace_back(std::move(coin));
-            }
-
-            hits.push_back(hit);
-            bitmapStringRepresentation.append(hit ? "1" : "0"); // form a binary string representation (human-readable for json output)
-            bitmap[i / 8] |= ((uint8_t)hit) << (i % 8);
+        // The whole batch is looked up in one lock section, reading the coins
+        // cache directly; mempool.cs is only held when the mempool is queried
+        LOCK(cs_main);
+        nTipHeight = chainActive.Height();
+        hashTip = chainActive.Tip()->GetBlockHash();
+        if (fCheckMemPool) {
+            LOCK(mempool.cs);
+            CCoinsViewMemPool viewMempool(pcoinsTip, mempool);
+            GetUTXOs(viewMempool, vOutPoints, outs, hits);
+        } else {
+            GetUTXOs(*pcoinsTip, vOutPoints, outs, hits);
         }
     }
+    bitmap.resize((vOutPoints.size() + 7) / 8);
+    for (size_t i = 0; i < hits.size(); i++) {
+        bitmapStringRepresentation.append(hits[i] ? "1" : "0"); // form a binary string representation (human-readable for json output)
+        bitmap[i / 8] |= ((uint8_t)hits[i]) << (i % 8);
+    }
 
     switch (rf) {
     case RF_BINARY: {
         // serialize data
         // use exact same output as mentioned in Bip64
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nTipHeight << hashTip << bitmap << outs;
         std::string ssGetUTXOResponseString = ssGetUTXOResponse.str();
 
         req->WriteHeader("Content-Type", "application/octet-stream");
@@ -541,7 +657,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
     case RF_HEX: {
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nTipHeight << hashTip << bitmap << outs;
         std::string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
 
         req->WriteHeader("Content-Type", "text/plain");
@@ -554,8 +670,8 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
         // pack in some essentials
         // use more or less the same output as mentioned in Bip64
-        objGetUTXOResponse.push_back(Pair("chainHeight", chainActive.Height()));
-        objGetUTXOResponse.push_back(Pair("chaintipHash", chainActive.Tip()->GetBlockHash().GetHex()));
+        objGetUTXOResponse.push_back(Pair("chainHeight", nTipHeight));
+        objGetUTXOResponse.push_back(Pair("chaintipHash", hashTip.GetHex()));
         objGetUTXOResponse.push_back(Pair("bitmap", bitmapStringRepresentation));
 
         UniValue utxos(UniValue::VARR);
@@ -587,6 +703,122 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_blockhash_by_height(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string heightStr;
+    const RetFormat rf = ParseDataFormat(heightStr, strURIPart);
+
+    int32_t nHeight;
+    if (!ParseInt32(heightStr, &nHeight) || nHeight < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(heightStr));
+
+    // Ancestors of the published tip never change, so this needs no cs_main
+    std::shared_ptr<const ChainTipSnapshot> tip = GetChainTipSnapshot();
+    if (tip->pindexTip == nullptr || nHeight > tip->nHeight)
+        return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+    const uint256 hash = tip->pindexTip->GetAncestor(nHeight)->GetBlockHash();
+
+    switch (rf) {
+    case RF_BINARY: {
+        CDataStream ssHash(SER_NETWORK, PROTOCOL_VERSION);
+        ssHash << hash;
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssHash.str());
+        return true;
+    }
+    case RF_HEX: {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, hash.GetHex() + "\n");
+        return true;
+    }
+    case RF_JSON: {
+        UniValue objResult(UniValue::VOBJ);
+        objResult.push_back(Pair("blockhash", hash.GetHex()));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, objResult.write() + "\n");
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+}
+
+static bool rest_blockflodata(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    std::vector<std::string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Use /rest/blockflodata/<start>/<end>.<ext>.");
+
+    int32_t nStart, nEnd;
+    if (!ParseInt32(path[0], &nStart) || nStart < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(path[0]));
+    if (!ParseInt32(path[1], &nEnd) || nEnd < nStart)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + SanitizeString(path[1]));
+    if (nEnd - nStart >= MAX_FLODATA_RANGE_BLOCKS)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Block range too large, at most %d blocks", MAX_FLODATA_RANGE_BLOCKS));
+
+    if (rf != RF_BINARY && rf != RF_HEX && rf != RF_JSON)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        if (nEnd > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+        for (int nHeight = nStart; nHeight <= nEnd; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+                return RESTERR(req, HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not available (pruned data)");
+            blocks.push_back(pindex);
+        }
+    }
+
+    // Only transactions with floData are sent, as chunks per block; a block
+    // pruned in the meantime ends the reply early
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX: {
+        req->WriteHeader("Content-Type", rf == RF_BINARY ? "application/octet-stream" : "text/plain");
+        req->StartChunkedReply(HTTP_OK);
+        ReadBlockFloDataRange(blocks, REST_FLODATA_READ_THREADS, [req, rf](const CBlockIndex* pindex, const std::vector<CFloDataEntry>& entries) {
+            if (entries.empty())
+                return true;
+            std::string strChunk;
+            for (const CFloDataEntry& entry : entries) {
+                CDataStream ssEntry(SER_NETWORK, PROTOCOL_VERSION);
+                ssEntry << entry;
+                strChunk += rf == RF_BINARY ? ssEntry.str() : HexStr(ssEntry.begin(), ssEntry.end()) + "\n";
+            }
+            return req->WriteReplyChunk(strChunk);
+        });
+        req->EndChunkedReply();
+        return true;
+    }
+
+    default: {
+        HTTPWriteJSONStreamReply(req, [&blocks](JSONStreamWriter& out) {
+            out.BeginArray();
+            ReadBlockFloDataRange(blocks, REST_FLODATA_READ_THREADS, [&out](const CBlockIndex* pindex, const std::vector<CFloDataEntry>& entries) {
+                for (const CFloDataEntry& entry : entries)
+                    floDataEntryToJSONStream(entry, out);
+                return true;
+            });
+            out.EndArray();
+        });
+        return true;
+    }
+    }
+}
+
 static const struct {
     const char* prefix;
     bool (*handler)(HTTPRequest* req, const std::string& strReq);
@@ -594,11 +826,14 @@ static const struct {
       {"/rest/tx/", rest_tx},
       {"/rest/block/notxdetails/", rest_block_notxdetails},
       {"/rest/block/", rest_block_extended},
+      {"/rest/blocks/", rest_blocks},
       {"/rest/chaininfo", rest_chaininfo},
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/blockflodata/", rest_blockflodata},
 };
 
 bool StartREST()
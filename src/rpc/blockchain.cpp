@@ -14,6 +14,7 @@
 #include "consensus/validation.h"
 #include "validation.h"
 #include "core_io.h"
+#include "jsonstream.h"
 #include "policy/feerate.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
@@ -32,8 +33,10 @@
 
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
 
 struct CUpdatedBlock
 {
@@ -103,6 +106,35 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
+/** Like blockheaderToJSON, but takes chain membership from a tip snapshot instead of chainActive */
+static UniValue blockheaderToJSON(const CBlockIndex* blockindex, const ChainTipSnapshot& tip)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex()));
+    const bool fInChain = tip.pindexTip && tip.pindexTip->GetAncestor(blockindex->nHeight) == blockindex;
+    int confirmations = -1;
+    // Only report confirmations if the block is on the main chain
+    if (fInChain)
+        confirmations = tip.nHeight - blockindex->nHeight + 1;
+    result.push_back(Pair("confirmations", confirmations));
+    result.push_back(Pair("height", blockindex->nHeight));
+    result.push_back(Pair("version", blockindex->nVersion));
+    result.push_back(Pair("versionHex", strprintf("%08x", blockindex->nVersion)));
+    result.push_back(Pair("merkleroot", blockindex->hashMerkleRoot.GetHex()));
+    result.push_back(Pair("time", (int64_t)blockindex->nTime));
+    result.push_back(Pair("mediantime", (int64_t)blockindex->GetMedianTimePast()));
+    result.push_back(Pair("nonce", (uint64_t)blockindex->nNonce));
+    result.push_back(Pair("bits", strprintf("%08x", blockindex->nBits)));
+    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+
+    if (blockindex->pprev)
+        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+    if (fInChain && blockindex->nHeight < tip.nHeight)
+        result.push_back(Pair("nextblockhash", tip.pindexTip->GetAncestor(blockindex->nHeight + 1)->GetBlockHash().GetHex()));
+    return result;
+}
+
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
 {
     UniValue result(UniValue::VOBJ);
@@ -147,6 +179,56 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+void blockToJSONStream(const CBlock& block, const CBlockIndex* blockindex, int confirmations, const CBlockIndex* pnext, JSONStreamWriter& out, bool txDetails)
+{
+    out.BeginObject();
+    out.KV("hash", blockindex->GetBlockHash().GetHex());
+    out.KV("confirmations", confirmations);
+    out.KV("strippedsize", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION | SERIALIZE_TRANSACTION_NO_WITNESS));
+    out.KV("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    out.KV("weight", (int)::GetBlockWeight(block));
+    out.KV("height", blockindex->nHeight);
+    out.KV("version", block.nVersion);
+    out.KV("versionHex", strprintf("%08x", block.nVersion));
+    out.KV("merkleroot", block.hashMerkleRoot.GetHex());
+    out.Key("tx");
+    out.BeginArray();
+    for(const auto& tx : block.vtx)
+    {
+        if(txDetails)
+        {
+            out.BeginObject();
+            TxToJSONStream(*tx, uint256(), out, true, RPCSerializationFlags());
+            out.EndObject();
+        }
+        else
+            out.Value(tx->GetHash().GetHex());
+    }
+    out.EndArray();
+    out.KV("time", block.GetBlockTime());
+    out.KV("mediantime", (int64_t)blockindex->GetMedianTimePast());
+    out.KV("nonce", (uint64_t)block.nNonce);
+    out.KV("bits", strprintf("%08x", block.nBits));
+    out.KV("difficulty", GetDifficulty(blockindex));
+    out.KV("chainwork", blockindex->nChainWork.GetHex());
+
+    if (blockindex->pprev)
+        out.KV("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
+    if (pnext)
+        out.KV("nextblockhash", pnext->GetBlockHash().GetHex());
+    out.EndObject();
+}
+
+void GetBlockChainPosition(const CBlockIndex* blockindex, int& confirmations, const CBlockIndex*& pnext)
+{
+    AssertLockHeld(cs_main);
+    confirmations = -1;
+    // Only report confirmations if the block is on the main chain
+    if (chainActive.Contains(blockindex))
+        confirmations = chainActive.Height() - blockindex->nHeight + 1;
+    pnext = chainActive.Next(blockindex);
+}
+
 UniValue getblockcount(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() != 0)
@@ -160,8 +242,7 @@ UniValue getblockcount(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->nHeight;
 }
 
 UniValue getbestblockhash(const JSONRPCRequest& request)
@@ -177,8 +258,7 @@ UniValue getbestblockhash(const JSONRPCRequest& request)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->hashBlock.GetHex();
 }
 
 void RPCNotifyBlockChange(bool ibd, const CBlockIndex * pindex)
@@ -348,27 +428,23 @@ std::string EntryDescriptionString()
            "       ... ]\n";
 }
 
-void entryToJSON(UniValue &info, const CTxMemPoolEntry &e)
+void entryToJSON(UniValue &info, const TxMempoolEntrySnapshot &e)
 {
-    AssertLockHeld(mempool.cs);
-
-    info.push_back(Pair("size", (int)e.GetTxSize()));
-    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-    info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee())));
-    info.push_back(Pair("time", e.GetTime()));
-    info.push_back(Pair("height", (int)e.GetHeight()));
-    info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
-    info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
-    info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
-    info.push_back(Pair("ancestorcount", e.GetCountWithAncestors()));
-    info.push_back(Pair("ancestorsize", e.GetSizeWithAncestors()));
-    info.push_back(Pair("ancestorfees", e.GetModFeesWithAncestors()));
-    const CTransaction& tx = e.GetTx();
+    info.push_back(Pair("size", (int)e.nTxSize));
+    info.push_back(Pair("fee", ValueFromAmount(e.nFee)));
+    info.push_back(Pair("modifiedfee", ValueFromAmount(e.nModifiedFee)));
+    info.push_back(Pair("time", e.nTime));
+    info.push_back(Pair("height", (int)e.nHeight));
+    info.push_back(Pair("descendantcount", e.nCountWithDescendants));
+    info.push_back(Pair("descendantsize", e.nSizeWithDescendants));
+    info.push_back(Pair("descendantfees", e.nModFeesWithDescendants));
+    info.push_back(Pair("ancestorcount", e.nCountWithAncestors));
+    info.push_back(Pair("ancestorsize", e.nSizeWithAncestors));
+    info.push_back(Pair("ancestorfees", e.nModFeesWithAncestors));
     std::set<std::string> setDepends;
-    for (const CTxIn& txin : tx.vin)
+    for (const uint256& parent : e.vParents)
     {
-        if (mempool.exists(txin.prevout.hash))
-            setDepends.insert(txin.prevout.hash.ToString());
+        setDepends.insert(parent.ToString());
     }
 
     UniValue depends(UniValue::VARR);
@@ -384,14 +460,14 @@ UniValue mempoolToJSON(bool fVerbose)
 {
     if (fVerbose)
     {
-        LOCK(mempool.cs);
+        // Walk a snapshot so the JSON is built without holding mempool.cs
+        CTxMemPoolSnapshotRef snapshot = mempool.GetSnapshot();
         UniValue o(UniValue::VOBJ);
-        for (const CTxMemPoolEntry& e : mempool.mapTx)
+        for (const auto& entry : snapshot->mapEntries)
         {
-            const uint256& hash = e.GetTx().GetHash();
             UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.push_back(Pair(hash.ToString(), info));
+            entryToJSON(info, *entry.second);
+            o.push_back(Pair(entry.first.ToString(), info));
         }
         return o;
     }
@@ -408,6 +484,57 @@ UniValue mempoolToJSON(bool fVerbose)
     }
 }
 
+static void entryToJSONStream(JSONStreamWriter& out, const TxMempoolEntrySnapshot& e)
+{
+    out.BeginObject();
+    out.KV("size", (int)e.nTxSize);
+    out.KV("fee", ValueFromAmount(e.nFee));
+    out.KV("modifiedfee", ValueFromAmount(e.nModifiedFee));
+    out.KV("time", e.nTime);
+    out.KV("height", (int)e.nHeight);
+    out.KV("descendantcount", e.nCountWithDescendants);
+    out.KV("descendantsize", e.nSizeWithDescendants);
+    out.KV("descendantfees", e.nModFeesWithDescendants);
+    out.KV("ancestorcount", e.nCountWithAncestors);
+    out.KV("ancestorsize", e.nSizeWithAncestors);
+    out.KV("ancestorfees", e.nModFeesWithAncestors);
+    // Same order as entryToJSON, which sorts by the hex string
+    std::set<std::string> setDepends;
+    for (const uint256& parent : e.vParents)
+        setDepends.insert(parent.ToString());
+    out.Key("depends");
+    out.BeginArray();
+    for (const std::string& dep : setDepends)
+        out.Value(dep);
+    out.EndArray();
+    out.EndObject();
+}
+
+void mempoolToJSONStream(JSONStreamWriter& out, bool fVerbose)
+{
+    if (fVerbose)
+    {
+        CTxMemPoolSnapshotRef snapshot = mempool.GetSnapshot();
+        out.BeginObject();
+        for (const auto& entry : snapshot->mapEntries)
+        {
+            out.Key(entry.first.ToString());
+            entryToJSONStream(out, *entry.second);
+        }
+        out.EndObject();
+    }
+    else
+    {
+        std::vector<uint256> vtxid;
+        mempool.queryHashes(vtxid);
+
+        out.BeginArray();
+        for (const uint256& hash : vtxid)
+            out.Value(hash.ToString());
+        out.EndArray();
+    }
+}
+
 UniValue getrawmempool(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() > 1)
@@ -440,6 +567,20 @@ UniValue getrawmempool(const JSONRPCRequest& request)
     return mempoolToJSON(fVerbose);
 }
 
+static void getrawmempool_stream(const JSONRPCRequest& request, JSONStreamWriter& out)
+{
+    if (request.fHelp || request.params.size() > 1) {
+        getrawmempool(request); // throws the usage message
+        return;
+    }
+
+    bool fVerbose = false;
+    if (!request.params[0].isNull())
+        fVerbose = request.params[0].get_bool();
+
+    mempoolToJSONStream(out, fVerbose);
+}
+
 UniValue getmempoolancestors(const JSONRPCRequest& request)
 {
     if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
@@ -472,33 +613,27 @@ UniValue getmempoolancestors(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    CTxMemPoolSnapshotRef snapshot = mempool.GetSnapshot();
+    if (!snapshot->find(hash)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    CTxMemPool::setEntries setAncestors;
-    uint64_t noLimit = std::numeric_limits<uint64_t>::max();
-    std::string dummy;
-    mempool.CalculateMemPoolAncestors(*it, setAncestors, noLimit, noLimit, noLimit, noLimit, dummy, false);
+    std::set<uint256> setAncestors;
+    snapshot->CalculateAncestors(hash, setAncestors);
 
     if (!fVerbose) {
         UniValue o(UniValue::VARR);
-        for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            o.push_back(ancestorIt->GetTx().GetHash().ToString());
+        for (const uint256& ancestor : setAncestors) {
+            o.push_back(ancestor.ToString());
         }
 
         return o;
     } else {
         UniValue o(UniValue::VOBJ);
-        for (CTxMemPool::txiter ancestorIt : setAncestors) {
-            const CTxMemPoolEntry &e = *ancestorIt;
-            const uint256& _hash = e.GetTx().GetHash();
+        for (const uint256& ancestor : setAncestors) {
             UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.push_back(Pair(_hash.ToString(), info));
+            entryToJSON(info, *snapshot->find(ancestor));
+            o.push_back(Pair(ancestor.ToString(), info));
         }
         return o;
     }
@@ -536,33 +671,27 @@ UniValue getmempooldescendants(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    CTxMemPoolSnapshotRef snapshot = mempool.GetSnapshot();
+    if (!snapshot->find(hash)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    CTxMemPool::setEntries setDescendants;
-    mempool.CalculateDescendants(it, setDescendants);
-    // CTxMemPool::CalculateDescendants will include the given tx
-    setDescendants.erase(it);
+    std::set<uint256> setDescendants;
+    snapshot->CalculateDescendants(hash, setDescendants);
 
     if (!fVerbose) {
         UniValue o(UniValue::VARR);
-        for (CTxMemPool::txiter descendantIt : setDescendants) {
-            o.push_back(descendantIt->GetTx().GetHash().ToString());
+        for (const uint256& descendant : setDescendants) {
+            o.push_back(descendant.ToString());
         }
 
         return o;
     } else {
         UniValue o(UniValue::VOBJ);
-        for (CTxMemPool::txiter descendantIt : setDescendants) {
-            const CTxMemPoolEntry &e = *descendantIt;
-            const uint256& _hash = e.GetTx().GetHash();
+        for (const uint256& descendant : setDescendants) {
             UniValue info(UniValue::VOBJ);
-            entryToJSON(info, e);
-            o.push_back(Pair(_hash.ToString(), info));
+            entryToJSON(info, *snapshot->find(descendant));
+            o.push_back(Pair(descendant.ToString(), info));
         }
         return o;
     }
@@ -588,16 +717,14 @@ UniValue getmempoolentry(const JSONRPCRequest& request)
 
     uint256 hash = ParseHashV(request.params[0], "parameter 1");
 
-    LOCK(mempool.cs);
-
-    CTxMemPool::txiter it = mempool.mapTx.find(hash);
-    if (it == mempool.mapTx.end()) {
+    CTxMemPoolSnapshotRef snapshot = mempool.GetSnapshot();
+    const TxMempoolEntrySnapshot* e = snapshot->find(hash);
+    if (!e) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Transaction not in mempool");
     }
 
-    const CTxMemPoolEntry &e = *it;
     UniValue info(UniValue::VOBJ);
-    entryToJSON(info, e);
+    entryToJSON(info, *e);
     return info;
 }
 
@@ -660,8 +787,6 @@ UniValue getblockheader(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockheader", "\"e2acdf2dd19a702e5d12a925f1e984b01e47a933562ca893656d4afb38b44ee3\"")
         );
 
-    LOCK(cs_main);
-
     std::string strHash = request.params[0].get_str();
     uint256 hash(uint256S(strHash));
 
@@ -669,10 +794,20 @@ UniValue getblockheader(const JSONRPCRequest& request)
     if (!request.params[1].isNull())
         fVerbose = request.params[1].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
-
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    // The tip and best header are answered from the tip snapshot without cs_main
+    std::shared_ptr<const ChainTipSnapshot> tip = GetChainTipSnapshot();
+    const CBlockIndex* pblockindex = nullptr;
+    if (tip->pindexTip && tip->hashBlock == hash) {
+        pblockindex = tip->pindexTip;
+    } else if (tip->pindexHeader && tip->pindexHeader->GetBlockHash() == hash) {
+        pblockindex = tip->pindexHeader;
+    } else {
+        LOCK(cs_main);
+        BlockMap::const_iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+    }
 
     if (!fVerbose)
     {
@@ -682,7 +817,7 @@ UniValue getblockheader(const JSONRPCRequest& request)
         return strHex;
     }
 
-    return blockheaderToJSON(pblockindex);
+    return blockheaderToJSON(pblockindex, *tip);
 }
 
 UniValue getblock(const JSONRPCRequest& request)
@@ -776,6 +911,306 @@ UniValue getblock(const JSONRPCRequest& request)
     return blockToJSON(block, pblockindex, verbosity >= 2);
 }
 
+static void getblock_stream(const JSONRPCRequest& request, JSONStreamWriter& out)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2) {
+        getblock(request); // throws the usage message
+        return;
+    }
+
+    std::string strHash = request.params[0].get_str();
+    uint256 hash(uint256S(strHash));
+
+    int verbosity = 1;
+    if (!request.params[1].isNull()) {
+        if(request.params[1].isNum())
+            verbosity = request.params[1].get_int();
+        else
+            verbosity = request.params[1].get_bool() ? 1 : 0;
+    }
+
+    CBlock block;
+    const CBlockIndex* pblockindex;
+    int confirmations;
+    const CBlockIndex* pnext;
+    {
+        // Everything that can fail happens here, before any output is written
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hash);
+        if (mi == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = mi->second;
+
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+
+        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+            throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+
+        GetBlockChainPosition(pblockindex, confirmations, pnext);
+    }
+
+    if (verbosity <= 0)
+    {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION | RPCSerializationFlags());
+        ssBlock << block;
+        out.Value(HexStr(ssBlock.begin(), ssBlock.end()));
+        return;
+    }
+
+    blockToJSONStream(block, pblockindex, confirmations, pnext, out, verbosity >= 2);
+}
+
+UniValue floDataEntryToJSON(const CFloDataEntry& entry)
+{
+    UniValue result(UniValue::VOBJ);
+    result.push_back(Pair("height", entry.nHeight));
+    result.push_back(Pair("txid", entry.txid.GetHex()));
+    result.push_back(Pair("outputs", (uint64_t)entry.nOutputs));
+    result.push_back(Pair("value", ValueFromAmount(entry.nValueOut)));
+    result.push_back(Pair("floData", entry.strFloData));
+    return result;
+}
+
+void floDataEntryToJSONStream(const CFloDataEntry& entry, JSONStreamWriter& out)
+{
+    out.BeginObject();
+    out.KV("height", entry.nHeight);
+    out.KV("txid", entry.txid.GetHex());
+    out.KV("outputs", (uint64_t)entry.nOutputs);
+    out.KV("value", ValueFromAmount(entry.nValueOut));
+    out.KV("floData", entry.strFloData);
+    out.EndObject();
+}
+
+/** Read one block and collect its transactions with floData */
+static bool ReadBlockFloData(const CBlockIndex* pindex, std::vector<CFloDataEntry>& entries)
+{
+    CDiskBlockPos pos;
+    {
+        LOCK(cs_main);
+        if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+            return false;
+        pos = pindex->GetBlockPos();
+    }
+
+    // Read without cs_main, so several blocks can be read at once; a block
+    // pruned in the meantime fails to read or does not match the hash
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pos, pindex->GetBlockHash()))
+        return false;
+
+    for (const auto& tx : block.vtx) {
+        if (tx->strFloData.empty())
+            continue;
+        CFloDataEntry entry;
+        entry.nHeight = pindex->nHeight;
+        entry.txid = tx->GetHash();
+        entry.nOutputs = tx->vout.size();
+        entry.nValueOut = tx->GetValueOut();
+        entry.strFloData = tx->strFloData;
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+bool ReadBlockFloDataRange(const std::vector<const CBlockIndex*>& blocks, int nThreads,
+                           const std::function<bool(const CBlockIndex*, const std::vector<CFloDataEntry>&)>& fn)
+{
+    nThreads = std::max(1, std::min(nThreads, (int)blocks.size()));
+    if (nThreads == 1) {
+        for (const CBlockIndex* pindex : blocks) {
+            std::vector<CFloDataEntry> entries;
+            if (!ReadBlockFloData(pindex, entries) || !fn(pindex, entries))
+                return false;
+        }
+        return true;
+    }
+
+    // Readers take the next block to read, staying at most nWindow blocks
+    // ahead of the one passed to fn, so a slow fn bounds the work done ahead
+    const size_t nWindow = 2 * nThreads;
+    std::mutex cs;
+    std::condition_variable cond;
+    std::vector<std::vector<CFloDataEntry>> results(blocks.size());
+    std::vector<char> vState(blocks.size(), 0); // 0: pending, 1: read, 2: failed
+    size_t nNextRead = 0;
+    size_t nNextDeliver = 0;
+    bool fStop = false;
+
+    auto reader = [&]() {
+        while (true) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (!fStop && nNextRead < blocks.size() && nNextRead >= nNextDeliver + nWindow)
+                    cond.wait(lock);
+                if (fStop || nNextRead >= blocks.size())
+                    return;
+                i = nNextRead++;
+            }
+            std::vector<CFloDataEntry> entries;
+            bool fRead = false;
+            try {
+                fRead = ReadBlockFloData(blocks[i], entries);
+            } catch (const std::exception& e) {
+                LogPrintf("%s: %s\n", __func__, e.what());
+            }
+            {
+                std::lock_guard<std::mutex> lock(cs);
+                results[i] = std::move(entries);
+                vState[i] = fRead ? 1 : 2;
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    auto stop = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& t : threads)
+            t.join();
+    };
+
+    bool fResult = true;
+    try {
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(reader);
+
+        for (size_t i = 0; i < blocks.size(); i++) {
+            std::vector<CFloDataEntry> entries;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (vState[i] == 0)
+                    cond.wait(lock);
+                if (vState[i] == 2) {
+                    fResult = false;
+                    break;
+                }
+                entries = std::move(results[i]);
+            }
+            if (!fn(blocks[i], entries)) {
+                fResult = false;
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(cs);
+                nNextDeliver = i + 1;
+            }
+            cond.notify_all();
+        }
+    } catch (...) {
+        stop();
+        throw;
+    }
+    stop();
+    return fResult;
+}
+
+/** Parse the getblockflodata arguments into the blocks to read. Requires cs_main. */
+static std::vector<const CBlockIndex*> ParseBlockFloDataRange(const JSONRPCRequest& request, int& nThreads)
+{
+    int nStart = request.params[0].get_int();
+    int nEnd = request.params[1].get_int();
+    if ((int64_t)nEnd - nStart >= MAX_FLODATA_RANGE_BLOCKS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Block range too large, at most %d blocks", MAX_FLODATA_RANGE_BLOCKS));
+    if (nStart < 0 || nEnd < nStart || nEnd > chainActive.Height())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+
+    nThreads = 1;
+    if (!request.params[2].isNull()) {
+        nThreads = request.params[2].get_int();
+        if (nThreads < 1 || nThreads > MAX_FLODATA_READ_THREADS)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("threads must be between 1 and %d", MAX_FLODATA_READ_THREADS));
+    }
+
+    std::vector<const CBlockIndex*> blocks;
+    blocks.reserve(nEnd - nStart + 1);
+    for (int nHeight = nStart; nHeight <= nEnd; nHeight++) {
+        const CBlockIndex* pindex = chainActive[nHeight];
+        if (fHavePruned && !(pindex->nStatus & BLOCK_HAVE_DATA) && pindex->nTx > 0)
+            throw JSONRPCError(RPC_MISC_ERROR, strprintf("Block at height %d not available (pruned data)", nHeight));
+        blocks.push_back(pindex);
+    }
+    return blocks;
+}
+
+UniValue getblockflodata(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 3)
+        throw std::runtime_error(
+            "getblockflodata start end ( threads )\n"
+            "\nReturns the transactions with floData in the active chain blocks at heights start to end, inclusive.\n"
+            "At most " + std::to_string(MAX_FLODATA_RANGE_BLOCKS) + " blocks can be scanned per call.\n"
+            "\nArguments:\n"
+            "1. start      (numeric, required) The height of the first block\n"
+            "2. end        (numeric, required) The height of the last block\n"
+            "3. threads    (numeric, optional, default=1) The number of blocks read at the same time, at most " + std::to_string(MAX_FLODATA_READ_THREADS) + "\n"
+            "\nResult:\n"
+            "[                       (json array of objects), in chain order\n"
+            "  {\n"
+            "    \"height\" : n,       (numeric) The height of the block containing the transaction\n"
+            "    \"txid\" : \"hash\",    (string) The transaction id\n"
+            "    \"outputs\" : n,      (numeric) The number of outputs\n"
+            "    \"value\" : x.xxx,    (numeric) The total value of the outputs in " + CURRENCY_UNIT + "\n"
+            "    \"floData\" : \"data\"  (string) The floData\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getblockflodata", "1000 2000")
+            + HelpExampleRpc("getblockflodata", "1000, 2000, 4")
+        );
+
+    int nThreads;
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        blocks = ParseBlockFloDataRange(request, nThreads);
+    }
+
+    UniValue result(UniValue::VARR);
+    bool fRead = ReadBlockFloDataRange(blocks, nThreads, [&result](const CBlockIndex* pindex, const std::vector<CFloDataEntry>& entries) {
+        for (const CFloDataEntry& entry : entries)
+            result.push_back(floDataEntryToJSON(entry));
+        return true;
+    });
+    if (!fRead)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    return result;
+}
+
+static void getblockflodata_stream(const JSONRPCRequest& request, JSONStreamWriter& out)
+{
+    if (request.fHelp || request.params.size() < 2 || request.params.size() > 3) {
+        getblockflodata(request); // throws the usage message
+        return;
+    }
+
+    int nThreads;
+    std::vector<const CBlockIndex*> blocks;
+    {
+        LOCK(cs_main);
+        blocks = ParseBlockFloDataRange(request, nThreads);
+    }
+
+    // A block that can no longer be read (pruned in the meantime) can only
+    // be reported by truncating the reply, as output has been written already
+    out.BeginArray();
+    bool fRead = ReadBlockFloDataRange(blocks, nThreads, [&out](const CBlockIndex* pindex, const std::vector<CFloDataEntry>& entries) {
+        for (const CFloDataEntry& entry : entries)
+            floDataEntryToJSONStream(entry, out);
+        return true;
+    });
+    if (!fRead)
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not found on disk");
+    out.EndArray();
+}
+
 struct CCoinsStats
 {
     int nHeight;
@@ -1045,7 +1480,7 @@ UniValue verifychain(const JSONRPCRequest& request)
 }
 
 /** Implementation of IsSuperMajority with better feedback */
-static UniValue SoftForkMajorityDesc(int version, CBlockIndex* pindex, const Consensus::Params& consensusParams)
+static UniValue SoftForkMajorityDesc(int version, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     UniValue rv(UniValue::VOBJ);
     bool activated = false;
@@ -1065,7 +1500,7 @@ static UniValue SoftForkMajorityDesc(int version, CBlockIndex* pindex, const Con
     return rv;
 }
 
-static UniValue SoftForkDesc(const std::string &name, int version, CBlockIndex* pindex, const Consensus::Params& consensusParams)
+static UniValue SoftForkDesc(const std::string &name, int version, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     UniValue rv(UniValue::VOBJ);
     rv.push_back(Pair("id", name));
@@ -1074,10 +1509,10 @@ static UniValue SoftForkDesc(const std::string &name, int version, CBlockIndex*
     return rv;
 }
 
-static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
+static UniValue BIP9SoftForkDesc(const ChainTipSnapshot& tip, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
 {
     UniValue rv(UniValue::VOBJ);
-    const ThresholdState thresholdState = VersionBitsTipState(consensusParams, id);
+    const ThresholdState thresholdState = tip.vDeploymentState[id];
     switch (thresholdState) {
     case THRESHOLD_DEFINED: rv.push_back(Pair("status", "defined")); break;
     case THRESHOLD_STARTED: rv.push_back(Pair("status", "started")); break;
@@ -1091,11 +1526,11 @@ static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Conse
     }
     rv.push_back(Pair("startTime", consensusParams.vDeployments[id].nStartTime));
     rv.push_back(Pair("timeout", consensusParams.vDeployments[id].nTimeout));
-    rv.push_back(Pair("since", VersionBitsTipStateSinceHeight(consensusParams, id)));
+    rv.push_back(Pair("since", tip.vDeploymentSince[id]));
     if (THRESHOLD_STARTED == thresholdState)
     {
         UniValue statsUV(UniValue::VOBJ);
-        BIP9Stats statsStruct = VersionBitsTipStatistics(consensusParams, id);
+        BIP9Stats statsStruct = VersionBitsStatistics(tip.pindexTip, consensusParams, id);
         statsUV.push_back(Pair("period", statsStruct.period));
         statsUV.push_back(Pair("threshold", statsStruct.threshold));
         statsUV.push_back(Pair("elapsed", statsStruct.elapsed));
@@ -1106,13 +1541,13 @@ static UniValue BIP9SoftForkDesc(const Consensus::Params& consensusParams, Conse
     return rv;
 }
 
-void BIP9SoftForkDescPushBack(UniValue& bip9_softforks, const std::string &name, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
+void BIP9SoftForkDescPushBack(UniValue& bip9_softforks, const std::string &name, const ChainTipSnapshot& tip, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
 {
     // Deployments with timeout value of 0 are hidden.
     // A timeout value of 0 guarantees a softfork will never be activated.
     // This is used when softfork codes are merged without specifying the deployment schedule.
     if (consensusParams.vDeployments[id].nTimeout > 0)
-        bip9_softforks.push_back(Pair(name, BIP9SoftForkDesc(consensusParams, id)));
+        bip9_softforks.push_back(Pair(name, BIP9SoftForkDesc(tip, consensusParams, id)));
 }
 
 UniValue getblockchaininfo(const JSONRPCRequest& request)
@@ -1131,6 +1566,7 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             "  \"mediantime\": xxxxxx,     (numeric) median time for the current best block\n"
             "  \"verificationprogress\": xxxx, (numeric) estimate of verification progress [0..1]\n"
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
+            "  \"initialblockdownload\": xx, (boolean) estimate of whether this node is in Initial Block Download mode\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) lowest-height complete block stored\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
@@ -1164,33 +1600,35 @@ UniValue getblockchaininfo(const JSONRPCRequest& request)
             + HelpExampleRpc("getblockchaininfo", "")
         );
 
-    LOCK(cs_main);
+    std::shared_ptr<const ChainTipSnapshot> tip = GetChainTipSnapshot();
 
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("chain",                 Params().NetworkIDString()));
-    obj.push_back(Pair("blocks",                (int)chainActive.Height()));
-    obj.push_back(Pair("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1));
-    obj.push_back(Pair("bestblockhash",         chainActive.Tip()->GetBlockHash().GetHex()));
-    obj.push_back(Pair("difficulty",            (double)GetDifficulty()));
-    obj.push_back(Pair("mediantime",            (int64_t)chainActive.Tip()->GetMedianTimePast()));
-    obj.push_back(Pair("verificationprogress",  GuessVerificationProgress(Params().TxData(), chainActive.Tip())));
-    obj.push_back(Pair("chainwork",             chainActive.Tip()->nChainWork.GetHex()));
+    obj.push_back(Pair("blocks",                tip->nHeight));
+    obj.push_back(Pair("headers",               tip->pindexHeader ? tip->pindexHeader->nHeight : -1));
+    obj.push_back(Pair("bestblockhash",         tip->hashBlock.GetHex()));
+    obj.push_back(Pair("difficulty",            (double)GetDifficulty(tip->pindexTip)));
+    obj.push_back(Pair("mediantime",            tip->nMedianTimePast));
+    obj.push_back(Pair("verificationprogress",  GuessVerificationProgress(Params().TxData(), tip->pindexTip)));
+    obj.push_back(Pair("chainwork",             tip->nChainWork.GetHex()));
+    obj.push_back(Pair("initialblockdownload",  tip->fInitialBlockDownload));
     obj.push_back(Pair("pruned",                fPruneMode));
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    CBlockIndex* tip = chainActive.Tip();
     UniValue softforks(UniValue::VARR);
     UniValue bip9_softforks(UniValue::VOBJ);
-    softforks.push_back(SoftForkDesc("bip34", 2, tip, consensusParams));
-    softforks.push_back(SoftForkDesc("bip66", 3, tip, consensusParams));
-    softforks.push_back(SoftForkDesc("bip65", 4, tip, consensusParams));
-    BIP9SoftForkDescPushBack(bip9_softforks, "csv", consensusParams, Consensus::DEPLOYMENT_CSV);
-    BIP9SoftForkDescPushBack(bip9_softforks, "segwit", consensusParams, Consensus::DEPLOYMENT_SEGWIT);
+    softforks.push_back(SoftForkDesc("bip34", 2, tip->pindexTip, consensusParams));
+    softforks.push_back(SoftForkDesc("bip66", 3, tip->pindexTip, consensusParams));
+    softforks.push_back(SoftForkDesc("bip65", 4, tip->pindexTip, consensusParams));
+    BIP9SoftForkDescPushBack(bip9_softforks, "csv", *tip, consensusParams, Consensus::DEPLOYMENT_CSV);
+    BIP9SoftForkDescPushBack(bip9_softforks, "segwit", *tip, consensusParams, Consensus::DEPLOYMENT_SEGWIT);
     obj.push_back(Pair("softforks",             softforks));
     obj.push_back(Pair("bip9_softforks", bip9_softforks));
 
     if (fPruneMode)
     {
+        // Block data availability changes as files are pruned, so this walk still needs cs_main
+        LOCK(cs_main);
         CBlockIndex *block = chainActive.Tip();
         while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA))
             block = block->pprev;
@@ -1540,6 +1978,7 @@ static const CRPCCommand commands[] =
     { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,  {} },
     { "blockchain",         "getblockcount",          &getblockcount,          true,  {} },
     { "blockchain",         "getblock",               &getblock,               true,  {"blockhash","verbosity|verbose"} },
+    { "blockchain",         "getblockflodata",        &getblockflodata,        true,  {"start","end","threads"} },
     { "blockchain",         "getblockhash",           &getblockhash,           true,  {"height"} },
     { "blockchain",         "getblockheader",         &getblockheader,         true,  {"blockhash","verbose"} },
     { "blockchain",         "getchaintips",           &getchaintips,           true,  {} },
@@ -1568,4 +2007,9 @@ void RegisterBlockchainRPCCommands(CRPCTable &t)
 {
     for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
         t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+
+    // Methods with large results are written out while they are produced when called over HTTP
+    t.appendStreamCommand("getblock", &getblock_stream);
+    t.appendStreamCommand("getrawmempool", &getrawmempool_stream);
+    t.appendStreamCommand("getblockflodata", &getblockflodata_stream);
 }
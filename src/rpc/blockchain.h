@@ -6,10 +6,25 @@
 #ifndef BITCOIN_RPC_BLOCKCHAIN_H
 #define BITCOIN_RPC_BLOCKCHAIN_H
 
+#include "amount.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
 class CBlock;
 class CBlockIndex;
+class JSONStreamWriter;
 class UniValue;
 
+/** Maximum number of threads reading blocks for one getblockflodata call */
+static const int MAX_FLODATA_READ_THREADS = 16;
+/** Maximum number of blocks scanned by one getblockflodata or /rest/blockflodata/ request */
+static const int MAX_FLODATA_RANGE_BLOCKS = 10000;
+
 /**
  * Get the difficulty of the net wrt to the given block index, or the chain tip if
  * not provided.
@@ -25,14 +40,61 @@ void RPCNotifyBlockChange(bool ibd, const CBlockIndex *);
 /** Block description to JSON */
 UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 
+/** Block description to a JSON stream. The chain-dependent fields are passed
+ * in, so this can run without cs_main; see GetBlockChainPosition. */
+void blockToJSONStream(const CBlock& block, const CBlockIndex* blockindex, int confirmations, const CBlockIndex* pnext, JSONStreamWriter& out, bool txDetails = false);
+
+/** Confirmations and successor of a block in the active chain, as reported by blockToJSON. Requires cs_main. */
+void GetBlockChainPosition(const CBlockIndex* blockindex, int& confirmations, const CBlockIndex*& pnext);
+
 /** Mempool information to JSON */
 UniValue mempoolInfoToJSON();
 
 /** Mempool to JSON */
 UniValue mempoolToJSON(bool fVerbose = false);
 
+/** Mempool to a JSON stream, same output as mempoolToJSON */
+void mempoolToJSONStream(JSONStreamWriter& out, bool fVerbose = false);
+
 /** Block header to JSON */
 UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
+/** A transaction with floData, as returned by getblockflodata and /rest/blockflodata */
+struct CFloDataEntry
+{
+    int32_t nHeight;
+    uint256 txid;
+    uint32_t nOutputs;
+    CAmount nValueOut;
+    std::string strFloData;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(txid);
+        READWRITE(nOutputs);
+        READWRITE(nValueOut);
+        READWRITE(strFloData);
+    }
+};
+
+/** floData entry to JSON */
+UniValue floDataEntryToJSON(const CFloDataEntry& entry);
+
+/** floData entry to a JSON stream, same output as floDataEntryToJSON */
+void floDataEntryToJSONStream(const CFloDataEntry& entry, JSONStreamWriter& out);
+
+/**
+ * Read the given blocks, up to nThreads of them at a time, and pass the
+ * transactions with floData of each block to fn, in the order of blocks.
+ * Returns false if a block could not be read (e.g. it was pruned), or fn
+ * returned false; no further blocks are passed to fn then.
+ */
+bool ReadBlockFloDataRange(const std::vector<const CBlockIndex*>& blocks, int nThreads,
+                           const std::function<bool(const CBlockIndex*, const std::vector<CFloDataEntry>&)>& fn);
+
 #endif
 
@@ -762,7 +762,7 @@ UniValue submitblock(const JSONRPCRequest& request)
     }
 
     submitblock_StateCatcher sc(block.GetHash());
-    RegisterValidationInterface(&sc);
+    RegisterValidationInterface(&sc, "submitblock");
     bool fAccepted = ProcessNewBlock(Params(), blockptr, true, nullptr);
     UnregisterValidationInterface(&sc);
     if (fBlockPresent) {
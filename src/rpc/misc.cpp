@@ -18,6 +18,7 @@
 #include "timedata.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "validationinterface.h"
 #ifdef ENABLE_WALLET
 #include "wallet/rpcwallet.h"
 #include "wallet/wallet.h"
@@ -569,6 +570,49 @@ UniValue getmemoryinfo(const JSONRPCRequest& request)
     }
 }
 
+UniValue getvalidationinterfaceinfo(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getvalidationinterfaceinfo\n"
+            "\nReturns statistics of the listeners notified of validation events (new blocks, mempool transactions).\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\" : \"name\",          (string) The listener, e.g. wallet:<file>, zmq or peerlogic\n"
+            "    \"async\" : true|false,       (boolean) Whether its callbacks are made by a thread of its own\n"
+            "    \"queue_size\" : n,           (numeric) Callbacks waiting to be made\n"
+            "    \"queue_limit\" : n,          (numeric) Callbacks that may wait before validation waits for the listener, 0 if not async\n"
+            "    \"queue_peak\" : n,           (numeric) Highest number of callbacks that waited\n"
+            "    \"callbacks\" : n,            (numeric) Callbacks made\n"
+            "    \"callback_time\" : n,        (numeric) Total time spent in callbacks, in microseconds\n"
+            "    \"callback_max_time\" : n,    (numeric) Longest callback, in microseconds\n"
+            "    \"blocked_time\" : n          (numeric) Total time validation waited for room in the queue, in microseconds\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getvalidationinterfaceinfo", "")
+            + HelpExampleRpc("getvalidationinterfaceinfo", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    for (const ValidationInterfaceStats& stats : GetValidationInterfaceStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("async", stats.fAsync));
+        obj.push_back(Pair("queue_size", (uint64_t)stats.nQueueSize));
+        obj.push_back(Pair("queue_limit", (uint64_t)stats.nMaxQueueSize));
+        obj.push_back(Pair("queue_peak", (uint64_t)stats.nPeakQueueSize));
+        obj.push_back(Pair("callbacks", stats.nCallbacks));
+        obj.push_back(Pair("callback_time", stats.nCallbackMicros));
+        obj.push_back(Pair("callback_max_time", stats.nMaxCallbackMicros));
+        obj.push_back(Pair("blocked_time", stats.nBlockedMicros));
+        result.push_back(obj);
+    }
+    return result;
+}
+
 uint32_t getCategoryMask(UniValue cats) {
     cats = cats.get_array();
     uint32_t mask = 0;
@@ -654,6 +698,7 @@ static const CRPCCommand commands[] =
   //  --------------------- ------------------------  -----------------------  ----------
     { "control",            "getinfo",                &getinfo,                true,  {} }, /* uses wallet if enabled */
     { "control",            "getmemoryinfo",          &getmemoryinfo,          true,  {"mode"} },
+    { "control",            "getvalidationinterfaceinfo", &getvalidationinterfaceinfo, true, {} },
     { "util",               "validateaddress",        &validateaddress,        true,  {"address"} }, /* uses wallet if enabled */
     { "util",               "createmultisig",         &createmultisig,         true,  {"nrequired","keys"} },
     { "util",               "verifymessage",          &verifymessage,          true,  {"address","signature","message"} },
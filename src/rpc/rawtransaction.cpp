@@ -875,29 +875,46 @@ UniValue signrawtransaction(const JSONRPCRequest& request)
     // Use CTransaction for the constant parts of the
     // transaction to avoid rehashing.
     const CTransaction txConst(mtx);
-    // Sign what we can:
+    const PrecomputedTransactionData txdata(txConst);
+
+    // Look up the outputs being spent, the view is not thread safe
+    std::vector<const Coin*> vCoins(mtx.vin.size());
     for (unsigned int i = 0; i < mtx.vin.size(); i++) {
-        CTxIn& txin = mtx.vin[i];
-        const Coin& coin = view.AccessCoin(txin.prevout);
-        if (coin.IsSpent()) {
-            TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
-            continue;
+        const Coin& coin = view.AccessCoin(mtx.vin[i].prevout);
+        if (!coin.IsSpent())
+            vCoins[i] = &coin;
+    }
+
+    // Sign what we can, signing and verifying inputs in parallel. A signature
+    // only commits to the scriptSig of its own input, so every input can be
+    // signed against txConst.
+    std::vector<SignatureData> vSigData(mtx.vin.size());
+    std::vector<std::string> vInputErrors(mtx.vin.size());
+    ForEachTxInput(txConst, [&](unsigned int i) {
+        if (!vCoins[i]) {
+            vInputErrors[i] = "Input not found or already spent";
+            return;
         }
-        const CScript& prevPubKey = coin.out.scriptPubKey;
-        const CAmount& amount = coin.out.nValue;
+        const CScript& prevPubKey = vCoins[i]->out.scriptPubKey;
+        const CAmount& amount = vCoins[i]->out.nValue;
 
         SignatureData sigdata;
         // Only sign SIGHASH_SINGLE if there's a corresponding output:
         if (!fHashSingle || (i < mtx.vout.size()))
-            ProduceSignature(MutableTransactionSignatureCreator(&keystore, &mtx, i, amount, nHashType), prevPubKey, sigdata);
-        sigdata = CombineSignatures(prevPubKey, TransactionSignatureChecker(&txConst, i, amount), sigdata, DataFromTransaction(mtx, i));
-
-        UpdateTransaction(mtx, i, sigdata);
+            ProduceSignature(TransactionSignatureCreator(&keystore, &txConst, i, amount, nHashType, &txdata), prevPubKey, sigdata);
+        vSigData[i] = CombineSignatures(prevPubKey, TransactionSignatureChecker(&txConst, i, amount, txdata), sigdata, DataFromTransaction(mtx, i));
 
         ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, &txin.scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount), &serror)) {
-            TxInErrorToJSON(txin, vErrors, ScriptErrorString(serror));
+        if (!VerifyScript(vSigData[i].scriptSig, prevPubKey, &vSigData[i].scriptWitness, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&txConst, i, amount, txdata), &serror)) {
+            vInputErrors[i] = ScriptErrorString(serror);
         }
+    });
+
+    for (unsigned int i = 0; i < mtx.vin.size(); i++) {
+        if (vCoins[i])
+            UpdateTransaction(mtx, i, vSigData[i]);
+        if (!vInputErrors[i].empty())
+            TxInErrorToJSON(mtx.vin[i], vErrors, vInputErrors[i]);
     }
     bool fComplete = vErrors.empty();
 
@@ -989,6 +1006,176 @@ UniValue sendrawtransaction(const JSONRPCRequest& request)
     return hashTx.GetHex();
 }
 
+/** Maximum number of transactions accepted by a single sendrawtransactions call */
+static const unsigned int MAX_SENDRAWTRANSACTIONS_BATCH = 1000;
+
+UniValue sendrawtransactions(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() < 1 || request.params.size() > 2)
+        throw std::runtime_error(
+            "sendrawtransactions [\"hexstring\",...] ( allowhighfees )\n"
+            "\nSubmits a batch of raw transactions (serialized, hex-encoded) to local node and network.\n"
+            "\nThe transactions are decoded before cs_main is taken, then admitted to the mempool in\n"
+            "dependency order (parents before children) under a single lock and relayed together.\n"
+            "A failure of one transaction does not abort the rest of the batch.\n"
+            + strprintf("At most %u transactions may be submitted per call.\n", MAX_SENDRAWTRANSACTIONS_BATCH) +
+            "\nArguments:\n"
+            "1. \"hexstrings\"   (array, required) A json array of raw transaction hex strings\n"
+            "     [\n"
+            "       \"hexstring\"  (string) The hex string of a raw transaction\n"
+            "       ,...\n"
+            "     ]\n"
+            "2. allowhighfees    (boolean, optional, default=false) Allow high fees\n"
+            "\nResult:\n"
+            "[                   (json array of objects, in the same order as the input)\n"
+            "  {\n"
+            "    \"txid\" : \"hash\",   (string) The transaction hash in hex, absent if the transaction could not be decoded\n"
+            "    \"accepted\" : true|false, (boolean) Whether the transaction is now in the mempool\n"
+            "    \"error\" : \"text\"   (string) The reason the transaction was not accepted, if any\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("sendrawtransactions", "\"[\\\"signedhex\\\",\\\"signedhex\\\"]\"")
+            + HelpExampleRpc("sendrawtransactions", "[\"signedhex\",\"signedhex\"]")
+        );
+
+    RPCTypeCheck(request.params, {UniValue::VARR, UniValue::VBOOL});
+
+    const UniValue& hexes = request.params[0].get_array();
+    if (hexes.size() > MAX_SENDRAWTRANSACTIONS_BATCH)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Too many transactions, the limit is %u", MAX_SENDRAWTRANSACTIONS_BATCH));
+
+    CAmount nMaxRawTxFee = maxTxFee;
+    if (request.params.size() > 1 && request.params[1].get_bool())
+        nMaxRawTxFee = 0;
+
+    // Decode the whole batch before touching cs_main
+    std::vector<CTransactionRef> vtxDecoded(hexes.size());
+    std::vector<std::string> vError(hexes.size());
+    std::map<uint256, size_t> mapBatchIndex;
+    for (size_t i = 0; i < hexes.size(); i++) {
+        if (!hexes[i].isStr()) {
+            vError[i] = "TX decode failed";
+            continue;
+        }
+        CMutableTransaction mtx;
+        if (!DecodeHexTx(mtx, hexes[i].get_str())) {
+            vError[i] = "TX decode failed";
+            continue;
+        }
+        if (mtx.strFloData.length() > CTransaction::MAX_FLO_DATA_SIZE) {
+            vError[i] = "Flo Data too large";
+            continue;
+        }
+        vtxDecoded[i] = MakeTransactionRef(std::move(mtx));
+        mapBatchIndex.emplace(vtxDecoded[i]->GetHash(), i);
+    }
+
+    // Order the batch so that every transaction comes after the in-batch
+    // transactions it spends from (Kahn's topological sort, seeded in input
+    // order so unrelated transactions keep their relative position).
+    std::vector<std::vector<size_t>> vChildren(hexes.size());
+    std::vector<size_t> vParentCount(hexes.size(), 0);
+    for (size_t i = 0; i < hexes.size(); i++) {
+        if (!vtxDecoded[i])
+            continue;
+        for (const CTxIn& txin : vtxDecoded[i]->vin) {
+            auto it = mapBatchIndex.find(txin.prevout.hash);
+            if (it != mapBatchIndex.end() && it->second != i) {
+                vChildren[it->second].push_back(i);
+                vParentCount[i]++;
+            }
+        }
+    }
+    std::vector<size_t> vOrder;
+    vOrder.reserve(hexes.size());
+    for (size_t i = 0; i < hexes.size(); i++) {
+        if (vtxDecoded[i] && vParentCount[i] == 0)
+            vOrder.push_back(i);
+    }
+    for (size_t n = 0; n < vOrder.size(); n++) {
+        for (size_t child : vChildren[vOrder[n]]) {
+            if (--vParentCount[child] == 0)
+                vOrder.push_back(child);
+        }
+    }
+    // Anything left over is part of a cycle, which cannot be valid; submit it
+    // last so it is rejected with a per-transaction error.
+    for (size_t i = 0; i < hexes.size(); i++) {
+        if (vtxDecoded[i] && vParentCount[i] != 0)
+            vOrder.push_back(i);
+    }
+
+    std::vector<bool> vAccepted(hexes.size(), false);
+    std::vector<CInv> vInv;
+    {
+        LOCK(cs_main);
+
+        CCoinsViewCache &view = *pcoinsTip;
+        std::vector<CTransactionRef> vtxSubmit;
+        std::vector<size_t> vSubmitIndex;
+        for (size_t i : vOrder) {
+            const CTransactionRef& tx = vtxDecoded[i];
+            const uint256& hashTx = tx->GetHash();
+            bool fHaveChain = false;
+            for (size_t o = 0; !fHaveChain && o < tx->vout.size(); o++) {
+                const Coin& existingCoin = view.AccessCoin(COutPoint(hashTx, o));
+                fHaveChain = !existingCoin.IsSpent();
+            }
+            if (fHaveChain) {
+                vError[i] = "transaction already in block chain";
+            } else if (mempool.exists(hashTx)) {
+                vAccepted[i] = true;
+                vInv.push_back(CInv(MSG_TX, hashTx));
+            } else {
+                vtxSubmit.push_back(tx);
+                vSubmitIndex.push_back(i);
+            }
+        }
+
+        std::vector<CValidationState> vState;
+        std::vector<bool> vSubmitAccepted, vMissingInputs;
+        AcceptToMemoryPoolBatch(mempool, vState, vtxSubmit, true, vSubmitAccepted, vMissingInputs, nMaxRawTxFee);
+        for (size_t j = 0; j < vtxSubmit.size(); j++) {
+            const size_t i = vSubmitIndex[j];
+            if (vSubmitAccepted[j]) {
+                vAccepted[i] = true;
+                vInv.push_back(CInv(MSG_TX, vtxSubmit[j]->GetHash()));
+            } else if (vState[j].IsInvalid()) {
+                vError[i] = strprintf("%i: %s", vState[j].GetRejectCode(), vState[j].GetRejectReason());
+            } else if (vMissingInputs[j]) {
+                vError[i] = "Missing inputs";
+            } else {
+                vError[i] = vState[j].GetRejectReason();
+            }
+        }
+    }
+
+    if (!vInv.empty()) {
+        if(!g_connman)
+            throw JSONRPCError(RPC_CLIENT_P2P_DISABLED, "Error: Peer-to-peer functionality missing or disabled");
+
+        g_connman->ForEachNode([&vInv](CNode* pnode)
+        {
+            for (const CInv& inv : vInv)
+                pnode->PushInventory(inv);
+        });
+    }
+
+    UniValue result(UniValue::VARR);
+    for (size_t i = 0; i < hexes.size(); i++) {
+        UniValue entry(UniValue::VOBJ);
+        if (vtxDecoded[i])
+            entry.push_back(Pair("txid", vtxDecoded[i]->GetHash().GetHex()));
+        entry.push_back(Pair("accepted", vAccepted[i]));
+        if (!vAccepted[i])
+            entry.push_back(Pair("error", vError[i]));
+        result.push_back(entry);
+    }
+    return result;
+}
+
 static const CRPCCommand commands[] =
 { //  category              name                      actor (function)         okSafeMode
   //  --------------------- ------------------------  -----------------------  ----------
@@ -997,6 +1184,7 @@ static const CRPCCommand commands[] =
     { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,  {"hexstring"} },
     { "rawtransactions",    "decodescript",           &decodescript,           true,  {"hexstring"} },
     { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false, {"hexstring","allowhighfees"} },
+    { "rawtransactions",    "sendrawtransactions",    &sendrawtransactions,    false, {"hexstrings","allowhighfees"} },
     { "rawtransactions",    "combinerawtransaction",  &combinerawtransaction,  true,  {"txs"} },
     { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false, {"hexstring","prevtxs","privkeys","sighashtype"} }, /* uses wallet if enabled */
 
@@ -23,7 +23,11 @@
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
 
+#include <atomic>
+#include <condition_variable>
 #include <memory> // for unique_ptr
+#include <mutex>
+#include <set>
 #include <unordered_map>
 
 static bool fRPCRunning = false;
@@ -310,6 +314,18 @@ bool CRPCTable::appendCommand(const std::string& name, const CRPCCommand* pcmd)
     return true;
 }
 
+bool CRPCTable::appendStreamCommand(const std::string& name, rpcstreamfn_type fn)
+{
+    if (IsRPCRunning())
+        return false;
+
+    if (!mapCommands.count(name) || mapStreamCommands.count(name))
+        return false;
+
+    mapStreamCommands[name] = fn;
+    return true;
+}
+
 bool StartRPC()
 {
     LogPrint(BCLog::RPC, "Starting RPC\n");
@@ -412,11 +428,96 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+/** Calls that only read state, and so may run concurrently within a batch */
+static const std::set<std::string> setBatchConcurrentMethods = {
+    "decoderawtransaction", "decodescript", "getbestblockhash", "getblock",
+    "getblockchaininfo", "getblockcount", "getblockhash", "getblockheader",
+    "getchaintips", "getdifficulty", "getmempoolancestors", "getmempooldescendants",
+    "getmempoolentry", "getmempoolinfo", "getrawmempool", "getrawtransaction",
+    "gettxout", "gettxoutproof", "validateaddress", "verifytxoutproof",
+};
+
+static bool IsBatchConcurrentCall(const UniValue& req)
+{
+    if (!req.isObject())
+        return false;
+    const UniValue& method = find_value(req, "method");
+    return method.isStr() && setBatchConcurrentMethods.count(method.get_str());
+}
+
+/** Range of batch calls that is worked off by the calling thread and any dispatched helpers */
+class BatchRange
 {
+private:
+    const UniValue& vReq;
+    std::vector<UniValue>& vResults;
+    std::atomic<size_t> nNext;
+    const size_t nEnd;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    size_t nRemaining;
+
+public:
+    BatchRange(const UniValue& vReqIn, std::vector<UniValue>& vResultsIn, size_t nBegin, size_t nEndIn) :
+        vReq(vReqIn), vResults(vResultsIn), nNext(nBegin), nEnd(nEndIn), nRemaining(nEndIn - nBegin) {}
+
+    /** Claim and execute the next call. Returns false once every call has been claimed. */
+    bool RunOne()
+    {
+        // A helper that only starts after all calls were claimed must not touch vReq or
+        // vResults: the caller may already have returned. Claimed calls keep it waiting.
+        const size_t i = nNext++;
+        if (i >= nEnd)
+            return false;
+        UniValue result = JSONRPCExecOne(vReq[i]);
+        std::lock_guard<std::mutex> lock(cs);
+        vResults[i] = std::move(result);
+        if (--nRemaining == 0)
+            cond.notify_all();
+        return true;
+    }
+
+    /** Wait until every claimed call has finished */
+    void Wait()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (nRemaining > 0)
+            cond.wait(lock);
+    }
+};
+
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCBatchDispatcher& dispatch, int nMaxConcurrency)
+{
+    std::vector<UniValue> vResults(vReq.size());
+    size_t reqIdx = 0;
+    while (reqIdx < vReq.size()) {
+        size_t nEnd = reqIdx;
+        while (nEnd < vReq.size() && IsBatchConcurrentCall(vReq[nEnd]))
+            nEnd++;
+        if (nEnd - reqIdx < 2 || !dispatch || nMaxConcurrency < 2) {
+            // Calls with side effects (or a lone read) keep their place in the sequence
+            nEnd = std::max(nEnd, reqIdx + 1);
+            for (; reqIdx < nEnd; reqIdx++)
+                vResults[reqIdx] = JSONRPCExecOne(vReq[reqIdx]);
+            continue;
+        }
+
+        std::shared_ptr<BatchRange> range = std::make_shared<BatchRange>(vReq, vResults, reqIdx, nEnd);
+        const size_t nHelpers = std::min<size_t>(nMaxConcurrency - 1, nEnd - reqIdx - 1);
+        for (size_t i = 0; i < nHelpers; i++) {
+            // Never block on a full work queue: the calling thread works off whatever is left
+            if (!dispatch([range]{ while (range->RunOne()) {} }))
+                break;
+        }
+        while (range->RunOne()) {}
+        range->Wait();
+        reqIdx = nEnd;
+    }
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    for (const UniValue& result : vResults)
+        ret.push_back(result);
 
     return ret.write() + "\n";
 }
@@ -502,6 +603,41 @@ UniValue CRPCTable::execute(const JSONRPCRequest &request) const
     }
 }
 
+bool CRPCTable::hasStreamCommand(const std::string& name) const
+{
+    return mapStreamCommands.count(name) != 0;
+}
+
+void CRPCTable::executeStream(const JSONRPCRequest &request, JSONStreamWriter& out) const
+{
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    const CRPCCommand *pcmd = tableRPC[request.strMethod];
+    std::map<std::string, rpcstreamfn_type>::const_iterator it = mapStreamCommands.find(request.strMethod);
+    if (!pcmd || it == mapStreamCommands.end())
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        if (request.params.isObject()) {
+            it->second(transformNamedArguments(request, pcmd->argNames), out);
+        } else {
+            it->second(request, out);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
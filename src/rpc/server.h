@@ -11,6 +11,7 @@
 #include "rpc/protocol.h"
 #include "uint256.h"
 
+#include <functional>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -18,7 +19,10 @@
 
 #include <univalue.h>
 
+class JSONStreamWriter;
+
 static const unsigned int DEFAULT_RPC_SERIALIZE_VERSION = 1;
+static const int DEFAULT_RPC_BATCH_CONCURRENCY = 4;
 
 class CRPCCommand;
 
@@ -128,6 +132,8 @@ void RPCUnsetTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, std::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const JSONRPCRequest& jsonRequest);
+/** Variant of an RPC method that writes its result value directly to a JSONStreamWriter */
+typedef void(*rpcstreamfn_type)(const JSONRPCRequest& jsonRequest, JSONStreamWriter& out);
 
 class CRPCCommand
 {
@@ -146,6 +152,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, rpcstreamfn_type> mapStreamCommands;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -159,6 +166,16 @@ public:
      */
     UniValue execute(const JSONRPCRequest &request) const;
 
+    /** Whether the method has a streaming variant registered with appendStreamCommand. */
+    bool hasStreamCommand(const std::string& name) const;
+
+    /**
+     * Execute the streaming variant of a method, writing its result value to out.
+     * Streaming variants report all errors before writing any output, so an
+     * exception (UniValue) thrown here leaves out untouched.
+     */
+    void executeStream(const JSONRPCRequest &request, JSONStreamWriter& out) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -172,6 +189,12 @@ public:
      * Commands cannot be overwritten (returns false).
      */
     bool appendCommand(const std::string& name, const CRPCCommand* pcmd);
+
+    /**
+     * Registers a streaming variant for an already appended command. It must
+     * produce the same result as the command's actor.
+     */
+    bool appendStreamCommand(const std::string& name, rpcstreamfn_type fn);
 };
 
 extern CRPCTable tableRPC;
@@ -192,7 +215,15 @@ extern std::string HelpExampleRpc(const std::string& methodname, const std::stri
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+/** Runs a function on another thread. Returns false if it could not be scheduled. */
+typedef std::function<bool(const std::function<void(void)>&)> RPCBatchDispatcher;
+/**
+ * Execute a JSON-RPC batch and return the serialized reply array, in request order.
+ * Consecutive read-only calls are spread over up to nMaxConcurrency threads
+ * (the calling thread plus work handed to dispatch); all other calls run
+ * alone, in order, so a batch that writes and then reads sees its own writes.
+ */
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCBatchDispatcher& dispatch = nullptr, int nMaxConcurrency = 1);
 
 // Retrieves any serialization flags requested in command line argument
 int RPCSerializationFlags();
@@ -27,8 +27,33 @@ unsigned int HaveKeys(const std::vector<valtype>& pubkeys, const CKeyStore& keys
     return nResult;
 }
 
+/**
+ * Whether scriptPubKey is in a form IsMine() can only consider ours if it is
+ * in the key store's scriptPubKey set: the exact byte patterns of P2PKH,
+ * P2PK, P2SH and witness outputs, and OP_RETURN outputs. Anything else, such
+ * as bare multisig or non-minimally pushed keys, needs the full check.
+ */
+static bool IsCanonicalScriptPubKey(const CScript& scriptPubKey)
+{
+    int witnessversion;
+    std::vector<unsigned char> witnessprogram;
+    if (scriptPubKey.IsPayToScriptHash() || scriptPubKey.IsWitnessProgram(witnessversion, witnessprogram))
+        return true;
+    if (scriptPubKey.size() == 25 && scriptPubKey[0] == OP_DUP && scriptPubKey[1] == OP_HASH160 && scriptPubKey[2] == 20 &&
+        scriptPubKey[23] == OP_EQUALVERIFY && scriptPubKey[24] == OP_CHECKSIG)
+        return true;
+    if (((scriptPubKey.size() == 35 && scriptPubKey[0] == 33) || (scriptPubKey.size() == 67 && scriptPubKey[0] == 65)) &&
+        scriptPubKey.back() == OP_CHECKSIG)
+        return true;
+    return scriptPubKey.size() > 0 && scriptPubKey[0] == OP_RETURN;
+}
+
 isminetype IsMine(const CKeyStore& keystore, const CScript& scriptPubKey, SigVersion sigversion)
 {
+    // Most outputs are not ours: rule them out with a single lookup
+    if (sigversion == SIGVERSION_BASE && IsCanonicalScriptPubKey(scriptPubKey) && !keystore.HaveScriptPubKey(scriptPubKey))
+        return ISMINE_NO;
+
     bool isInvalid = false;
     return IsMine(keystore, scriptPubKey, isInvalid, sigversion);
 }
@@ -9,6 +9,8 @@
 
 #include "script/interpreter.h"
 
+#include <functional>
+
 class CKeyID;
 class CKeyStore;
 class CScript;
@@ -16,6 +18,9 @@ class CTransaction;
 
 struct CMutableTransaction;
 
+/** Minimum number of inputs per thread when signing a transaction on multiple threads */
+static const unsigned int MIN_INPUTS_PER_SIGNING_THREAD = 16;
+
 /** Virtual base class for signature creators. */
 class BaseSignatureCreator {
 protected:
@@ -31,16 +36,17 @@ public:
     virtual bool CreateSig(std::vector<unsigned char>& vchSig, const CKeyID& keyid, const CScript& scriptCode, SigVersion sigversion) const =0;
 };
 
-/** A signature creator for transactions. */
+/** A signature creator for transactions. txdata, if given, must outlive the creator. */
 class TransactionSignatureCreator : public BaseSignatureCreator {
     const CTransaction* txTo;
     unsigned int nIn;
     int nHashType;
     CAmount amount;
+    const PrecomputedTransactionData* txdata;
     const TransactionSignatureChecker checker;
 
 public:
-    TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn=SIGHASH_ALL);
+    TransactionSignatureCreator(const CKeyStore* keystoreIn, const CTransaction* txToIn, unsigned int nInIn, const CAmount& amountIn, int nHashTypeIn=SIGHASH_ALL, const PrecomputedTransactionData* txdataIn=nullptr);
     const BaseSignatureChecker& Checker() const override { return checker; }
     bool CreateSig(std::vector<unsigned char>& vchSig, const CKeyID& keyid, const CScript& scriptCode, SigVersion sigversion) const override;
 };
@@ -75,6 +81,13 @@ bool ProduceSignature(const BaseSignatureCreator& creator, const CScript& script
 bool SignSignature(const CKeyStore &keystore, const CScript& fromPubKey, CMutableTransaction& txTo, unsigned int nIn, const CAmount& amount, int nHashType);
 bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType);
 
+/**
+ * Call fn(nIn) for every input of tx, spread over multiple threads when tx has
+ * many inputs. fn may only modify state belonging to its own input. If fn
+ * throws, the exception is rethrown on the calling thread.
+ */
+void ForEachTxInput(const CTransaction& tx, const std::function<void(unsigned int)>& fn);
+
 /** Combine two script signatures using a generic signature checker, intelligently, possibly with OP_0 placeholders. */
 SignatureData CombineSignatures(const CScript& scriptPubKey, const BaseSignatureChecker& checker, const SignatureData& scriptSig1, const SignatureData& scriptSig2);
 
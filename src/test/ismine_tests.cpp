@@ -0,0 +1,65 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "keystore.h"
+#include "script/ismine.h"
+#include "script/script.h"
+#include "script/standard.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(ismine_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(ismine_scriptpubkey_set)
+{
+    CBasicKeyStore keystore;
+    CKey key, otherKey;
+    key.MakeNewKey(true);
+    otherKey.MakeNewKey(true);
+    CPubKey pubkey = key.GetPubKey();
+    BOOST_CHECK(keystore.AddKey(key));
+
+    // Canonical P2PKH and P2PK outputs are found in the scriptPubKey set
+    BOOST_CHECK_EQUAL(IsMine(keystore, GetScriptForDestination(pubkey.GetID())), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(IsMine(keystore, GetScriptForRawPubKey(pubkey)), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(IsMine(keystore, GetScriptForDestination(otherKey.GetPubKey().GetID())), ISMINE_NO);
+
+    // A P2PKH output with a non-minimal push is not in the set, but still ours
+    CScript nonMinimal;
+    nonMinimal << OP_DUP << OP_HASH160;
+    nonMinimal.insert(nonMinimal.end(), OP_PUSHDATA1);
+    nonMinimal.insert(nonMinimal.end(), 20);
+    CKeyID keyID = pubkey.GetID();
+    nonMinimal.insert(nonMinimal.end(), keyID.begin(), keyID.end());
+    nonMinimal << OP_EQUALVERIFY << OP_CHECKSIG;
+    BOOST_CHECK(!keystore.HaveScriptPubKey(nonMinimal));
+    BOOST_CHECK_EQUAL(IsMine(keystore, nonMinimal), ISMINE_SPENDABLE);
+
+    // So are bare multisig outputs of our keys
+    CScript multisig = GetScriptForMultisig(1, {pubkey});
+    BOOST_CHECK(!keystore.HaveScriptPubKey(multisig));
+    BOOST_CHECK_EQUAL(IsMine(keystore, multisig), ISMINE_SPENDABLE);
+
+    // P2SH and bare witness outputs become ours when their script is added
+    CScript witness = GetScriptForWitness(GetScriptForDestination(pubkey.GetID()));
+    BOOST_CHECK_EQUAL(IsMine(keystore, witness), ISMINE_NO);
+    BOOST_CHECK_EQUAL(IsMine(keystore, GetScriptForDestination(CScriptID(witness))), ISMINE_NO);
+    BOOST_CHECK(keystore.AddCScript(witness));
+    BOOST_CHECK_EQUAL(IsMine(keystore, witness), ISMINE_SPENDABLE);
+    BOOST_CHECK_EQUAL(IsMine(keystore, GetScriptForDestination(CScriptID(witness))), ISMINE_SPENDABLE);
+
+    // Watch-only scripts are found in the set too, and stay there when removed
+    CScript nullData = CScript() << OP_RETURN << std::vector<unsigned char>(4, 0xab);
+    BOOST_CHECK_EQUAL(IsMine(keystore, nullData), ISMINE_NO);
+    BOOST_CHECK(keystore.AddWatchOnly(nullData));
+    BOOST_CHECK_EQUAL(IsMine(keystore, nullData), ISMINE_WATCH_UNSOLVABLE);
+    BOOST_CHECK(keystore.RemoveWatchOnly(nullData));
+    BOOST_CHECK(keystore.HaveScriptPubKey(nullData));
+    BOOST_CHECK_EQUAL(IsMine(keystore, nullData), ISMINE_NO);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,217 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include "chainparams.h"
+#include "core_io.h"
+#include "primitives/transaction.h"
+#include "rpc/blockchain.h"
+#include "script/standard.h"
+#include "txmempool.h"
+#include "validation.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    std::string strOut;
+    JSONStreamWriter out([&strOut](const std::string& chunk) { strOut += chunk; return true; }, 8);
+
+    std::string strEscapes("quote\" backslash\\ tab\t nl\n del\x7f ctl\x01");
+    UniValue obj(UniValue::VOBJ);
+    obj.pushKV("str", strEscapes);
+    obj.pushKV("neg", -42);
+    obj.pushKV("big", (uint64_t)18446744073709551615ULL);
+    obj.pushKV("dbl", 1.0 / 3);
+    obj.pushKV("t", UniValue(true));
+    obj.pushKV("n", NullUniValue);
+    UniValue arr(UniValue::VARR);
+    arr.push_back(UniValue(UniValue::VOBJ));
+    arr.push_back(UniValue(UniValue::VARR));
+    arr.push_back(ValueFromAmount(-123456789));
+    obj.pushKV("arr", arr);
+
+    out.BeginObject();
+    out.KV("str", strEscapes);
+    out.KV("neg", -42);
+    out.KV("big", (uint64_t)18446744073709551615ULL);
+    out.KV("dbl", 1.0 / 3);
+    out.KV("t", true);
+    out.Key("n");
+    out.Null();
+    out.Key("arr");
+    out.BeginArray();
+    out.BeginObject();
+    out.EndObject();
+    out.BeginArray();
+    out.EndArray();
+    out.Value(ValueFromAmount(-123456789));
+    out.EndArray();
+    out.EndObject();
+
+    // The small chunk size forced output to the sink along the way
+    BOOST_CHECK(out.HasFlushed());
+    out.Flush();
+    BOOST_CHECK_EQUAL(strOut, obj.write());
+    BOOST_CHECK(out.ReleaseBuffer().empty());
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_closed_sink_stops_producer)
+{
+    int nChunks = 0;
+    JSONStreamWriter out([&nChunks](const std::string&) { return ++nChunks < 3; }, 16);
+
+    int nValues = 0;
+    bool fClosed = false;
+    out.BeginArray();
+    try {
+        for (nValues = 0; nValues < 1000; nValues++)
+            out.Value(std::string(20, 'x'));
+    } catch (const JSONStreamClosed&) {
+        fClosed = true;
+    }
+    // Production stopped at the chunk the sink refused, and stays stopped
+    BOOST_CHECK(fClosed);
+    BOOST_CHECK_EQUAL(nChunks, 3);
+    BOOST_CHECK_EQUAL(nValues, 2);
+    BOOST_CHECK_THROW(out.Flush(), JSONStreamClosed);
+    BOOST_CHECK_EQUAL(nChunks, 3);
+}
+
+/** Run a streaming producer into a string, with a small chunk size so the sink is exercised */
+static std::string StreamToString(const std::function<void(JSONStreamWriter&)>& produce)
+{
+    std::string strOut;
+    JSONStreamWriter out([&strOut](const std::string& chunk) { strOut += chunk; return true; }, 16);
+    produce(out);
+    out.Flush();
+    return strOut;
+}
+
+static std::string TxToJSONStreamString(const CTransaction& tx, const uint256& hashBlock, bool include_hex, int serialize_flags)
+{
+    return StreamToString([&](JSONStreamWriter& out) {
+        out.BeginObject();
+        TxToJSONStream(tx, hashBlock, out, include_hex, serialize_flags);
+        out.EndObject();
+    });
+}
+
+/** Transactions covering every branch of TxToUniv: coinbase, signed, witness, floData and all output kinds */
+static std::vector<CTransactionRef> VariedTransactions()
+{
+    std::vector<CTransactionRef> vtx;
+
+    CMutableTransaction mtx;
+    std::string rawtx = "0100000001a15d57094aa7a21a28cb20b59aab8fc7d1149a3bdbcddba9c622e4f5f6a99ece010000006c493046022100f93bb0e7d8db7bd46e40132d1f8242026e045f03a0efe71bbb8e3f475e970d790221009337cd7f1f929f00cc6ff01f03729b069a7c21b59b1736ddfee5db5946c5da8c0121033b9b137ee87d5a812d6f506efdd37f0affa7ffc310711c06c7f3e097c9447c52ffffffff0100e1f505000000001976a9140389035a9225b3839e2bbf32d826a1e222031fd888ac00000000";
+    BOOST_REQUIRE(DecodeHexTx(mtx, rawtx));
+    vtx.push_back(MakeTransactionRef(mtx));
+
+    vtx.push_back(Params().GenesisBlock().vtx[0]);
+
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(false);
+    CMutableTransaction mtxWitness;
+    mtxWitness.nVersion = 2;
+    mtxWitness.nLockTime = 500000123;
+    mtxWitness.vin.resize(2);
+    mtxWitness.vin[0].prevout = COutPoint(vtx[0]->GetHash(), 0);
+    mtxWitness.vin[0].scriptWitness.stack = {std::vector<unsigned char>(71, 0x30), ToByteVector(key1.GetPubKey())};
+    mtxWitness.vin[0].nSequence = 0xfffffffd;
+    mtxWitness.vin[1].prevout = COutPoint(vtx[0]->GetHash(), 7);
+    mtxWitness.vin[1].scriptSig = CScript() << OP_0 << std::vector<unsigned char>(20, 0xab);
+    mtxWitness.vout.resize(5);
+    mtxWitness.vout[0].scriptPubKey = CScript() << OP_0 << ToByteVector(key1.GetPubKey().GetID());
+    mtxWitness.vout[0].nValue = 1;
+    mtxWitness.vout[1].scriptPubKey = GetScriptForMultisig(1, {key1.GetPubKey(), key2.GetPubKey()});
+    mtxWitness.vout[1].nValue = 2100000000000000LL;
+    mtxWitness.vout[2].scriptPubKey = CScript() << OP_RETURN << std::vector<unsigned char>(10, 0x42);
+    mtxWitness.vout[3].scriptPubKey = CScript() << OP_TRUE << OP_ADD;
+    mtxWitness.vout[3].nValue = 123456789;
+    mtxWitness.vout[4].scriptPubKey = GetScriptForDestination(CScriptID(mtxWitness.vout[3].scriptPubKey));
+    mtxWitness.vout[4].nValue = 10;
+    mtxWitness.strFloData = "text:quote\" backslash\\ nl\n ctl\x01 utf8 \xc3\xa9";
+    vtx.push_back(MakeTransactionRef(mtxWitness));
+
+    return vtx;
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_tx_matches_univalue)
+{
+    uint256 hashBlock = Params().GenesisBlock().GetHash();
+    for (const CTransactionRef& tx : VariedTransactions()) {
+        for (const uint256& hash : {uint256(), hashBlock}) {
+            for (bool include_hex : {false, true}) {
+                for (int serialize_flags : {0, (int)SERIALIZE_TRANSACTION_NO_WITNESS}) {
+                    UniValue objTx(UniValue::VOBJ);
+                    TxToUniv(*tx, hash, objTx, include_hex, serialize_flags);
+                    BOOST_CHECK_EQUAL(TxToJSONStreamString(*tx, hash, include_hex, serialize_flags), objTx.write());
+                }
+            }
+        }
+    }
+
+    // Small outputs stay buffered until the caller decides what to do with them
+    UniValue objTx(UniValue::VOBJ);
+    TxToUniv(*VariedTransactions()[0], uint256(), objTx);
+    JSONStreamWriter outTx([](const std::string&) { BOOST_ERROR("unexpected flush"); return true; });
+    outTx.BeginObject();
+    TxToJSONStream(*VariedTransactions()[0], uint256(), outTx);
+    outTx.EndObject();
+    BOOST_CHECK(!outTx.HasFlushed());
+    BOOST_CHECK_EQUAL(outTx.ReleaseBuffer(), objTx.write());
+}
+
+BOOST_FIXTURE_TEST_CASE(jsonstream_block_matches_univalue, TestChain100Setup)
+{
+    CBlock block = Params().GenesisBlock();
+    block.vtx = VariedTransactions();
+
+    LOCK(cs_main);
+    // Genesis (no predecessor), a block in the middle of the chain, and the tip (no successor)
+    for (const CBlockIndex* pindex : {chainActive.Genesis(), chainActive[50], chainActive.Tip()}) {
+        int confirmations;
+        const CBlockIndex* pnext;
+        GetBlockChainPosition(pindex, confirmations, pnext);
+        for (bool txDetails : {false, true}) {
+            std::string strBlock = StreamToString([&](JSONStreamWriter& out) {
+                blockToJSONStream(block, pindex, confirmations, pnext, out, txDetails);
+            });
+            BOOST_CHECK_EQUAL(strBlock, blockToJSON(block, pindex, txDetails).write());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_flodata_and_mempool_match_univalue)
+{
+    CFloDataEntry entry;
+    entry.nHeight = 1234;
+    entry.txid = VariedTransactions()[2]->GetHash();
+    entry.nOutputs = 5;
+    entry.nValueOut = 2100000123456799LL;
+    entry.strFloData = VariedTransactions()[2]->strFloData;
+    BOOST_CHECK_EQUAL(StreamToString([&](JSONStreamWriter& out) { floDataEntryToJSONStream(entry, out); }),
+                      floDataEntryToJSON(entry).write());
+
+    TestMemPoolEntryHelper helper;
+    std::vector<CTransactionRef> vtx = VariedTransactions();
+    mempool.addUnchecked(vtx[0]->GetHash(), helper.Fee(1000).Time(1500000000).Height(7).FromTx(*vtx[0]));
+    mempool.addUnchecked(vtx[2]->GetHash(), helper.Fee(123456).FromTx(*vtx[2]));
+    for (bool fVerbose : {false, true}) {
+        BOOST_CHECK_EQUAL(StreamToString([&](JSONStreamWriter& out) { mempoolToJSONStream(out, fVerbose); }),
+                          mempoolToJSON(fVerbose).write());
+    }
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -106,6 +106,82 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     BOOST_CHECK_EQUAL(testPool.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSnapshotTest)
+{
+    // Test CTxMemPool::GetSnapshot() and the read-only views it returns
+
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(2);
+    for (int i = 0; i < 2; i++)
+    {
+        txParent.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txParent.vout[i].nValue = 33000LL;
+    }
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout.hash = txParent.GetHash();
+    txChild.vin[0].prevout.n = 0;
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 11000LL;
+    CMutableTransaction txOther;
+    txOther.vin.resize(1);
+    txOther.vin[0].scriptSig = CScript() << OP_12;
+    txOther.vout.resize(1);
+    txOther.vout[0].scriptPubKey = CScript() << OP_12 << OP_EQUAL;
+    txOther.vout[0].nValue = 11000LL;
+
+    CTxMemPool testPool;
+    CTxMemPoolSnapshotRef empty = testPool.GetSnapshot();
+    BOOST_CHECK(empty->mapEntries.empty());
+    BOOST_CHECK(testPool.GetSnapshot() == empty);
+
+    testPool.addUnchecked(txParent.GetHash(), entry.Fee(1000LL).FromTx(txParent));
+    testPool.addUnchecked(txOther.GetHash(), entry.Fee(2000LL).FromTx(txOther));
+    CTxMemPoolSnapshotRef first = testPool.GetSnapshot();
+    BOOST_CHECK(empty->mapEntries.empty()); // published snapshots never change
+    BOOST_CHECK_EQUAL(first->mapEntries.size(), 2);
+    BOOST_CHECK_EQUAL(first->find(txParent.GetHash())->nFee, 1000LL);
+    BOOST_CHECK(first->find(txChild.GetHash()) == nullptr);
+
+    testPool.addUnchecked(txChild.GetHash(), entry.Fee(3000LL).FromTx(txChild));
+    CTxMemPoolSnapshotRef second = testPool.GetSnapshot();
+    BOOST_CHECK_EQUAL(first->mapEntries.size(), 2);
+    BOOST_CHECK_EQUAL(second->mapEntries.size(), 3);
+    // Unrelated entry is shared, the parent's descendant state was refreshed
+    BOOST_CHECK(second->find(txOther.GetHash()) == first->find(txOther.GetHash()));
+    BOOST_CHECK(second->find(txParent.GetHash()) != first->find(txParent.GetHash()));
+    BOOST_CHECK_EQUAL(second->find(txParent.GetHash())->nCountWithDescendants, 2);
+    BOOST_CHECK_EQUAL(second->find(txParent.GetHash())->nModFeesWithDescendants, 4000LL);
+    BOOST_CHECK_EQUAL(second->find(txChild.GetHash())->nCountWithAncestors, 2);
+
+    std::set<uint256> setAncestors, setDescendants;
+    second->CalculateAncestors(txChild.GetHash(), setAncestors);
+    BOOST_CHECK(setAncestors == std::set<uint256>{txParent.GetHash()});
+    second->CalculateDescendants(txParent.GetHash(), setDescendants);
+    BOOST_CHECK(setDescendants == std::set<uint256>{txChild.GetHash()});
+
+    testPool.PrioritiseTransaction(txOther.GetHash(), 500LL);
+    CTxMemPoolSnapshotRef third = testPool.GetSnapshot();
+    BOOST_CHECK_EQUAL(third->find(txOther.GetHash())->nModifiedFee, 2500LL);
+    BOOST_CHECK(third->find(txChild.GetHash()) == second->find(txChild.GetHash()));
+
+    testPool.removeRecursive(txParent);
+    CTxMemPoolSnapshotRef fourth = testPool.GetSnapshot();
+    BOOST_CHECK_EQUAL(third->mapEntries.size(), 3);
+    BOOST_CHECK_EQUAL(fourth->mapEntries.size(), 1);
+    BOOST_CHECK(fourth->find(txOther.GetHash()) == third->find(txOther.GetHash()));
+    BOOST_CHECK(testPool.GetSnapshot() == fourth);
+
+    testPool.clear();
+    BOOST_CHECK(testPool.GetSnapshot()->mapEntries.empty());
+    BOOST_CHECK_EQUAL(fourth->mapEntries.size(), 1);
+}
+
 template<typename name>
 void CheckSort(CTxMemPool &pool, std::vector<std::string> &sortedOrder)
 {
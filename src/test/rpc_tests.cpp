@@ -9,12 +9,16 @@
 #include "base58.h"
 #include "core_io.h"
 #include "netbase.h"
+#include "validation.h"
 
 #include "test/test_bitcoin.h"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <atomic>
+#include <thread>
+
 #include <univalue.h>
 
 UniValue CallRPC(std::string args)
@@ -81,6 +85,26 @@ BOOST_AUTO_TEST_CASE(rpc_rawparams)
     BOOST_CHECK_THROW(CallRPC("sendrawtransaction null"), std::runtime_error);
     BOOST_CHECK_THROW(CallRPC("sendrawtransaction DEADBEEF"), std::runtime_error);
     BOOST_CHECK_THROW(CallRPC(std::string("sendrawtransaction ")+rawtx+" extra"), std::runtime_error);
+
+    // sendrawtransactions reports per-transaction failures instead of throwing
+    BOOST_CHECK_THROW(CallRPC("sendrawtransactions"), std::runtime_error);
+    BOOST_CHECK_THROW(CallRPC("sendrawtransactions null"), std::runtime_error);
+    BOOST_CHECK_THROW(CallRPC("sendrawtransactions DEADBEEF"), std::runtime_error);
+    BOOST_CHECK_NO_THROW(r = CallRPC(std::string("sendrawtransactions [\"DEADBEEF\",\"")+rawtx+"\"]"));
+    BOOST_CHECK_EQUAL(r.size(), 2);
+    BOOST_CHECK(find_value(r[0].get_obj(), "txid").isNull());
+    BOOST_CHECK_EQUAL(find_value(r[0].get_obj(), "accepted").get_bool(), false);
+    BOOST_CHECK_EQUAL(find_value(r[0].get_obj(), "error").get_str(), "TX decode failed");
+    BOOST_CHECK_EQUAL(find_value(r[1].get_obj(), "txid").get_str(), "a6eab3c14ab5272a58a5ba91505ba1a4b6d7a3a9fcbd187b6cd99a7b6d548cb7");
+    BOOST_CHECK_EQUAL(find_value(r[1].get_obj(), "accepted").get_bool(), false);
+    BOOST_CHECK_EQUAL(find_value(r[1].get_obj(), "error").get_str(), "Missing inputs");
+
+    // Oversized batches are rejected outright
+    std::string strBatch = "[\"DEADBEEF\"";
+    for (int i = 0; i < 1000; i++)
+        strBatch += ",\"DEADBEEF\"";
+    strBatch += "]";
+    BOOST_CHECK_THROW(CallRPC("sendrawtransactions " + strBatch), std::runtime_error);
 }
 
 BOOST_AUTO_TEST_CASE(rpc_togglenetwork)
@@ -321,6 +345,73 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_chaintip_snapshot)
+{
+    // Tip queries are served from the published snapshot, which must match chainActive
+    UniValue r;
+    std::string strTip;
+    {
+        LOCK(cs_main);
+        strTip = chainActive.Tip()->GetBlockHash().GetHex();
+        BOOST_CHECK_EQUAL(CallRPC("getblockcount").get_int(), chainActive.Height());
+    }
+    BOOST_CHECK_EQUAL(CallRPC("getbestblockhash").get_str(), strTip);
+
+    BOOST_CHECK_NO_THROW(r = CallRPC("getblockchaininfo"));
+    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "bestblockhash").get_str(), strTip);
+    BOOST_CHECK(find_value(r.get_obj(), "initialblockdownload").isBool());
+
+    BOOST_CHECK_NO_THROW(r = CallRPC("getblockheader " + strTip));
+    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "confirmations").get_int(), 1);
+    BOOST_CHECK(find_value(r.get_obj(), "nextblockhash").isNull());
+    BOOST_CHECK_THROW(CallRPC("getblockheader 0000000000000000000000000000000000000000000000000000000000000001"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch_concurrency)
+{
+    // Read-only calls are spread over dispatched threads, replies stay in request order
+    UniValue batch(UniValue::VARR);
+    for (int i = 0; i < 20; i++) {
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("method", i == 10 ? "setnetworkactive" : "getblockcount"));
+        UniValue params(UniValue::VARR);
+        if (i == 10)
+            params.push_back(true);
+        req.push_back(Pair("params", params));
+        req.push_back(Pair("id", i));
+        batch.push_back(req);
+    }
+    batch.push_back("not an object");
+
+    std::vector<std::thread> threads;
+    std::atomic<int> nDispatched(0);
+    RPCBatchDispatcher dispatch = [&](const std::function<void(void)>& func) {
+        nDispatched++;
+        threads.emplace_back(func);
+        return true;
+    };
+    UniValue r;
+    BOOST_CHECK(r.read(JSONRPCExecBatch(batch, dispatch, 4)));
+    for (std::thread& t : threads)
+        t.join();
+
+    // Two runs of ten and nine reads around the write, three helpers each
+    BOOST_CHECK_EQUAL(nDispatched, 6);
+    BOOST_CHECK_EQUAL(r.size(), 21);
+    // The test fixture never leaves RPC warmup, so every well-formed call is refused the same way
+    for (int i = 0; i < 20; i++) {
+        BOOST_CHECK_EQUAL(find_value(r[i], "id").get_int(), i);
+        BOOST_CHECK_EQUAL(find_value(find_value(r[i], "error"), "code").get_int(), RPC_IN_WARMUP);
+    }
+    BOOST_CHECK(find_value(r[20], "id").isNull());
+    BOOST_CHECK(find_value(find_value(r[20], "error"), "code").get_int() != RPC_IN_WARMUP);
+
+    // Without a dispatcher the batch runs sequentially
+    UniValue r2;
+    BOOST_CHECK(r2.read(JSONRPCExecBatch(batch)));
+    BOOST_CHECK_EQUAL(r2.write(), r.write());
+}
+
 BOOST_AUTO_TEST_CASE(rpc_convert_values_generatetoaddress)
 {
     UniValue result;
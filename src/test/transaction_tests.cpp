@@ -20,6 +20,7 @@
 #include "script/sign.h"
 #include "script/script_error.h"
 #include "script/standard.h"
+#include "util.h"
 #include "utilstrencodings.h"
 
 #include <map>
@@ -495,6 +496,56 @@ BOOST_AUTO_TEST_CASE(test_big_witness_transaction) {
     threadGroup.join_all();
 }
 
+BOOST_AUTO_TEST_CASE(test_parallel_signing)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CBasicKeyStore keystore;
+    keystore.AddKeyPubKey(key, key.GetPubKey());
+    CKeyID keyID = key.GetPubKey().GetID();
+    CScript scriptLegacy = GetScriptForDestination(keyID);
+    CScript scriptWitness = CScript() << OP_0 << std::vector<unsigned char>(keyID.begin(), keyID.end());
+
+    // Inputs alternate between legacy and witness outputs, and the floData
+    // is part of every signature hash
+    CMutableTransaction mtx;
+    mtx.nVersion = 2;
+    mtx.strFloData = "parallel signing";
+    std::vector<CScript> vScripts;
+    for (uint32_t i = 0; i < 20 * MIN_INPUTS_PER_SIGNING_THREAD; i++) {
+        mtx.vin.emplace_back(COutPoint(uint256S("0100"), i));
+        mtx.vout.emplace_back(1000, CScript() << OP_1);
+        vScripts.push_back(i % 2 ? scriptWitness : scriptLegacy);
+    }
+
+    CMutableTransaction mtxSerial = mtx;
+    for (unsigned int i = 0; i < mtxSerial.vin.size(); i++)
+        BOOST_CHECK(SignSignature(keystore, vScripts[i], mtxSerial, i, 1000, SIGHASH_ALL));
+
+    const CTransaction txConst(mtx);
+    const PrecomputedTransactionData txdata(txConst);
+    std::vector<SignatureData> vSigData(mtx.vin.size());
+    std::vector<char> vSigned(mtx.vin.size());
+    // Allow more threads than this machine may have cores
+    SetParallelForThreads(4);
+    ForEachTxInput(txConst, [&](unsigned int i) {
+        vSigned[i] = ProduceSignature(TransactionSignatureCreator(&keystore, &txConst, i, 1000, SIGHASH_ALL, &txdata), vScripts[i], vSigData[i]);
+    });
+    // A failure on any input reaches the caller, as it would when signing serially
+    BOOST_CHECK_THROW(ForEachTxInput(txConst, [&](unsigned int i) {
+        if (i == mtx.vin.size() - 1)
+            throw std::bad_alloc();
+    }), std::bad_alloc);
+    SetParallelForThreads(0);
+    for (unsigned int i = 0; i < mtx.vin.size(); i++) {
+        BOOST_CHECK(vSigned[i]);
+        UpdateTransaction(mtx, i, vSigData[i]);
+    }
+
+    // Signatures are deterministic, so both ways yield the same transaction
+    BOOST_CHECK(CTransaction(mtx).GetWitnessHash() == CTransaction(mtxSerial).GetWitnessHash());
+}
+
 BOOST_AUTO_TEST_CASE(test_witness)
 {
     CBasicKeyStore keystore, keystore2;
@@ -4,6 +4,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <limits>
 #include <stdint.h>
 #include <vector>
 #include <string>
@@ -331,4 +332,35 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK(!v.read("{} 42"));
 }
 
+BOOST_AUTO_TEST_CASE(univalue_readlong)
+{
+    UniValue v;
+
+    // Long strings are scanned in blocks; put special characters at every
+    // offset within a block and check they are still handled
+    std::string strPlain(64, 'a');
+    for (size_t i = 0; i < 16; i++) {
+        for (const std::string& strSpecial : {std::string("\\n"), std::string("\\\""), std::string("\xc3\xa9")}) {
+            std::string strJson = "[\"" + strPlain.substr(0, i) + strSpecial + strPlain + "\"]";
+            BOOST_CHECK(v.read(strJson));
+            BOOST_CHECK_EQUAL(v[0].get_str().size(), i + strPlain.size() + (strSpecial[0] == '\\' ? 1 : 2));
+            BOOST_CHECK_EQUAL(v.write(), strJson);
+        }
+        // Control characters and invalid UTF-8 must still be rejected
+        BOOST_CHECK(!v.read("[\"" + strPlain.substr(0, i) + "\x01" + strPlain + "\"]"));
+        BOOST_CHECK(!v.read("[\"" + strPlain.substr(0, i) + "\xc3" + strPlain + "\"]"));
+    }
+
+    // Numbers and keys are moved into place; check they are intact
+    BOOST_CHECK(v.read("{\"" + strPlain + "\":-12.5e+3,\"b\":[0,18446744073709551615]}"));
+    BOOST_CHECK_EQUAL(v[strPlain].getValStr(), "-12.5e+3");
+    BOOST_CHECK_EQUAL(v["b"][1].getValStr(), "18446744073709551615");
+
+    BOOST_CHECK_EQUAL(UniValue(std::numeric_limits<int64_t>::min()).getValStr(), "-9223372036854775808");
+    BOOST_CHECK_EQUAL(UniValue(std::numeric_limits<int64_t>::max()).getValStr(), "9223372036854775807");
+    BOOST_CHECK_EQUAL(UniValue(std::numeric_limits<uint64_t>::max()).getValStr(), "18446744073709551615");
+    BOOST_CHECK_EQUAL(UniValue((int64_t)0).getValStr(), "0");
+    BOOST_CHECK_EQUAL(UniValue(-7).getValStr(), "-7");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -12,7 +12,13 @@
 #include "utilmoneystr.h"
 #include "test/test_bitcoin.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
 #include <stdint.h>
+#include <thread>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -88,6 +94,45 @@ BOOST_AUTO_TEST_CASE(util_HexStr)
         "04 67 8a fd b0");
 }
 
+BOOST_AUTO_TEST_CASE(util_HexLong)
+{
+    // Long inputs go through the block-wise code; compare with a byte-wise encoding
+    static const char hexmap[] = "0123456789abcdef";
+    std::vector<unsigned char> data(300);
+    for (unsigned char& ch : data)
+        ch = InsecureRandBits(8);
+    std::string strExpected;
+    for (unsigned char ch : data) {
+        strExpected.push_back(hexmap[ch >> 4]);
+        strExpected.push_back(hexmap[ch & 15]);
+    }
+
+    for (size_t len = 0; len <= data.size(); len += 7) {
+        std::string strHex = HexStr(data.begin(), data.begin() + len);
+        BOOST_CHECK_EQUAL(strHex, strExpected.substr(0, 2 * len));
+        BOOST_CHECK(ParseHex(strHex) == std::vector<unsigned char>(data.begin(), data.begin() + len));
+    }
+
+    std::string strUpper = strExpected;
+    for (char& c : strUpper)
+        c = toupper(c);
+    BOOST_CHECK(ParseHex(strUpper) == data);
+
+    // Decoding stops at the first non-hex character wherever it appears; whitespace between bytes is skipped
+    for (size_t pos = 0; pos < 160; pos++) {
+        std::string strBad = strExpected;
+        strBad[pos] = 'g';
+        BOOST_CHECK(ParseHex(strBad) == std::vector<unsigned char>(data.begin(), data.begin() + pos / 2));
+        strBad[pos] = ':';
+        BOOST_CHECK(ParseHex(strBad) == std::vector<unsigned char>(data.begin(), data.begin() + pos / 2));
+        if (pos % 2 == 0) {
+            std::string strSpaced = strExpected;
+            strSpaced.insert(pos, " \n");
+            BOOST_CHECK(ParseHex(strSpaced) == data);
+        }
+    }
+}
+
 
 BOOST_AUTO_TEST_CASE(util_DateTimeStrFormat)
 {
@@ -579,4 +624,80 @@ BOOST_AUTO_TEST_CASE(test_ParseFixedPoint)
     BOOST_CHECK(!ParseFixedPoint("1.", 8, &amount));
 }
 
+/** Holds each caller until nThreads distinct threads have arrived, so none of
+ * them can claim a second chunk of ParallelFor work before all have started */
+class ThreadBarrier
+{
+    std::mutex cs;
+    std::condition_variable cond;
+    std::set<std::thread::id> setThreads;
+    const size_t nThreads;
+
+public:
+    explicit ThreadBarrier(size_t nThreadsIn) : nThreads(nThreadsIn) {}
+
+    void Arrive()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        setThreads.insert(std::this_thread::get_id());
+        cond.notify_all();
+        cond.wait_for(lock, std::chrono::seconds(10), [this] { return setThreads.size() >= nThreads; });
+    }
+
+    size_t Count()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        return setThreads.size();
+    }
+};
+
+BOOST_AUTO_TEST_CASE(util_ParallelFor)
+{
+    SetParallelForThreads(4);
+    const std::thread::id caller = std::this_thread::get_id();
+
+    // Every index is visited once, spread over the calling thread and three more
+    for (int nRun = 0; nRun < 2; nRun++) {
+        ThreadBarrier barrier(4);
+        std::vector<int> vVisits(400);
+        ParallelFor("test", vVisits.size(), 10, 0, [&](size_t i) {
+            barrier.Arrive();
+            vVisits[i]++;
+        });
+        BOOST_CHECK_EQUAL(barrier.Count(), 4U);
+        BOOST_CHECK(std::all_of(vVisits.begin(), vVisits.end(), [](int n) { return n == 1; }));
+    }
+
+    // nMinPerThread and nMaxThreads limit the threads of a single call
+    for (const std::pair<size_t, size_t>& limits : std::vector<std::pair<size_t, size_t>>{{200, 0}, {10, 2}}) {
+        ThreadBarrier barrier(2);
+        ParallelFor("test", 400, limits.first, limits.second, [&](size_t i) { barrier.Arrive(); });
+        BOOST_CHECK_EQUAL(barrier.Count(), 2U);
+    }
+
+    // An exception on another thread is rethrown on the calling thread, and
+    // its threads are returned to the budget
+    for (int nRun = 0; nRun < 2; nRun++) {
+        ThreadBarrier barrier(4);
+        BOOST_CHECK_THROW(ParallelFor("test", 400, 10, 0, [&](size_t i) {
+            barrier.Arrive();
+            if (std::this_thread::get_id() != caller)
+                throw std::runtime_error("ParallelFor test");
+        }), std::runtime_error);
+        BOOST_CHECK_EQUAL(barrier.Count(), 4U);
+    }
+
+    // Without room in the budget the calling thread does all the work
+    SetParallelForThreads(1);
+    std::set<std::thread::id> setThreads;
+    ParallelFor("test", 400, 10, 0, [&](size_t i) { setThreads.insert(std::this_thread::get_id()); });
+    BOOST_CHECK(setThreads == std::set<std::thread::id>{caller});
+    BOOST_CHECK_THROW(ParallelFor("test", 400, 10, 0, [](size_t i) {
+        if (i == 399)
+            throw std::runtime_error("ParallelFor test");
+    }), std::runtime_error);
+
+    SetParallelForThreads(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
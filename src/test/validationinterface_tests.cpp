@@ -0,0 +1,139 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "arith_uint256.h"
+#include "validationinterface.h"
+
+#include "test/test_bitcoin.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(validationinterface_tests, TestingSetup)
+
+/** Records Inventory callbacks, optionally holding them until released */
+class InventoryRecorder : public CValidationInterface
+{
+public:
+    std::mutex cs;
+    std::condition_variable cond;
+    std::vector<uint256> vHashes;
+    std::thread::id threadId;
+    bool fHold = false;
+
+    void Release()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fHold = false;
+        }
+        cond.notify_all();
+    }
+
+protected:
+    void Inventory(const uint256& hash) override
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (fHold)
+            cond.wait(lock);
+        vHashes.push_back(hash);
+        threadId = std::this_thread::get_id();
+    }
+};
+
+static uint256 Hash(int n)
+{
+    return ArithToUint256(arith_uint256(n));
+}
+
+static ValidationInterfaceStats GetStats(const std::string& strName)
+{
+    for (const ValidationInterfaceStats& stats : GetValidationInterfaceStats()) {
+        if (stats.strName == strName)
+            return stats;
+    }
+    BOOST_ERROR("no listener named " + strName);
+    return ValidationInterfaceStats();
+}
+
+BOOST_AUTO_TEST_CASE(sync_listener)
+{
+    InventoryRecorder recorder;
+    RegisterValidationInterface(&recorder, "recorder");
+    for (int i = 0; i < 10; i++)
+        GetMainSignals().Inventory(Hash(i));
+
+    // Made on the notifying thread, before the notification returns
+    BOOST_CHECK_EQUAL(recorder.vHashes.size(), 10U);
+    BOOST_CHECK(recorder.threadId == std::this_thread::get_id());
+    ValidationInterfaceStats stats = GetStats("recorder");
+    BOOST_CHECK(!stats.fAsync);
+    BOOST_CHECK_EQUAL(stats.nCallbacks, 10U);
+    BOOST_CHECK_EQUAL(stats.nQueueSize, 0U);
+
+    UnregisterValidationInterface(&recorder);
+    GetMainSignals().Inventory(Hash(10));
+    BOOST_CHECK_EQUAL(recorder.vHashes.size(), 10U);
+}
+
+BOOST_AUTO_TEST_CASE(async_listener_order_and_backpressure)
+{
+    InventoryRecorder recorder;
+    recorder.fHold = true;
+    RegisterAsyncValidationInterface(&recorder, "recorder", 4);
+
+    // With the listener held, one callback is taken and 4 wait; the next
+    // notification has to wait for room in the queue
+    std::thread notifier([] {
+        for (int i = 0; i < 100; i++)
+            GetMainSignals().Inventory(Hash(i));
+    });
+    while (GetStats("recorder").nQueueSize < 4)
+        std::this_thread::yield();
+    BOOST_CHECK(recorder.vHashes.empty());
+    BOOST_CHECK_EQUAL(GetStats("recorder").nPeakQueueSize, 4U);
+
+    recorder.Release();
+    notifier.join();
+    SyncWithValidationInterfaceQueues();
+
+    BOOST_CHECK_EQUAL(recorder.vHashes.size(), 100U);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(recorder.vHashes[i] == Hash(i));
+    BOOST_CHECK(recorder.threadId != std::this_thread::get_id());
+
+    ValidationInterfaceStats stats = GetStats("recorder");
+    BOOST_CHECK(stats.fAsync);
+    BOOST_CHECK_EQUAL(stats.nMaxQueueSize, 4U);
+    BOOST_CHECK_EQUAL(stats.nQueueSize, 0U);
+    BOOST_CHECK_EQUAL(stats.nCallbacks, 100U);
+    BOOST_CHECK(stats.nBlockedMicros > 0);
+    BOOST_CHECK(stats.nMaxCallbackMicros > 0);
+
+    UnregisterValidationInterface(&recorder);
+}
+
+BOOST_AUTO_TEST_CASE(async_listener_unregister_drains)
+{
+    InventoryRecorder recorder;
+    recorder.fHold = true;
+    RegisterAsyncValidationInterface(&recorder, "recorder", 10);
+    for (int i = 0; i < 5; i++)
+        GetMainSignals().Inventory(Hash(i));
+
+    std::thread releaser([&recorder] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        recorder.Release();
+    });
+    // Returns once the callbacks queued before unregistering have been made
+    UnregisterValidationInterface(&recorder);
+    releaser.join();
+    BOOST_CHECK_EQUAL(recorder.vHashes.size(), 5U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
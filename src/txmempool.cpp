@@ -102,9 +102,11 @@ void CTxMemPool::UpdateForDescendants(txiter updateIt, cacheMap &cachedDescendan
             cachedDescendants[updateIt].insert(cit);
             // Update ancestor state for each descendant
             mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetModifiedFee(), 1, updateIt->GetSigOpCost()));
+            MarkSnapshotDirty(cit->GetTx().GetHash());
         }
     }
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
+    MarkSnapshotDirty(updateIt->GetTx().GetHash());
 }
 
 // vHashesToUpdate is the set of transaction hashes from a disconnected block
@@ -153,6 +155,8 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
         }
         UpdateForDescendants(it, mapMemPoolDescendantsToUpdate, setAlreadyIncluded);
     }
+    if (!vHashesToUpdate.empty())
+        nTransactionsUpdated++;
 }
 
 bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString, bool fSearchForParents /* = true */) const
@@ -231,6 +235,7 @@ void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors
     const CAmount updateFee = updateCount * it->GetModifiedFee();
     for (txiter ancestorIt : setAncestors) {
         mapTx.modify(ancestorIt, update_descendant_state(updateSize, updateFee, updateCount));
+        MarkSnapshotDirty(ancestorIt->GetTx().GetHash());
     }
 }
 
@@ -246,6 +251,7 @@ void CTxMemPool::UpdateEntryForAncestors(txiter it, const setEntries &setAncesto
         updateSigOpsCost += ancestorIt->GetSigOpCost();
     }
     mapTx.modify(it, update_ancestor_state(updateSize, updateFee, updateCount, updateSigOpsCost));
+    MarkSnapshotDirty(it->GetTx().GetHash());
 }
 
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
@@ -277,6 +283,7 @@ void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, b
             int modifySigOps = -removeIt->GetSigOpCost();
             for (txiter dit : setDescendants) {
                 mapTx.modify(dit, update_ancestor_state(modifySize, modifyFee, -1, modifySigOps));
+                MarkSnapshotDirty(dit->GetTx().GetHash());
             }
         }
     }
@@ -335,7 +342,7 @@ void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee,
 }
 
 CTxMemPool::CTxMemPool(CBlockPolicyEstimator* estimator) :
-    nTransactionsUpdated(0), minerPolicyEstimator(estimator)
+    nTransactionsUpdated(0), minerPolicyEstimator(estimator), fSnapshotStale(true)
 {
     _clear(); //lock free clear
 
@@ -372,6 +379,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     LOCK(cs);
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
     mapLinks.insert(make_pair(newit, TxLinks()));
+    MarkSnapshotDirty(hash);
 
     // Update transaction for any feeDelta created by PrioritiseTransaction
     // TODO: refactor so that the fee delta is calculated before inserting
@@ -443,6 +451,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason)
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) + memusage::DynamicUsage(mapLinks[it].children);
     mapLinks.erase(it);
     mapTx.erase(it);
+    MarkSnapshotDirty(hash);
     nTransactionsUpdated++;
     if (minerPolicyEstimator) {minerPolicyEstimator->removeTx(hash, false);}
 }
@@ -604,6 +613,8 @@ void CTxMemPool::_clear()
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
     rollingMinimumFeeRate = 0;
+    fSnapshotStale = true;
+    setSnapshotDirty.clear();
     ++nTransactionsUpdated;
 }
 
@@ -836,6 +847,121 @@ TxMempoolInfo CTxMemPool::info(const uint256& hash) const
     return GetInfo(i);
 }
 
+const TxMempoolEntrySnapshot* CTxMemPoolSnapshot::find(const uint256& hash) const
+{
+    entrymap::const_iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return nullptr;
+    return it->second.get();
+}
+
+void CTxMemPoolSnapshot::CalculateAncestors(const uint256& hash, std::set<uint256>& setAncestors) const
+{
+    std::vector<uint256> stage(1, hash);
+    while (!stage.empty()) {
+        const TxMempoolEntrySnapshot* entry = find(stage.back());
+        stage.pop_back();
+        if (!entry)
+            continue;
+        for (const uint256& parent : entry->vParents) {
+            if (setAncestors.insert(parent).second)
+                stage.push_back(parent);
+        }
+    }
+}
+
+void CTxMemPoolSnapshot::CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const
+{
+    std::vector<uint256> stage(1, hash);
+    while (!stage.empty()) {
+        const TxMempoolEntrySnapshot* entry = find(stage.back());
+        stage.pop_back();
+        if (!entry)
+            continue;
+        for (const uint256& child : entry->vChildren) {
+            if (setDescendants.insert(child).second)
+                stage.push_back(child);
+        }
+    }
+}
+
+void CTxMemPool::MarkSnapshotDirty(const uint256& hash)
+{
+    if (fSnapshotStale)
+        return;
+    setSnapshotDirty.insert(hash);
+    // Once most of the pool has churned a full rebuild is no more expensive,
+    // and it keeps the dirty set bounded when nobody asks for snapshots.
+    if (setSnapshotDirty.size() > std::max<size_t>(mapTx.size(), 1000)) {
+        setSnapshotDirty.clear();
+        fSnapshotStale = true;
+    }
+}
+
+std::shared_ptr<const TxMempoolEntrySnapshot> CTxMemPool::MakeSnapshotEntry(txiter it) const
+{
+    std::shared_ptr<TxMempoolEntrySnapshot> entry = std::make_shared<TxMempoolEntrySnapshot>();
+    entry->tx = it->GetSharedTx();
+    entry->nFee = it->GetFee();
+    entry->nModifiedFee = it->GetModifiedFee();
+    entry->nTxSize = it->GetTxSize();
+    entry->nTime = it->GetTime();
+    entry->nHeight = it->GetHeight();
+    entry->nCountWithDescendants = it->GetCountWithDescendants();
+    entry->nSizeWithDescendants = it->GetSizeWithDescendants();
+    entry->nModFeesWithDescendants = it->GetModFeesWithDescendants();
+    entry->nCountWithAncestors = it->GetCountWithAncestors();
+    entry->nSizeWithAncestors = it->GetSizeWithAncestors();
+    entry->nModFeesWithAncestors = it->GetModFeesWithAncestors();
+    for (txiter parent : GetMemPoolParents(it))
+        entry->vParents.push_back(parent->GetTx().GetHash());
+    for (txiter child : GetMemPoolChildren(it))
+        entry->vChildren.push_back(child->GetTx().GetHash());
+    return entry;
+}
+
+CTxMemPoolSnapshotRef CTxMemPool::GetSnapshot() const
+{
+    LOCK(cs_snapshot);
+
+    // Only the changed entries are copied out while holding cs; a null
+    // pointer means the transaction left the pool.
+    std::vector<std::pair<uint256, std::shared_ptr<const TxMempoolEntrySnapshot>>> vChanged;
+    bool fRebuild;
+    {
+        LOCK(cs);
+        fRebuild = fSnapshotStale || !snapshot;
+        if (!fRebuild && setSnapshotDirty.empty())
+            return snapshot;
+
+        if (fRebuild) {
+            vChanged.reserve(mapTx.size());
+            for (txiter it = mapTx.begin(); it != mapTx.end(); ++it)
+                vChanged.emplace_back(it->GetTx().GetHash(), MakeSnapshotEntry(it));
+        } else {
+            vChanged.reserve(setSnapshotDirty.size());
+            for (const uint256& hash : setSnapshotDirty) {
+                txiter it = mapTx.find(hash);
+                vChanged.emplace_back(hash, it == mapTx.end() ? nullptr : MakeSnapshotEntry(it));
+            }
+        }
+        setSnapshotDirty.clear();
+        fSnapshotStale = false;
+    }
+
+    std::shared_ptr<CTxMemPoolSnapshot> next = std::make_shared<CTxMemPoolSnapshot>();
+    if (!fRebuild)
+        next->mapEntries = snapshot->mapEntries;
+    for (auto& changed : vChanged) {
+        if (changed.second)
+            next->mapEntries[changed.first] = std::move(changed.second);
+        else
+            next->mapEntries.erase(changed.first);
+    }
+    snapshot = std::move(next);
+    return snapshot;
+}
+
 void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeDelta)
 {
     {
@@ -845,6 +971,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
         txiter it = mapTx.find(hash);
         if (it != mapTx.end()) {
             mapTx.modify(it, update_fee_delta(delta));
+            MarkSnapshotDirty(hash);
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -852,6 +979,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy, false);
             for (txiter ancestorIt : setAncestors) {
                 mapTx.modify(ancestorIt, update_descendant_state(0, nFeeDelta, 0));
+                MarkSnapshotDirty(ancestorIt->GetTx().GetHash());
             }
             // Now update all descendants' modified fees with ancestors
             setEntries setDescendants;
@@ -859,6 +987,7 @@ void CTxMemPool::PrioritiseTransaction(const uint256& hash, const CAmount& nFeeD
             setDescendants.erase(it);
             for (txiter descendantIt : setDescendants) {
                 mapTx.modify(descendantIt, update_ancestor_state(0, nFeeDelta, 0, 0));
+                MarkSnapshotDirty(descendantIt->GetTx().GetHash());
             }
             ++nTransactionsUpdated;
         }
@@ -953,8 +1082,10 @@ void CTxMemPool::UpdateChild(txiter entry, txiter child, bool add)
     setEntries s;
     if (add && mapLinks[entry].children.insert(child).second) {
         cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
+        MarkSnapshotDirty(entry->GetTx().GetHash());
     } else if (!add && mapLinks[entry].children.erase(child)) {
         cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+        MarkSnapshotDirty(entry->GetTx().GetHash());
     }
 }
 
@@ -963,8 +1094,10 @@ void CTxMemPool::UpdateParent(txiter entry, txiter parent, bool add)
     setEntries s;
     if (add && mapLinks[entry].parents.insert(parent).second) {
         cachedInnerUsage += memusage::IncrementalDynamicUsage(s);
+        MarkSnapshotDirty(entry->GetTx().GetHash());
     } else if (!add && mapLinks[entry].parents.erase(parent)) {
         cachedInnerUsage -= memusage::IncrementalDynamicUsage(s);
+        MarkSnapshotDirty(entry->GetTx().GetHash());
     }
 }
 
@@ -314,6 +314,55 @@ struct TxMempoolInfo
     int64_t nFeeDelta;
 };
 
+/**
+ * Immutable copy of the state of a mempool entry that is reported over RPC
+ * and REST. Entries that did not change are shared between consecutive
+ * snapshots.
+ */
+struct TxMempoolEntrySnapshot
+{
+    CTransactionRef tx;
+    CAmount nFee;
+    CAmount nModifiedFee;
+    size_t nTxSize;
+    int64_t nTime;
+    unsigned int nHeight;
+
+    uint64_t nCountWithDescendants;
+    uint64_t nSizeWithDescendants;
+    CAmount nModFeesWithDescendants;
+
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nModFeesWithAncestors;
+
+    /** In-mempool parents and children, sorted by txid */
+    std::vector<uint256> vParents;
+    std::vector<uint256> vChildren;
+};
+
+/**
+ * Read-only view of the whole mempool, as returned by CTxMemPool::GetSnapshot().
+ * A published snapshot is never modified, so it can be walked without holding
+ * mempool.cs or cs_main.
+ */
+class CTxMemPoolSnapshot
+{
+public:
+    typedef std::map<uint256, std::shared_ptr<const TxMempoolEntrySnapshot>> entrymap;
+    entrymap mapEntries;
+
+    /** Returns nullptr if hash was not in the mempool when the snapshot was taken */
+    const TxMempoolEntrySnapshot* find(const uint256& hash) const;
+
+    /** All in-snapshot ancestors of hash, not including hash itself */
+    void CalculateAncestors(const uint256& hash, std::set<uint256>& setAncestors) const;
+    /** All in-snapshot descendants of hash, not including hash itself */
+    void CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const;
+};
+
+typedef std::shared_ptr<const CTxMemPoolSnapshot> CTxMemPoolSnapshotRef;
+
 /** Reason why a transaction was removed from the mempool,
  * this is passed to the notification signal.
  */
@@ -427,6 +476,11 @@ private:
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //!< minimum fee to get into the pool, decreases exponentially
 
+    mutable CCriticalSection cs_snapshot; //!< Serializes GetSnapshot() callers, taken before cs
+    mutable CTxMemPoolSnapshotRef snapshot; //!< Last published read-only view, see GetSnapshot(). Guarded by cs_snapshot
+    mutable bool fSnapshotStale; //!< The next snapshot must be built from scratch. Guarded by cs
+    mutable std::set<uint256> setSnapshotDirty; //!< Entries added, removed or changed since the last snapshot. Guarded by cs
+
     void trackPackageRemoved(const CFeeRate& rate);
 
 public:
@@ -494,6 +548,10 @@ private:
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    /** Record that the snapshot entry for hash must be rebuilt or dropped */
+    void MarkSnapshotDirty(const uint256& hash);
+    std::shared_ptr<const TxMempoolEntrySnapshot> MakeSnapshotEntry(txiter it) const;
+
     std::vector<indexed_transaction_set::const_iterator> GetSortedDepthAndScore() const;
 
 public:
@@ -623,6 +681,16 @@ public:
     TxMempoolInfo info(const uint256& hash) const;
     std::vector<TxMempoolInfo> infoAll() const;
 
+    /**
+     * Return a read-only view of the mempool for RPC and REST readers.
+     * The view is refreshed lazily: if nothing was added, removed or updated
+     * since the last call the previous snapshot is returned. Otherwise only
+     * the entries marked dirty since then are rebuilt under cs; the new view
+     * is assembled from the old one after cs is released, sharing every
+     * unchanged entry.
+     */
+    CTxMemPoolSnapshotRef GetSnapshot() const;
+
     size_t DynamicMemoryUsage() const;
 
     boost::signals2::signal<void (CTransactionRef)> NotifyEntryAdded;
@@ -120,22 +120,40 @@ bool UniValue::setNumStr(const string& val_)
     return true;
 }
 
-bool UniValue::setInt(uint64_t val_)
+// Format right to left into a stack buffer; the result is always a valid number
+static char *formatInt(uint64_t mag, bool neg, char *bufEnd)
 {
-    ostringstream oss;
+    char *p = bufEnd;
+    do {
+        *--p = '0' + (mag % 10);
+        mag /= 10;
+    } while (mag);
+    if (neg)
+        *--p = '-';
+    return p;
+}
 
-    oss << val_;
+bool UniValue::setInt(uint64_t val_)
+{
+    char buf[24];
+    char *first = formatInt(val_, false, buf + sizeof(buf));
 
-    return setNumStr(oss.str());
+    clear();
+    typ = VNUM;
+    val.assign(first, buf + sizeof(buf));
+    return true;
 }
 
 bool UniValue::setInt(int64_t val_)
 {
-    ostringstream oss;
-
-    oss << val_;
+    char buf[24];
+    uint64_t mag = val_ < 0 ? 0 - (uint64_t)val_ : (uint64_t)val_;
+    char *first = formatInt(mag, val_ < 0, buf + sizeof(buf));
 
-    return setNumStr(oss.str());
+    clear();
+    typ = VNUM;
+    val.assign(first, buf + sizeof(buf));
+    return true;
 }
 
 bool UniValue::setFloat(double val_)
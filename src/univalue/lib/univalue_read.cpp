@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <stdint.h>
 #include <string.h>
 #include <vector>
 #include <stdio.h>
@@ -42,8 +43,46 @@ static const char *hatoui(const char *first, const char *last,
     return first;
 }
 
+static bool json_isplain(unsigned char ch)
+{
+    return ch >= 0x20 && ch < 0x80 && ch != '"' && ch != '\\';
+}
+
+// Length of the run of characters at the start of [first, last) that can be
+// copied verbatim into a string value: printable 7-bit ASCII except '"' and
+// '\\'. Checks eight bytes per step, which matters for long hex strings.
+static size_t json_plain_run(const char *first, const char *last)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+
+    const char *p = first;
+    while (last - p >= 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        uint64_t quote = w ^ (ones * '"');
+        uint64_t bslash = w ^ (ones * '\\');
+        // High bit set in some byte if any byte is '"', '\\', < 0x20 or >= 0x80
+        uint64_t special = ((quote - ones) & ~quote) |
+                           ((bslash - ones) & ~bslash) |
+                           (w - ones * 0x20) | w;
+        if (special & highs)
+            break;
+        p += 8;
+    }
+    while (p < last && json_isplain(*p))
+        p++;
+    return p - first;
+}
+
 enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
                             const char *raw)
+{
+    return getJsonToken(tokenVal, consumed, raw, raw + strlen(raw));
+}
+
+enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
+                            const char *raw, const char *end)
 {
     tokenVal.clear();
     consumed = 0;
@@ -114,8 +153,6 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
     case '8':
     case '9': {
         // part 1: int
-        string numStr;
-
         const char *first = raw;
 
         const char *firstDigit = first;
@@ -124,49 +161,38 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
         if ((*firstDigit == '0') && json_isdigit(firstDigit[1]))
             return JTOK_ERR;
 
-        numStr += *raw;                       // copy first char
-        raw++;
+        raw++;                                // first char
 
         if ((*first == '-') && (!json_isdigit(*raw)))
             return JTOK_ERR;
 
-        while ((*raw) && json_isdigit(*raw)) {     // copy digits
-            numStr += *raw;
+        while ((*raw) && json_isdigit(*raw))  // digits
             raw++;
-        }
 
         // part 2: frac
         if (*raw == '.') {
-            numStr += *raw;                   // copy .
-            raw++;
+            raw++;                            // .
 
             if (!json_isdigit(*raw))
                 return JTOK_ERR;
-            while ((*raw) && json_isdigit(*raw)) { // copy digits
-                numStr += *raw;
+            while ((*raw) && json_isdigit(*raw)) // digits
                 raw++;
-            }
         }
 
         // part 3: exp
         if (*raw == 'e' || *raw == 'E') {
-            numStr += *raw;                   // copy E
-            raw++;
+            raw++;                            // E
 
-            if (*raw == '-' || *raw == '+') { // copy +/-
-                numStr += *raw;
+            if (*raw == '-' || *raw == '+')   // +/-
                 raw++;
-            }
 
             if (!json_isdigit(*raw))
                 return JTOK_ERR;
-            while ((*raw) && json_isdigit(*raw)) { // copy digits
-                numStr += *raw;
+            while ((*raw) && json_isdigit(*raw)) // digits
                 raw++;
-            }
         }
 
-        tokenVal = numStr;
+        tokenVal.assign(first, raw);
         consumed = (raw - rawStart);
         return JTOK_NUMBER;
         }
@@ -174,10 +200,16 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
     case '"': {
         raw++;                                // skip "
 
-        string valStr;
-        JSONUTF8StringFilter writer(valStr);
+        JSONUTF8StringFilter writer(tokenVal);
 
         while (*raw) {
+            size_t run = json_plain_run(raw, end);
+            if (run) {
+                writer.append_ascii(raw, raw + run);
+                raw += run;
+                continue;
+            }
+
             if ((unsigned char)*raw < 0x20)
                 return JTOK_ERR;
 
@@ -224,7 +256,6 @@ enum jtokentype getJsonToken(string& tokenVal, unsigned int& consumed,
 
         if (!writer.finalize())
             return JTOK_ERR;
-        tokenVal = valStr;
         consumed = (raw - rawStart);
         return JTOK_STRING;
         }
@@ -252,6 +283,7 @@ bool UniValue::read(const char *raw)
 
     uint32_t expectMask = 0;
     vector<UniValue*> stack;
+    const char *end = raw + strlen(raw);
 
     string tokenVal;
     unsigned int consumed;
@@ -260,7 +292,7 @@ bool UniValue::read(const char *raw)
     do {
         last_tok = tok;
 
-        tok = getJsonToken(tokenVal, consumed, raw);
+        tok = getJsonToken(tokenVal, consumed, raw, end);
         if (tok == JTOK_NONE || tok == JTOK_ERR)
             return false;
         raw += consumed;
@@ -399,9 +431,11 @@ bool UniValue::read(const char *raw)
             if (!stack.size())
                 return false;
 
-            UniValue tmpVal(VNUM, tokenVal);
+            // Move the token into place rather than copying it
             UniValue *top = stack.back();
-            top->values.push_back(tmpVal);
+            top->values.push_back(UniValue());
+            top->values.back().typ = VNUM;
+            top->values.back().val.swap(tokenVal);
 
             setExpect(NOT_VALUE);
             break;
@@ -414,12 +448,14 @@ bool UniValue::read(const char *raw)
             UniValue *top = stack.back();
 
             if (expect(OBJ_NAME)) {
-                top->keys.push_back(tokenVal);
+                top->keys.push_back(string());
+                top->keys.back().swap(tokenVal);
                 clearExpect(OBJ_NAME);
                 setExpect(COLON);
             } else {
-                UniValue tmpVal(VSTR, tokenVal);
-                top->values.push_back(tmpVal);
+                top->values.push_back(UniValue());
+                top->values.back().typ = VSTR;
+                top->values.back().val.swap(tokenVal);
             }
 
             setExpect(NOT_VALUE);
@@ -432,7 +468,7 @@ bool UniValue::read(const char *raw)
     } while (!stack.empty ());
 
     /* Check that nothing follows the initial construct (parsed above).  */
-    tok = getJsonToken(tokenVal, consumed, raw);
+    tok = getJsonToken(tokenVal, consumed, raw, end);
     if (tok != JTOK_NONE)
         return false;
 
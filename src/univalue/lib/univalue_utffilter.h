@@ -45,6 +45,15 @@ public:
                 push_back_u(codepoint);
         }
     }
+    // Write a run of 7-bit ASCII characters, same as push_back on each of them
+    void append_ascii(const char *first, const char *last)
+    {
+        if (state == 0)
+            str.append(first, last);
+        else
+            for (; first != last; ++first)
+                push_back(*first);
+    }
     // Write codepoint directly, possibly collating surrogate pairs
     void push_back_u(unsigned int codepoint)
     {
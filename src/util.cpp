@@ -77,6 +77,9 @@
 #include <malloc.h>
 #endif
 
+#include <mutex>
+#include <thread>
+
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
 #include <boost/algorithm/string/predicate.hpp> // for startswith() and endswith()
 #include <boost/program_options/detail/config_file.hpp>
@@ -884,6 +887,76 @@ int GetNumCores()
 #endif
 }
 
+//! Threads ParallelFor may run at once, 0 for GetNumCores()
+static int nParallelForMaxThreads = 0;
+//! Extra threads currently running ParallelFor work
+static int nParallelForThreads = 0;
+static std::mutex csParallelFor;
+
+void SetParallelForThreads(int nThreads)
+{
+    std::lock_guard<std::mutex> lock(csParallelFor);
+    nParallelForMaxThreads = std::max(0, nThreads);
+}
+
+void ParallelFor(const char* name, size_t nCount, size_t nMinPerThread, size_t nMaxThreads, const std::function<void(size_t)>& fn)
+{
+    size_t nWanted = nCount / std::max<size_t>(1, nMinPerThread);
+    if (nMaxThreads > 0)
+        nWanted = std::min(nWanted, nMaxThreads);
+
+    // The calling thread always takes part; only the others count against the budget
+    size_t nExtra = 0;
+    if (nWanted > 1) {
+        std::lock_guard<std::mutex> lock(csParallelFor);
+        int nLimit = nParallelForMaxThreads > 0 ? nParallelForMaxThreads : GetNumCores();
+        if (nLimit - 1 > nParallelForThreads)
+            nExtra = std::min<size_t>(nWanted - 1, nLimit - 1 - nParallelForThreads);
+        nParallelForThreads += nExtra;
+    }
+
+    const size_t nChunk = (nCount + nExtra) / (nExtra + 1);
+    std::atomic<size_t> nNext(0);
+    std::atomic<bool> fFailed(false);
+    std::mutex csError;
+    std::exception_ptr error;
+    std::function<void(void)> work = [&]() {
+        try {
+            size_t nBegin;
+            while (!fFailed && (nBegin = nNext.fetch_add(nChunk)) < nCount) {
+                const size_t nEnd = std::min(nCount, nBegin + nChunk);
+                for (size_t i = nBegin; i < nEnd && !fFailed; i++)
+                    fn(i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(csError);
+            if (!error)
+                error = std::current_exception();
+            fFailed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    try {
+        threads.reserve(nExtra);
+        for (size_t n = 0; n < nExtra; n++)
+            threads.emplace_back(&TraceThread<std::function<void(void)>>, name, work);
+    } catch (const std::exception& e) {
+        // Chunks are claimed as threads go, so the threads already running do this one's share
+        LogPrintf("%s: could not start %s thread: %s\n", __func__, name, e.what());
+    }
+    work();
+    for (std::thread& thread : threads)
+        thread.join();
+
+    {
+        std::lock_guard<std::mutex> lock(csParallelFor);
+        nParallelForThreads -= nExtra;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
 std::string CopyrightHolders(const std::string& strPrefix)
 {
     std::string strCopyrightHolders = strPrefix + strprintf(_(COPYRIGHT_HOLDERS), _(COPYRIGHT_HOLDERS_SUBSTITUTION));
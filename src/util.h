@@ -23,6 +23,7 @@
 
 #include <atomic>
 #include <exception>
+#include <functional>
 #include <map>
 #include <stdint.h>
 #include <string>
@@ -318,6 +319,19 @@ template <typename Callable> void TraceThread(const char* name,  Callable func)
     }
 }
 
+/**
+ * Call fn(i) for every i in [0, nCount), on the calling thread and on extra
+ * threads named bitcoin-<name>, each taking at least nMinPerThread indices and
+ * at most nMaxThreads threads in all (0 for no limit). Extra threads come from
+ * a budget shared by all callers in the process, see SetParallelForThreads;
+ * once it is used up, the calling thread does the remaining work itself. If fn
+ * throws, the remaining indices are skipped and the first exception is
+ * rethrown on the calling thread once all threads have finished.
+ */
+void ParallelFor(const char* name, size_t nCount, size_t nMinPerThread, size_t nMaxThreads, const std::function<void(size_t)>& fn);
+/** Limit the threads running ParallelFor work at once, callers included (0: number of cores) */
+void SetParallelForThreads(int nThreads);
+
 std::string CopyrightHolders(const std::string& strPrefix);
 
 #endif // BITCOIN_UTIL_H
@@ -13,6 +13,13 @@
 #include <errno.h>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 static const std::string CHARS_ALPHA_NUM = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
 
 static const std::string SAFE_CHARS[] =
@@ -66,12 +73,157 @@ bool IsHex(const std::string& str)
     return (str.size() > 0) && (str.size()%2 == 0);
 }
 
-std::vector<unsigned char> ParseHex(const char* psz)
+/*
+ * Vectorized hex conversion. Encoding splits bytes into nibbles and maps
+ * them to '0'-'9'/'a'-'f' with a compare and add; decoding maps characters
+ * back to nibbles, checks every character is a hex digit and packs nibble
+ * pairs into bytes. Blocks containing anything else are left to the scalar
+ * code, which handles whitespace and the end of input.
+ */
+#if defined(__SSE2__)
+static inline __m128i HexNibblesToChars(__m128i nib)
+{
+    const __m128i gt9 = _mm_cmpgt_epi8(nib, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(nib, _mm_set1_epi8('0')), _mm_and_si128(gt9, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+static inline void HexEncode16(const unsigned char* in, char* out)
+{
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    const __m128i bytes = _mm_loadu_si128((const __m128i*)in);
+    const __m128i hi = HexNibblesToChars(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+    const __m128i lo = HexNibblesToChars(_mm_and_si128(bytes, mask));
+    _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+static inline __m128i HexCharsToNibbles(__m128i c, __m128i& valid)
+{
+    const __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    const __m128i alpha = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    // Unsigned range checks: x <= max iff min(x, max) == x
+    const __m128i isdigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    const __m128i isalpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+    valid = _mm_or_si128(isdigit, isalpha);
+    return _mm_or_si128(_mm_and_si128(isdigit, digit),
+                        _mm_and_si128(isalpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+}
+
+static inline __m128i HexNibblePairsToBytes(__m128i nib)
+{
+    // Each 16-bit lane holds the high nibble in its low byte and the low nibble in its high byte
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nib, _mm_set1_epi16(0x00ff)), 4), _mm_srli_epi16(nib, 8));
+}
+
+static inline bool HexDecode16(const char* in, unsigned char* out)
+{
+    __m128i valid0, valid1;
+    const __m128i nib0 = HexCharsToNibbles(_mm_loadu_si128((const __m128i*)in), valid0);
+    const __m128i nib1 = HexCharsToNibbles(_mm_loadu_si128((const __m128i*)(in + 16)), valid1);
+    if (_mm_movemask_epi8(_mm_and_si128(valid0, valid1)) != 0xffff)
+        return false;
+    _mm_storeu_si128((__m128i*)out, _mm_packus_epi16(HexNibblePairsToBytes(nib0), HexNibblePairsToBytes(nib1)));
+    return true;
+}
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i HexNibblesToChars(__m256i nib)
+{
+    const __m256i gt9 = _mm256_cmpgt_epi8(nib, _mm256_set1_epi8(9));
+    return _mm256_add_epi8(_mm256_add_epi8(nib, _mm256_set1_epi8('0')), _mm256_and_si256(gt9, _mm256_set1_epi8('a' - '0' - 10)));
+}
+
+static inline void HexEncode32(const unsigned char* in, char* out)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i bytes = _mm256_loadu_si256((const __m256i*)in);
+    const __m256i hi = HexNibblesToChars(_mm256_and_si256(_mm256_srli_epi16(bytes, 4), mask));
+    const __m256i lo = HexNibblesToChars(_mm256_and_si256(bytes, mask));
+    // Unpacking works within 128-bit lanes; reassemble the lanes in order
+    const __m256i first = _mm256_unpacklo_epi8(hi, lo);
+    const __m256i second = _mm256_unpackhi_epi8(hi, lo);
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute2x128_si256(first, second, 0x20));
+    _mm256_storeu_si256((__m256i*)(out + 32), _mm256_permute2x128_si256(first, second, 0x31));
+}
+
+static inline __m256i HexCharsToNibbles(__m256i c, __m256i& valid)
+{
+    const __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    const __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    const __m256i isdigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    const __m256i isalpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+    valid = _mm256_or_si256(isdigit, isalpha);
+    return _mm256_or_si256(_mm256_and_si256(isdigit, digit),
+                           _mm256_and_si256(isalpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+}
+
+static inline __m256i HexNibblePairsToBytes(__m256i nib)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(nib, _mm256_set1_epi16(0x00ff)), 4), _mm256_srli_epi16(nib, 8));
+}
+
+static inline bool HexDecode32(const char* in, unsigned char* out)
+{
+    __m256i valid0, valid1;
+    const __m256i nib0 = HexCharsToNibbles(_mm256_loadu_si256((const __m256i*)in), valid0);
+    const __m256i nib1 = HexCharsToNibbles(_mm256_loadu_si256((const __m256i*)(in + 32)), valid1);
+    if (_mm256_movemask_epi8(_mm256_and_si256(valid0, valid1)) != -1)
+        return false;
+    // Packing also works within lanes; restore the order of the 64-bit groups
+    const __m256i packed = _mm256_packus_epi16(HexNibblePairsToBytes(nib0), HexNibblePairsToBytes(nib1));
+    _mm256_storeu_si256((__m256i*)out, _mm256_permute4x64_epi64(packed, _MM_SHUFFLE(3, 1, 2, 0)));
+    return true;
+}
+#endif
+
+void HexEncode(const unsigned char* data, size_t len, char* out)
+{
+    static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                     '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; len - i >= 32; i += 32)
+        HexEncode32(data + i, out + 2 * i);
+#endif
+#if defined(__SSE2__)
+    for (; len - i >= 16; i += 16)
+        HexEncode16(data + i, out + 2 * i);
+#endif
+    for (; i < len; i++) {
+        out[2 * i] = hexmap[data[i] >> 4];
+        out[2 * i + 1] = hexmap[data[i] & 15];
+    }
+}
+
+/** Decode whole blocks of hex digits from psz, stopping before the first block that has anything else in it */
+static const char* ParseHexBlocks(const char* psz, const char* pend, std::vector<unsigned char>& vch)
+{
+#if defined(__AVX2__)
+    unsigned char buf[32];
+    while (pend - psz >= 64 && HexDecode32(psz, buf)) {
+        vch.insert(vch.end(), buf, buf + 32);
+        psz += 64;
+    }
+#elif defined(__SSE2__)
+    unsigned char buf[16];
+    while (pend - psz >= 32 && HexDecode16(psz, buf)) {
+        vch.insert(vch.end(), buf, buf + 16);
+        psz += 32;
+    }
+#endif
+    return psz;
+}
+
+/** Convert the hex dump in [psz, pend) to a vector; *pend must be a NUL terminator */
+static std::vector<unsigned char> ParseHex(const char* psz, const char* pend)
 {
     // convert hex dump to vector
     std::vector<unsigned char> vch;
+    vch.reserve((pend - psz) / 2);
     while (true)
     {
+        psz = ParseHexBlocks(psz, pend, vch);
         while (isspace(*psz))
             psz++;
         signed char c = HexDigit(*psz++);
@@ -87,9 +239,14 @@ std::vector<unsigned char> ParseHex(const char* psz)
     return vch;
 }
 
+std::vector<unsigned char> ParseHex(const char* psz)
+{
+    return ParseHex(psz, psz + strlen(psz));
+}
+
 std::vector<unsigned char> ParseHex(const std::string& str)
 {
-    return ParseHex(str.c_str());
+    return ParseHex(str.c_str(), str.c_str() + str.size());
 }
 
 void SplitHostPort(std::string in, int &portOut, std::string &hostOut) {
@@ -91,10 +91,31 @@ bool ParseUInt64(const std::string& str, uint64_t *out);
  */
 bool ParseDouble(const std::string& str, double *out);
 
+/**
+ * Write the lowercase hex encoding of len bytes from data to out, which must
+ * have room for 2 * len characters. Uses SSE2/AVX2 when the build targets them.
+ */
+void HexEncode(const unsigned char* data, size_t len, char* out);
+
 template<typename T>
 std::string HexStr(const T itbegin, const T itend, bool fSpaces=false)
 {
     std::string rv;
+    if (!fSpaces) {
+        // Feed the range to HexEncode through a small buffer, so any iterator type can use it
+        rv.resize((itend-itbegin)*2);
+        unsigned char buf[256];
+        size_t nOut = 0;
+        for (T it = itbegin; it < itend; ) {
+            size_t n = 0;
+            for (; n < sizeof(buf) && it < itend; ++n, ++it)
+                buf[n] = (unsigned char)(*it);
+            HexEncode(buf, n, &rv[nOut]);
+            nOut += 2 * n;
+        }
+        return rv;
+    }
+
     static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
                                      '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
     rv.reserve((itend-itbegin)*3);
@@ -901,6 +901,35 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
     return AcceptToMemoryPoolWithTime(chainparams, pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), plTxnReplaced, fOverrideMempoolLimit, nAbsurdFee);
 }
 
+unsigned int AcceptToMemoryPoolBatch(CTxMemPool& pool, std::vector<CValidationState>& vState, const std::vector<CTransactionRef>& vtx,
+                                     bool fLimitFree, std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs, const CAmount nAbsurdFee)
+{
+    AssertLockHeld(cs_main);
+    const CChainParams& chainparams = Params();
+    const int64_t nAcceptTime = GetTime();
+    vState.assign(vtx.size(), CValidationState());
+    vAccepted.assign(vtx.size(), false);
+    vMissingInputs.assign(vtx.size(), false);
+
+    unsigned int nAccepted = 0;
+    for (size_t i = 0; i < vtx.size(); i++) {
+        std::vector<COutPoint> coins_to_uncache;
+        bool fMissingInputs = false;
+        if (AcceptToMemoryPoolWorker(chainparams, pool, vState[i], vtx[i], fLimitFree, &fMissingInputs, nAcceptTime, nullptr, false, nAbsurdFee, coins_to_uncache)) {
+            vAccepted[i] = true;
+            nAccepted++;
+        } else {
+            for (const COutPoint& hashTx : coins_to_uncache)
+                pcoinsTip->Uncache(hashTx);
+        }
+        vMissingInputs[i] = fMissingInputs;
+    }
+    // Trim the coins cache once for the whole batch rather than after every transaction
+    CValidationState stateDummy;
+    FlushStateToDisk(chainparams, stateDummy, FLUSH_STATE_PERIODIC);
+    return nAccepted;
+}
+
 /** Return transaction in txOut, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256 &hash, CTransactionRef &txOut, const Consensus::Params& consensusParams, uint256 &hashBlock, bool fAllowSlow)
 {
@@ -988,7 +1017,7 @@ static bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMes
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+static bool ReadBlockDataFromDisk(CBlock& block, const CDiskBlockPos& pos)
 {
     block.SetNull();
 
@@ -1002,8 +1031,15 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
         filein >> block;
     }
     catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        return error("ReadBlockFromDisk: Deserialize or I/O error - %s at %s", e.what(), pos.ToString());
     }
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams)
+{
+    if (!ReadBlockDataFromDisk(block, pos))
+        return false;
 
     // Check the header
     if (!CheckProofOfWork(block.GetPoWHash(), block.nBits, consensusParams))
@@ -1012,6 +1048,15 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
     return true;
 }
 
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    if (!ReadBlockDataFromDisk(block, pos))
+        return false;
+    if (block.GetHash() != hashBlock)
+        return error("ReadBlockFromDisk: GetHash() doesn't match %s at %s", hashBlock.ToString(), pos.ToString());
+    return true;
+}
+
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams)
 {
     if (!ReadBlockFromDisk(block, pindex->GetBlockPos(), consensusParams))
@@ -1999,12 +2044,43 @@ static void DoWarning(const std::string& strWarning)
     }
 }
 
+static std::shared_ptr<const ChainTipSnapshot> g_chain_tip_snapshot = std::make_shared<const ChainTipSnapshot>();
+
+/** Publish a new ChainTipSnapshot for chainActive and pindexBestHeader. */
+static void PublishChainTipSnapshot(const CChainParams& chainParams)
+{
+    AssertLockHeld(cs_main);
+    std::shared_ptr<ChainTipSnapshot> snapshot = std::make_shared<ChainTipSnapshot>();
+    const CBlockIndex* pindex = chainActive.Tip();
+    snapshot->pindexTip = pindex;
+    snapshot->nHeight = chainActive.Height();
+    if (pindex) {
+        snapshot->hashBlock = pindex->GetBlockHash();
+        snapshot->nChainWork = pindex->nChainWork;
+        snapshot->nMedianTimePast = pindex->GetMedianTimePast();
+    }
+    snapshot->pindexHeader = pindexBestHeader;
+    snapshot->fInitialBlockDownload = IsInitialBlockDownload();
+    for (int i = 0; i < (int)Consensus::MAX_VERSION_BITS_DEPLOYMENTS; i++) {
+        Consensus::DeploymentPos pos = Consensus::DeploymentPos(i);
+        snapshot->vDeploymentState[i] = VersionBitsState(pindex, chainParams.GetConsensus(), pos, versionbitscache);
+        snapshot->vDeploymentSince[i] = VersionBitsStateSinceHeight(pindex, chainParams.GetConsensus(), pos, versionbitscache);
+    }
+    std::atomic_store(&g_chain_tip_snapshot, std::shared_ptr<const ChainTipSnapshot>(std::move(snapshot)));
+}
+
+std::shared_ptr<const ChainTipSnapshot> GetChainTipSnapshot()
+{
+    return std::atomic_load(&g_chain_tip_snapshot);
+}
+
 /** Update chainActive and related internal data structures. */
 void static UpdateTip(CBlockIndex *pindexNew, const CChainParams& chainParams) {
     chainActive.SetTip(pindexNew);
 
     // New best block
     mempool.AddTransactionsUpdated(1);
+    PublishChainTipSnapshot(chainParams);
 
     cvBlockChange.notify_all();
 
@@ -2437,6 +2513,7 @@ static void NotifyHeaderTip() {
             fNotify = true;
             fInitialBlockDownload = IsInitialBlockDownload();
             pindexHeaderOld = pindexHeader;
+            PublishChainTipSnapshot(Params());
         }
     }
     // Send block tip changed notifications without cs_main
@@ -3592,6 +3669,7 @@ bool LoadChainTip(const CChainParams& chainparams)
     if (it == mapBlockIndex.end())
         return false;
     chainActive.SetTip(it->second);
+    PublishChainTipSnapshot(chainparams);
 
     PruneBlockIndexCandidates();
 
@@ -3896,6 +3974,8 @@ void UnloadBlockIndex()
     chainActive.SetTip(nullptr);
     pindexBestInvalid = nullptr;
     pindexBestHeader = nullptr;
+    // The block index entries referenced by the published snapshot are freed below
+    std::atomic_store(&g_chain_tip_snapshot, std::make_shared<const ChainTipSnapshot>());
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -4416,7 +4496,7 @@ void DumpMempool(void)
 }
 
 //! Guess how far we are in the verification process at the given block index
-double GuessVerificationProgress(const ChainTxData& data, CBlockIndex *pindex) {
+double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex *pindex) {
     if (pindex == nullptr)
         return 0.0;
 
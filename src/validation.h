@@ -12,6 +12,7 @@
 #endif
 
 #include "amount.h"
+#include "arith_uint256.h"
 #include "coins.h"
 #include "fs.h"
 #include "protocol.h" // For CMessageHeader::MessageStartChars
@@ -277,7 +278,7 @@ bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams,
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
 
 /** Guess verification progress (as a fraction between 0.0=genesis and 1.0=current tip). */
-double GuessVerificationProgress(const ChainTxData& data, CBlockIndex* pindex);
+double GuessVerificationProgress(const ChainTxData& data, const CBlockIndex* pindex);
 
 /**
  *  Mark one block file as pruned.
@@ -304,6 +305,14 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransa
                         bool* pfMissingInputs, std::list<CTransactionRef>* plTxnReplaced = nullptr,
                         bool fOverrideMempoolLimit=false, const CAmount nAbsurdFee=0);
 
+/** (try to) add a batch of transactions to memory pool, in the given order.
+ * Must be called with cs_main held; the acceptance time is shared by the whole
+ * batch and the coins cache is only flushed once at the end.
+ * vAccepted, vState and vMissingInputs are filled in per transaction.
+ * Returns the number accepted. **/
+unsigned int AcceptToMemoryPoolBatch(CTxMemPool& pool, std::vector<CValidationState>& vState, const std::vector<CTransactionRef>& vtx,
+                                     bool fLimitFree, std::vector<bool>& vAccepted, std::vector<bool>& vMissingInputs, const CAmount nAbsurdFee=0);
+
 /** Convert CValidationState to a human-readable message for logging */
 std::string FormatStateMessage(const CValidationState &state);
 
@@ -317,6 +326,29 @@ BIP9Stats VersionBitsTipStatistics(const Consensus::Params& params, Consensus::D
 int VersionBitsTipStateSinceHeight(const Consensus::Params& params, Consensus::DeploymentPos pos);
 
 
+/**
+ * Immutable summary of the active chain tip and best header. A new instance is
+ * published whenever either changes, so cheap read-only queries can be
+ * answered without taking cs_main.
+ */
+struct ChainTipSnapshot
+{
+    const CBlockIndex* pindexTip = nullptr;    //!< Block index entries are never freed while running
+    int nHeight = -1;
+    uint256 hashBlock;
+    arith_uint256 nChainWork;
+    int64_t nMedianTimePast = 0;
+    const CBlockIndex* pindexHeader = nullptr;
+    bool fInitialBlockDownload = true;
+    /** BIP9 state and since-height of each deployment for the block building on pindexTip */
+    ThresholdState vDeploymentState[Consensus::MAX_VERSION_BITS_DEPLOYMENTS] = {};
+    int vDeploymentSince[Consensus::MAX_VERSION_BITS_DEPLOYMENTS] = {};
+};
+
+/** Get the most recently published chain tip snapshot. Never returns nullptr and does not lock cs_main. */
+std::shared_ptr<const ChainTipSnapshot> GetChainTipSnapshot();
+
+
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CCoinsViewCache& inputs, int nHeight);
 
@@ -394,6 +426,9 @@ void InitScriptExecutionCache();
 /** Functions for disk access for blocks */
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/** Read a block whose header is already in the block index. The block hash is
+ *  checked against hashBlock instead of recomputing the scrypt proof of work. */
+bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
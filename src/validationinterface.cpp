@@ -6,12 +6,19 @@
 
 #include "validationinterface.h"
 #include "init.h"
+#include "primitives/block.h"
 #include "scheduler.h"
 #include "sync.h"
 #include "util.h"
+#include "utiltime.h"
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <list>
 #include <atomic>
+#include <mutex>
+#include <thread>
 
 #include <boost/signals2/signal.hpp>
 
@@ -31,9 +38,174 @@ struct MainSignalsInstance {
     // our own queue here :(
     SingleThreadedSchedulerClient m_schedulerClient;
 
+    //! Registered listeners, in registration order
+    std::mutex cs_listeners;
+    std::list<std::unique_ptr<ValidationListener>> listeners;
+
     MainSignalsInstance(CScheduler *pscheduler) : m_schedulerClient(pscheduler) {}
 };
 
+/**
+ * A registered CValidationInterface. Its callbacks are made directly by the
+ * notifying thread or, for asynchronous listeners, queued and made in order
+ * by a thread of its own. Either way they are timed for the statistics.
+ */
+struct ValidationListener
+{
+    CValidationInterface* const pinterface;
+    const std::string strName;
+    const size_t nMaxQueueSize; //!< 0 for synchronous listeners
+    std::vector<boost::signals2::scoped_connection> connections;
+
+    std::mutex cs;
+    std::condition_variable condQueued;   //!< callbacks queued, or stopping
+    std::condition_variable condProgress; //!< callbacks taken from the queue or finished
+    std::deque<std::function<void()>> queue;
+    bool fRunning; //!< a callback taken from the queue is being made
+    bool fStopping;
+    std::thread thread;
+
+    size_t nPeakQueueSize;
+    uint64_t nCallbacks;
+    int64_t nCallbackMicros;
+    int64_t nMaxCallbackMicros;
+    int64_t nBlockedMicros;
+
+    ValidationListener(CValidationInterface* pinterfaceIn, const std::string& strNameIn, size_t nMaxQueueSizeIn) :
+        pinterface(pinterfaceIn), strName(strNameIn), nMaxQueueSize(nMaxQueueSizeIn), fRunning(false), fStopping(false),
+        nPeakQueueSize(0), nCallbacks(0), nCallbackMicros(0), nMaxCallbackMicros(0), nBlockedMicros(0)
+    {
+        if (nMaxQueueSize > 0)
+            thread = std::thread(&TraceThread<std::function<void()> >, "valqueue", std::function<void()>(std::bind(&ValidationListener::ThreadCallbacks, this)));
+    }
+
+    /** Disconnect, then make the callbacks still queued */
+    ~ValidationListener()
+    {
+        connections.clear();
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(cs);
+                fStopping = true;
+            }
+            condQueued.notify_all();
+            thread.join();
+        }
+    }
+
+    void Connect(MainSignalsInstance& signals)
+    {
+        CValidationInterface* p = pinterface;
+        connections.emplace_back(signals.UpdatedBlockTip.connect([this, p](const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
+            Call([p, pindexNew, pindexFork, fInitialDownload] { p->UpdatedBlockTip(pindexNew, pindexFork, fInitialDownload); });
+        }));
+        connections.emplace_back(signals.TransactionAddedToMempool.connect([this, p](const CTransactionRef &ptx) {
+            Call([p, ptx] { p->TransactionAddedToMempool(ptx); });
+        }));
+        connections.emplace_back(signals.BlockConnected.connect([this, p](const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
+            Call([p, pblock, pindex, vtxConflicted] { p->BlockConnected(pblock, pindex, vtxConflicted); });
+        }));
+        connections.emplace_back(signals.BlockDisconnected.connect([this, p](const std::shared_ptr<const CBlock> &pblock) {
+            Call([p, pblock] { p->BlockDisconnected(pblock); });
+        }));
+        connections.emplace_back(signals.SetBestChain.connect([this, p](const CBlockLocator &locator) {
+            Call([p, locator] { p->SetBestChain(locator); });
+        }));
+        connections.emplace_back(signals.Inventory.connect([this, p](const uint256 &hash) {
+            Call([p, hash] { p->Inventory(hash); });
+        }));
+        connections.emplace_back(signals.Broadcast.connect([this, p](int64_t nBestBlockTime, CConnman* connman) {
+            Call([p, nBestBlockTime, connman] { p->ResendWalletTransactions(nBestBlockTime, connman); });
+        }));
+        // Always synchronous: the arguments only live as long as the call
+        connections.emplace_back(signals.BlockChecked.connect([this, p](const CBlock& block, const CValidationState& state) {
+            Run([p, &block, &state] { p->BlockChecked(block, state); });
+        }));
+        connections.emplace_back(signals.NewPoWValidBlock.connect([this, p](const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {
+            Run([p, pindex, &block] { p->NewPoWValidBlock(pindex, block); });
+        }));
+    }
+
+    /** Make a callback, or queue it for an asynchronous listener */
+    void Call(std::function<void()>&& func)
+    {
+        if (nMaxQueueSize == 0) {
+            Run(func);
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(cs);
+            if (queue.size() >= nMaxQueueSize) {
+                int64_t nStart = GetTimeMicros();
+                while (queue.size() >= nMaxQueueSize && !fStopping)
+                    condProgress.wait(lock);
+                nBlockedMicros += GetTimeMicros() - nStart;
+            }
+            queue.push_back(std::move(func));
+            nPeakQueueSize = std::max(nPeakQueueSize, queue.size());
+        }
+        condQueued.notify_one();
+    }
+
+    /** Make a callback on the calling thread */
+    void Run(const std::function<void()>& func)
+    {
+        int64_t nStart = GetTimeMicros();
+        func();
+        int64_t nTime = GetTimeMicros() - nStart;
+        std::lock_guard<std::mutex> lock(cs);
+        nCallbacks++;
+        nCallbackMicros += nTime;
+        nMaxCallbackMicros = std::max(nMaxCallbackMicros, nTime);
+    }
+
+    void ThreadCallbacks()
+    {
+        while (true) {
+            std::function<void()> func;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                fRunning = false;
+                condProgress.notify_all();
+                while (queue.empty() && !fStopping)
+                    condQueued.wait(lock);
+                // Callbacks queued before unregistering are still made
+                if (queue.empty())
+                    return;
+                func = std::move(queue.front());
+                queue.pop_front();
+                fRunning = true;
+            }
+            condProgress.notify_all();
+            Run(func);
+        }
+    }
+
+    /** Wait until the callbacks queued so far have been made */
+    void Sync()
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        while (!queue.empty() || fRunning)
+            condProgress.wait(lock);
+    }
+
+    ValidationInterfaceStats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(cs);
+        ValidationInterfaceStats stats;
+        stats.strName = strName;
+        stats.fAsync = nMaxQueueSize > 0;
+        stats.nQueueSize = queue.size();
+        stats.nMaxQueueSize = nMaxQueueSize;
+        stats.nPeakQueueSize = nPeakQueueSize;
+        stats.nCallbacks = nCallbacks;
+        stats.nCallbackMicros = nCallbackMicros;
+        stats.nMaxCallbackMicros = nMaxCallbackMicros;
+        stats.nBlockedMicros = nBlockedMicros;
+        return stats;
+    }
+};
+
 static CMainSignals g_signals;
 
 void CMainSignals::RegisterBackgroundSignalScheduler(CScheduler& scheduler) {
@@ -54,40 +226,59 @@ CMainSignals& GetMainSignals()
     return g_signals;
 }
 
-void RegisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.m_internals->UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->TransactionAddedToMempool.connect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.connect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.connect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
-    g_signals.m_internals->SetBestChain.connect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->Inventory.connect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.m_internals->Broadcast.connect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->BlockChecked.connect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.m_internals->NewPoWValidBlock.connect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+static void RegisterListener(MainSignalsInstance& internals, CValidationInterface* pwalletIn, const std::string& strName, size_t nMaxQueueSize) {
+    std::unique_ptr<ValidationListener> listener(new ValidationListener(pwalletIn, strName.empty() ? "unnamed" : strName, nMaxQueueSize));
+    listener->Connect(internals);
+    std::lock_guard<std::mutex> lock(internals.cs_listeners);
+    internals.listeners.push_back(std::move(listener));
+}
+
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strName) {
+    RegisterListener(*g_signals.m_internals, pwalletIn, strName, 0);
+}
+
+void RegisterAsyncValidationInterface(CValidationInterface* pwalletIn, const std::string& strName, size_t nMaxQueueSize) {
+    RegisterListener(*g_signals.m_internals, pwalletIn, strName, std::max(nMaxQueueSize, (size_t)1));
 }
 
 void UnregisterValidationInterface(CValidationInterface* pwalletIn) {
-    g_signals.m_internals->BlockChecked.disconnect(boost::bind(&CValidationInterface::BlockChecked, pwalletIn, _1, _2));
-    g_signals.m_internals->Broadcast.disconnect(boost::bind(&CValidationInterface::ResendWalletTransactions, pwalletIn, _1, _2));
-    g_signals.m_internals->Inventory.disconnect(boost::bind(&CValidationInterface::Inventory, pwalletIn, _1));
-    g_signals.m_internals->SetBestChain.disconnect(boost::bind(&CValidationInterface::SetBestChain, pwalletIn, _1));
-    g_signals.m_internals->TransactionAddedToMempool.disconnect(boost::bind(&CValidationInterface::TransactionAddedToMempool, pwalletIn, _1));
-    g_signals.m_internals->BlockConnected.disconnect(boost::bind(&CValidationInterface::BlockConnected, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->BlockDisconnected.disconnect(boost::bind(&CValidationInterface::BlockDisconnected, pwalletIn, _1));
-    g_signals.m_internals->UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1, _2, _3));
-    g_signals.m_internals->NewPoWValidBlock.disconnect(boost::bind(&CValidationInterface::NewPoWValidBlock, pwalletIn, _1, _2));
+    std::unique_ptr<ValidationListener> listener;
+    {
+        std::lock_guard<std::mutex> lock(g_signals.m_internals->cs_listeners);
+        std::list<std::unique_ptr<ValidationListener>>& listeners = g_signals.m_internals->listeners;
+        for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+            if ((*it)->pinterface == pwalletIn) {
+                listener = std::move(*it);
+                listeners.erase(it);
+                break;
+            }
+        }
+    }
+    // Destroyed outside cs_listeners, as it may make queued callbacks
+    listener.reset();
 }
 
 void UnregisterAllValidationInterfaces() {
-    g_signals.m_internals->BlockChecked.disconnect_all_slots();
-    g_signals.m_internals->Broadcast.disconnect_all_slots();
-    g_signals.m_internals->Inventory.disconnect_all_slots();
-    g_signals.m_internals->SetBestChain.disconnect_all_slots();
-    g_signals.m_internals->TransactionAddedToMempool.disconnect_all_slots();
-    g_signals.m_internals->BlockConnected.disconnect_all_slots();
-    g_signals.m_internals->BlockDisconnected.disconnect_all_slots();
-    g_signals.m_internals->UpdatedBlockTip.disconnect_all_slots();
-    g_signals.m_internals->NewPoWValidBlock.disconnect_all_slots();
+    std::list<std::unique_ptr<ValidationListener>> listeners;
+    {
+        std::lock_guard<std::mutex> lock(g_signals.m_internals->cs_listeners);
+        listeners.swap(g_signals.m_internals->listeners);
+    }
+    listeners.clear();
+}
+
+void SyncWithValidationInterfaceQueues() {
+    std::lock_guard<std::mutex> lock(g_signals.m_internals->cs_listeners);
+    for (const auto& listener : g_signals.m_internals->listeners)
+        listener->Sync();
+}
+
+std::vector<ValidationInterfaceStats> GetValidationInterfaceStats() {
+    std::vector<ValidationInterfaceStats> result;
+    std::lock_guard<std::mutex> lock(g_signals.m_internals->cs_listeners);
+    for (const auto& listener : g_signals.m_internals->listeners)
+        result.push_back(listener->GetStats());
+    return result;
 }
 
 void CMainSignals::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {
@@ -8,6 +8,9 @@
 #define BITCOIN_VALIDATIONINTERFACE_H
 
 #include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
 
 #include "primitives/transaction.h" // CTransaction(Ref)
 
@@ -21,15 +24,49 @@ class CValidationInterface;
 class CValidationState;
 class uint256;
 class CScheduler;
+struct ValidationListener;
+
+/** Default maximum number of callbacks waiting for an asynchronous listener */
+static const unsigned int DEFAULT_VALIDATION_QUEUE_SIZE = 1000;
 
 // These functions dispatch to one or all registered wallets
 
-/** Register a wallet to receive updates from core */
-void RegisterValidationInterface(CValidationInterface* pwalletIn);
-/** Unregister a wallet from core */
+/** Register a wallet to receive updates from core, named strName in GetValidationInterfaceStats */
+void RegisterValidationInterface(CValidationInterface* pwalletIn, const std::string& strName = "");
+/**
+ * Register a listener whose callbacks are made in order by a thread of its
+ * own, so a slow listener does not hold back validation or other listeners.
+ * Once nMaxQueueSize callbacks are waiting, notifying blocks until the
+ * listener catches up; as notifications are sent with cs_main held, its
+ * callbacks must not take cs_main. BlockChecked and NewPoWValidBlock are
+ * still called synchronously, their arguments do not outlive the call.
+ * Listeners that only hand notifications to a queue of their own, like ZMQ,
+ * are better registered synchronously: a second queue would only add a
+ * thread, and block validation where their own queue drops notifications.
+ */
+void RegisterAsyncValidationInterface(CValidationInterface* pwalletIn, const std::string& strName, size_t nMaxQueueSize = DEFAULT_VALIDATION_QUEUE_SIZE);
+/** Unregister a wallet from core. Callbacks still queued for it are made first. */
 void UnregisterValidationInterface(CValidationInterface* pwalletIn);
 /** Unregister all wallets from core */
 void UnregisterAllValidationInterfaces();
+/** Wait until the callbacks queued so far for asynchronous listeners have been made */
+void SyncWithValidationInterfaceQueues();
+
+/** Callback statistics of a registered listener */
+struct ValidationInterfaceStats
+{
+    std::string strName;
+    bool fAsync;
+    size_t nQueueSize;
+    size_t nMaxQueueSize;
+    size_t nPeakQueueSize;
+    uint64_t nCallbacks;
+    int64_t nCallbackMicros;    //!< total time spent in the listener's callbacks
+    int64_t nMaxCallbackMicros; //!< longest single callback
+    int64_t nBlockedMicros;     //!< time notifications waited for room in the queue
+};
+
+std::vector<ValidationInterfaceStats> GetValidationInterfaceStats();
 
 class CValidationInterface {
 protected:
@@ -61,9 +98,7 @@ protected:
      * Notifies listeners that a block which builds directly on our current tip
      * has been received and connected to the headers tree, though not validated yet */
     virtual void NewPoWValidBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock>& block) {};
-    friend void ::RegisterValidationInterface(CValidationInterface*);
-    friend void ::UnregisterValidationInterface(CValidationInterface*);
-    friend void ::UnregisterAllValidationInterfaces();
+    friend struct ::ValidationListener;
 };
 
 struct MainSignalsInstance;
@@ -71,9 +106,12 @@ class CMainSignals {
 private:
     std::unique_ptr<MainSignalsInstance> m_internals;
 
-    friend void ::RegisterValidationInterface(CValidationInterface*);
+    friend void ::RegisterValidationInterface(CValidationInterface*, const std::string&);
+    friend void ::RegisterAsyncValidationInterface(CValidationInterface*, const std::string&, size_t);
     friend void ::UnregisterValidationInterface(CValidationInterface*);
     friend void ::UnregisterAllValidationInterfaces();
+    friend void ::SyncWithValidationInterfaceQueues();
+    friend std::vector<ValidationInterfaceStats> (::GetValidationInterfaceStats)();
 
 public:
     /** Register a CScheduler to give callbacks which should run in the background (may only be called once) */
@@ -5,14 +5,19 @@
 
 #include "wallet/wallet.h"
 
+#include <algorithm>
 #include <set>
 #include <stdint.h>
+#include <tuple>
 #include <utility>
 #include <vector>
 
+#include "chainparams.h"
+#include "consensus/tx_verify.h"
 #include "consensus/validation.h"
 #include "rpc/server.h"
 #include "test/test_bitcoin.h"
+#include "timedata.h"
 #include "validation.h"
 #include "wallet/coincontrol.h"
 #include "wallet/test/wallet_test_fixture.h"
@@ -440,6 +445,48 @@ BOOST_FIXTURE_TEST_CASE(rescan, TestChain100Setup)
     }
 }
 
+// Verify a rescan reading blocks on several threads finds the same wallet
+// transactions as one reading them on a single thread, including a
+// transaction that only spends from the wallet.
+BOOST_FIXTURE_TEST_CASE(rescan_parallel_matches_serial, TestChain100Setup)
+{
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.resize(1);
+    spend.vout[0].nValue = 11 * CENT;
+    spend.vout[0].scriptPubKey = GetScriptForRawPubKey(otherKey.GetPubKey());
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(coinbaseTxns[0].vout[0].scriptPubKey, spend, 0, SIGHASH_ALL, 0, SIGVERSION_BASE);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    CreateAndProcessBlock({spend}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+
+    LOCK(cs_main);
+    CBlockIndex* const nullBlock = nullptr;
+    std::vector<std::tuple<uint256, uint256, int>> vScanned[2];
+    CWalletBalance balance[2];
+    for (int i = 0; i < 2; i++) {
+        gArgs.ForceSetArg("-rescanthreads", i ? "4" : "1");
+        CWallet wallet;
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+        BOOST_CHECK_EQUAL(nullBlock, wallet.ScanForWalletTransactions(chainActive.Genesis()));
+        BOOST_CHECK(wallet.GetWalletTx(spend.GetHash()));
+        for (const std::pair<const uint256, CWalletTx>& item : wallet.mapWallet)
+            vScanned[i].emplace_back(item.first, item.second.hashBlock, item.second.nIndex);
+        balance[i] = wallet.GetBalances();
+    }
+    gArgs.ForceSetArg("-rescanthreads", std::to_string(DEFAULT_RESCAN_THREADS));
+
+    BOOST_CHECK_EQUAL(vScanned[0].size(), 102);
+    BOOST_CHECK(vScanned[0] == vScanned[1]);
+    BOOST_CHECK(balance[0] == balance[1]);
+}
+
 // Verify importwallet RPC starts rescan at earliest block with timestamp
 // greater or equal than key birthday. Previously there was a bug where
 // importwallet RPC would start the scan at the latest block with timestamp less
@@ -510,8 +557,8 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup)
     CWallet wallet;
     CWalletTx wtx(&wallet, MakeTransactionRef(coinbaseTxns.back()));
     LOCK2(cs_main, wallet.cs_wallet);
-    wtx.hashBlock = chainActive.Tip()->GetBlockHash();
-    wtx.nIndex = 0;
+    wtx.SetMerkleBranch(chainActive.Tip(), 0);
+    wallet.UpdateChainSnapshot();
 
     // Call GetImmatureCredit() once before adding the key to the wallet to
     // cache the current immature credit amount, which is 0.
@@ -524,6 +571,39 @@ BOOST_FIXTURE_TEST_CASE(coin_mark_dirty_immature_credit, TestChain100Setup)
     BOOST_CHECK_EQUAL(wtx.GetImmatureCredit(), 100*COIN);
 }
 
+BOOST_FIXTURE_TEST_CASE(wallet_mark_dirty_invalidates_lazily, TestChain100Setup)
+{
+    CWallet wallet;
+    CWalletTx wtxCoinbase(&wallet, MakeTransactionRef(coinbaseTxns.back()));
+    CScript redeemScript = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(coinbaseTxns.back().GetHash(), 0);
+    mtx.vout.resize(1);
+    mtx.vout[0].scriptPubKey = GetScriptForDestination(CScriptID(redeemScript));
+    mtx.vout[0].nValue = 10*COIN;
+    CWalletTx wtxP2SH(&wallet, MakeTransactionRef(mtx));
+    LOCK2(cs_main, wallet.cs_wallet);
+    wtxCoinbase.SetMerkleBranch(chainActive.Tip(), 0);
+    wallet.UpdateChainSnapshot();
+
+    // Cache credits computed while neither output is ours
+    BOOST_CHECK_EQUAL(wtxCoinbase.GetImmatureCredit(), 0);
+    BOOST_CHECK_EQUAL(wtxP2SH.GetCredit(ISMINE_SPENDABLE), 0);
+
+    // Adding a key alone leaves cached amounts in place; a wallet-wide
+    // MarkDirty() drops them without visiting every transaction
+    wallet.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey());
+    BOOST_CHECK_EQUAL(wtxCoinbase.GetImmatureCredit(), 0);
+    wallet.MarkDirty();
+    BOOST_CHECK_EQUAL(wtxCoinbase.GetImmatureCredit(), 100*COIN);
+
+    // Adding a script marks the wallet dirty itself
+    BOOST_CHECK_EQUAL(wtxP2SH.GetCredit(ISMINE_SPENDABLE), 0);
+    wallet.AddCScript(redeemScript);
+    BOOST_CHECK_EQUAL(wtxP2SH.GetCredit(ISMINE_SPENDABLE), 10*COIN);
+}
+
 static int64_t AddTx(CWallet& wallet, uint32_t lockTime, int64_t mockTime, int64_t blockTime)
 {
     CMutableTransaction tx;
@@ -626,7 +706,9 @@ public:
         auto it = wallet->mapWallet.find(wtx.GetHash());
         BOOST_CHECK(it != wallet->mapWallet.end());
         CreateAndProcessBlock({CMutableTransaction(*it->second.tx)}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+        LOCK(cs_main);
         it->second.SetMerkleBranch(chainActive.Tip(), 1);
+        wallet->UpdateChainSnapshot();
         return it->second;
     }
 
@@ -678,4 +760,267 @@ BOOST_FIXTURE_TEST_CASE(ListCoins, ListCoinsTestingSetup)
     BOOST_CHECK_EQUAL(list.begin()->second.size(), 2);
 }
 
+static CAmount SumAvailableCoins(const CWallet& wallet, size_t nExpectedCoins)
+{
+    std::vector<COutput> coins;
+    wallet.AvailableCoins(coins);
+    BOOST_CHECK_EQUAL(coins.size(), nExpectedCoins);
+    CAmount nTotal = 0;
+    for (const COutput& coin : coins)
+        nTotal += coin.tx->tx->vout[coin.i].nValue;
+    return nTotal;
+}
+
+// Check that the incrementally maintained balances and spendable coins follow
+// transactions changing state as the wallet's chain snapshot moves, without
+// the transactions being touched, and that the balances always match a full
+// scan of the wallet.
+BOOST_FIXTURE_TEST_CASE(wallet_balances, ListCoinsTestingSetup)
+{
+    LOCK2(cs_main, wallet->cs_wallet);
+
+    // One mature and 100 immature coinbase transactions.
+    CWalletBalance balance = wallet->GetBalances();
+    BOOST_CHECK(balance == wallet->ComputeBalances());
+    BOOST_CHECK_EQUAL(balance.nTrusted, 100 * COIN);
+    BOOST_CHECK_EQUAL(balance.nImmature, 100 * 100 * COIN);
+    BOOST_CHECK_EQUAL(balance.nUntrustedPending, 0);
+    BOOST_CHECK_EQUAL(SumAvailableCoins(*wallet, 1), balance.nTrusted);
+
+    // A new block matures the next coinbase transaction.
+    CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    wallet->UpdateChainSnapshot();
+    balance = wallet->GetBalances();
+    BOOST_CHECK(balance == wallet->ComputeBalances());
+    BOOST_CHECK_EQUAL(balance.nTrusted, 200 * COIN);
+    BOOST_CHECK_EQUAL(balance.nImmature, 99 * 100 * COIN);
+    BOOST_CHECK_EQUAL(SumAvailableCoins(*wallet, 2), balance.nTrusted);
+
+    // Spend 1 coin in a transaction that is confirmed in the next block,
+    // maturing another coinbase transaction.
+    AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    balance = wallet->GetBalances();
+    BOOST_CHECK(balance == wallet->ComputeBalances());
+    BOOST_CHECK(balance.nTrusted < 299 * COIN);
+    BOOST_CHECK(balance.nTrusted > 298 * COIN);
+    BOOST_CHECK_EQUAL(balance.nImmature, 98 * 100 * COIN);
+    BOOST_CHECK_EQUAL(SumAvailableCoins(*wallet, 3), balance.nTrusted);
+
+    // Coins of confirmed transactions are returned by ascending amount, and
+    // the amount range is honoured.
+    std::vector<COutput> coins;
+    wallet->AvailableCoins(coins, true, nullptr, 100 * COIN, 100 * COIN);
+    BOOST_CHECK_EQUAL(coins.size(), 2);
+    wallet->AvailableCoins(coins);
+    BOOST_CHECK(coins.front().tx->tx->vout[coins.front().i].nValue < 100 * COIN);
+
+    // Discarding the incremental state gives the same balances.
+    wallet->MarkDirty();
+    BOOST_CHECK(wallet->GetBalances() == balance);
+}
+
+// Check that a coinbase that matured becomes immature again when the tip
+// moves back without its own block being disconnected.
+BOOST_FIXTURE_TEST_CASE(wallet_balances_tip_invalidated, ListCoinsTestingSetup)
+{
+    LOCK2(cs_main, wallet->cs_wallet);
+
+    CBlock block = CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    wallet->UpdateChainSnapshot();
+    CWalletBalance balance = wallet->GetBalances();
+    BOOST_CHECK_EQUAL(balance.nTrusted, 200 * COIN);
+    BOOST_CHECK_EQUAL(SumAvailableCoins(*wallet, 2), balance.nTrusted);
+
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params(), chainActive.Tip()));
+    wallet->BlockDisconnected(std::make_shared<const CBlock>(block));
+    balance = wallet->GetBalances();
+    BOOST_CHECK(balance == wallet->ComputeBalances());
+    BOOST_CHECK_EQUAL(balance.nTrusted, 100 * COIN);
+    BOOST_CHECK_EQUAL(balance.nImmature, 100 * 100 * COIN);
+    BOOST_CHECK_EQUAL(SumAvailableCoins(*wallet, 1), balance.nTrusted);
+}
+
+// Check that removing transactions from the wallet leaves no references to
+// them in the incremental balance state or the height index.
+BOOST_FIXTURE_TEST_CASE(wallet_zap_select_tx, ListCoinsTestingSetup)
+{
+    LOCK2(cs_main, wallet->cs_wallet);
+
+    CWalletTx& wtx = AddTx(CRecipient{GetScriptForRawPubKey({}), 1 * COIN, false /* subtract fee */});
+    uint256 hash = wtx.GetHash();
+    int nHeight = chainActive.Height() - 1;
+    CWalletBalance balance = wallet->GetBalances();
+    std::vector<const CWalletTx*> vTxs = wallet->GetTransactionsAfterHeight(nHeight);
+    BOOST_CHECK(std::find(vTxs.begin(), vTxs.end(), &wtx) != vTxs.end());
+
+    std::vector<uint256> vHashIn{hash}, vHashOut;
+    BOOST_CHECK_EQUAL(wallet->ZapSelectTx(vHashIn, vHashOut), DB_LOAD_OK);
+    BOOST_CHECK_EQUAL(vHashOut.size(), 1);
+    BOOST_CHECK(!wallet->GetWalletTx(hash));
+
+    // The coin it spent is available again and the change is gone
+    CWalletBalance balanceZapped = wallet->GetBalances();
+    BOOST_CHECK(balanceZapped == wallet->ComputeBalances());
+    BOOST_CHECK(balanceZapped.nTrusted > balance.nTrusted);
+    BOOST_CHECK_EQUAL(SumAvailableCoins(*wallet, 2), balanceZapped.nTrusted);
+    for (const CWalletTx* pwtx : wallet->GetTransactionsAfterHeight(nHeight))
+        BOOST_CHECK(pwtx->GetHash() != hash);
+}
+
+// Check that wallets decoding their records on one and on several threads
+// while loading get the same keys and transactions as the wallet that wrote
+// them.
+BOOST_FIXTURE_TEST_CASE(wallet_load_parallel_decode, ListCoinsTestingSetup)
+{
+    {
+        LOCK(wallet->cs_wallet);
+        CWalletDB walletdb(wallet->GetDBHandle());
+        for (size_t i = 0; i < 4 * MIN_RECORDS_PER_LOAD_THREAD; i++)
+            wallet->GenerateNewKey(walletdb);
+    }
+    LOCK(wallet->cs_wallet);
+    std::set<CKeyID> setKeys;
+    wallet->GetKeys(setKeys);
+    BOOST_CHECK_EQUAL(setKeys.size(), 4 * MIN_RECORDS_PER_LOAD_THREAD + 1);
+
+    // Allow more threads than this machine may have cores
+    SetParallelForThreads(4);
+    for (const char* strThreads : {"1", "4"}) {
+        gArgs.ForceSetArg("-walletloadthreads", strThreads);
+        CWallet loaded(std::unique_ptr<CWalletDBWrapper>(new CWalletDBWrapper(&bitdb, "wallet_test.dat")));
+        bool firstRun;
+        BOOST_CHECK_EQUAL(loaded.LoadWallet(firstRun), DB_LOAD_OK);
+
+        LOCK(loaded.cs_wallet);
+        std::set<CKeyID> setKeysLoaded;
+        loaded.GetKeys(setKeysLoaded);
+        BOOST_CHECK(setKeys == setKeysLoaded);
+        for (const CKeyID& keyID : setKeys) {
+            CKey key, keyLoaded;
+            BOOST_CHECK(wallet->GetKey(keyID, key));
+            BOOST_CHECK(loaded.GetKey(keyID, keyLoaded));
+            BOOST_CHECK(key == keyLoaded);
+        }
+
+        BOOST_CHECK_EQUAL(loaded.mapWallet.size(), wallet->mapWallet.size());
+        for (const std::pair<const uint256, CWalletTx>& item : wallet->mapWallet) {
+            const CWalletTx* wtx = loaded.GetWalletTx(item.first);
+            BOOST_CHECK(wtx && wtx->hashBlock == item.second.hashBlock && wtx->nOrderPos == item.second.nOrderPos);
+        }
+    }
+    gArgs.ForceSetArg("-walletloadthreads", std::to_string(DEFAULT_WALLET_LOAD_THREADS));
+    SetParallelForThreads(0);
+}
+
+// Check that time locks are compared against the median time past of the
+// wallet's tip, like the mempool does, rather than the current time.
+BOOST_FIXTURE_TEST_CASE(wallet_final_tx_median_time_past, ListCoinsTestingSetup)
+{
+    LOCK2(cs_main, wallet->cs_wallet);
+    wallet->UpdateChainSnapshot();
+    int64_t nMedianTimePast = chainActive.Tip()->GetMedianTimePast();
+    SetMockTime(nMedianTimePast + 2000);
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    mtx.vin[0].nSequence = 0;
+    mtx.vout.resize(1);
+    mtx.nLockTime = nMedianTimePast + 1000;
+    BOOST_CHECK(IsFinalTx(mtx, chainActive.Height() + 1, GetAdjustedTime()));
+    BOOST_CHECK(!wallet->CheckFinalTxAtTip(mtx));
+    mtx.nLockTime = nMedianTimePast - 1;
+    BOOST_CHECK(wallet->CheckFinalTxAtTip(mtx));
+
+    SetMockTime(0);
+}
+
+// Check that transaction depths follow the block notifications the wallet
+// has received rather than the active chain, so they can be read holding only
+// cs_wallet.
+BOOST_FIXTURE_TEST_CASE(wallet_chain_snapshot, ListCoinsTestingSetup)
+{
+    const CWalletTx* wtx;
+    int nDepth;
+    {
+        LOCK(wallet->cs_wallet);
+        wtx = wallet->GetWalletTx(coinbaseTxns.front().GetHash());
+        BOOST_CHECK(wtx != nullptr);
+        nDepth = wtx->GetDepthInMainChain();
+        BOOST_CHECK_EQUAL(nDepth, wallet->GetSnapshotHeight());
+    }
+
+    // Until the wallet is notified of a new block its depths stay the same.
+    CBlock block = CreateAndProcessBlock({}, GetScriptForRawPubKey(coinbaseKey.GetPubKey()));
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK_EQUAL(wtx->GetDepthInMainChain(), nDepth);
+        BOOST_CHECK(!wallet->GetWalletTx(block.vtx[0]->GetHash()));
+    }
+
+    {
+        LOCK(cs_main);
+        wallet->BlockConnected(std::make_shared<const CBlock>(block), chainActive.Tip(), {});
+    }
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK_EQUAL(wtx->GetDepthInMainChain(), nDepth + 1);
+        const CWalletTx* wtxNew = wallet->GetWalletTx(block.vtx[0]->GetHash());
+        BOOST_CHECK(wtxNew != nullptr);
+        BOOST_CHECK_EQUAL(wtxNew->GetDepthInMainChain(), 1);
+        BOOST_CHECK_EQUAL(wallet->GetSnapshotHeight(), nDepth + 1);
+    }
+
+    // Disconnecting the block moves the snapshot back.
+    {
+        LOCK(cs_main);
+        wallet->BlockDisconnected(std::make_shared<const CBlock>(block));
+    }
+    {
+        LOCK(wallet->cs_wallet);
+        BOOST_CHECK_EQUAL(wtx->GetDepthInMainChain(), nDepth);
+        BOOST_CHECK_EQUAL(wallet->GetWalletTx(block.vtx[0]->GetHash())->GetDepthInMainChain(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(keypool_hd_refill)
+{
+    LOCK(pwalletMain->cs_wallet);
+    pwalletMain->SetMinVersion(FEATURE_HD_SPLIT);
+    BOOST_CHECK(pwalletMain->SetHDMasterKey(pwalletMain->GenerateNewHDMasterKey()));
+
+    // More keys than fit in one batch, derived on several threads
+    const unsigned int nKeys = KEYPOOL_BATCH_SIZE + 250;
+    BOOST_CHECK(pwalletMain->TopUpKeyPool(nKeys));
+    BOOST_CHECK_EQUAL(pwalletMain->KeypoolCountExternalKeys(), nKeys);
+    BOOST_CHECK_EQUAL(pwalletMain->GetKeyPoolSize(), 2 * nKeys);
+    BOOST_CHECK_EQUAL(pwalletMain->GetHDChain().nExternalChainCounter, nKeys);
+    BOOST_CHECK_EQUAL(pwalletMain->GetHDChain().nInternalChainCounter, nKeys);
+
+    // The pool holds exactly the keys at m/0'/0'/<n>' and m/0'/1'/<n>'
+    CKey seed;
+    BOOST_CHECK(pwalletMain->GetKey(pwalletMain->GetHDChain().masterKeyID, seed));
+    CExtKey masterKey, accountKey, chainKey, childKey;
+    masterKey.SetMaster(seed.begin(), seed.size());
+    masterKey.Derive(accountKey, 0x80000000);
+    for (int internal = 0; internal < 2; internal++) {
+        accountKey.Derive(chainKey, 0x80000000 + internal);
+        for (unsigned int i = 0; i < nKeys; i++) {
+            chainKey.Derive(childKey, i | 0x80000000);
+            CKeyID keyID = childKey.key.GetPubKey().GetID();
+            BOOST_CHECK(pwalletMain->HaveKey(keyID));
+            BOOST_CHECK_EQUAL(pwalletMain->mapKeyMetadata[keyID].hdKeypath,
+                              strprintf("m/0'/%d'/%u'", internal, i));
+        }
+    }
+
+    // Single keys continue the chain where the refill stopped
+    CWalletDB walletdb(pwalletMain->GetDBHandle());
+    CPubKey pubkey = pwalletMain->GenerateNewKey(walletdb, false);
+    accountKey.Derive(chainKey, 0x80000000);
+    chainKey.Derive(childKey, nKeys | 0x80000000);
+    BOOST_CHECK(pubkey == childKey.key.GetPubKey());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include "chain.h"
 #include "wallet/coincontrol.h"
 #include "consensus/consensus.h"
+#include "consensus/tx_verify.h"
 #include "consensus/validation.h"
 #include "fs.h"
 #include "init.h"
@@ -26,6 +27,7 @@
 #include "script/script.h"
 #include "script/sign.h"
 #include "scheduler.h"
+#include "support/cleanse.h"
 #include "timedata.h"
 #include "txmempool.h"
 #include "util.h"
@@ -34,6 +36,9 @@
 #include "../primitives/transaction.h"
 
 #include <assert.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -44,6 +49,7 @@ CFeeRate payTxFee(DEFAULT_TRANSACTION_FEE);
 unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
 bool fWalletRbf = DEFAULT_WALLET_RBF;
+bool fCheckWalletBalance = DEFAULT_CHECK_WALLET_BALANCE;
 
 const char * DEFAULT_WALLET_DAT = "wallet.dat";
 const uint32_t BIP32_HARDENED_KEY_LIMIT = 0x80000000;
@@ -144,7 +150,7 @@ CPubKey CWallet::GenerateNewKey(CWalletDB &walletdb, bool internal)
 
     // Compressed public keys were introduced in version 0.6.0
     if (fCompressed) {
-        SetMinVersion(FEATURE_COMPRPUBKEY);
+        SetMinVersion(FEATURE_COMPRPUBKEY, &walletdb);
     }
 
     CPubKey pubkey = secret.GetPubKey();
@@ -159,28 +165,64 @@ CPubKey CWallet::GenerateNewKey(CWalletDB &walletdb, bool internal)
     return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal)
+/** Derive the hardened children nFirst, nFirst + 1, ... of chainKey into vKeys, spread over threads */
+static void DeriveHardenedChildKeys(const CExtKey& chainKey, uint32_t nFirst, std::vector<std::pair<CKey, CPubKey>>& vKeys)
 {
+    ParallelFor("hdderive", vKeys.size(), MIN_KEYS_PER_DERIVE_THREAD, 0, [&chainKey, nFirst, &vKeys](size_t i) {
+        CExtKey childKey;
+        chainKey.Derive(childKey, (nFirst + i) | BIP32_HARDENED_KEY_LIMIT);
+        vKeys[i].first = childKey.key;
+        vKeys[i].second = childKey.key.GetPubKey();
+        assert(vKeys[i].first.VerifyPubKey(vKeys[i].second));
+    });
+}
+
+CExtKey CWallet::GetHDChainKey(bool internal)
+{
+    AssertLockHeld(cs_wallet);
+
     // for now we use a fixed keypath scheme of m/0'/0'/k
-    CKey key;                      //master key seed (256bit)
-    CExtKey masterKey;             //hd master key
-    CExtKey accountKey;            //key at m/0'
-    CExtKey chainChildKey;         //key at m/0'/0' (external) or m/0'/1' (internal)
-    CExtKey childKey;              //key at m/0'/0'/<n>'
+    if (hdChainKeysMaster != hdChain.masterKeyID) {
+        WipeHDChainKeys();
+        hdChainKeysMaster = hdChain.masterKeyID;
+    }
+    if (!fHDChainKeyCached[internal]) {
+        CKey key;                      //master key seed (256bit)
+        CExtKey masterKey;             //hd master key
+        CExtKey accountKey;            //key at m/0'
+
+        // try to get the master key
+        if (!GetKey(hdChain.masterKeyID, key))
+            throw std::runtime_error(std::string(__func__) + ": Master key not found");
 
-    // try to get the master key
-    if (!GetKey(hdChain.masterKeyID, key))
-        throw std::runtime_error(std::string(__func__) + ": Master key not found");
+        masterKey.SetMaster(key.begin(), key.size());
 
-    masterKey.SetMaster(key.begin(), key.size());
+        // derive m/0'
+        // use hardened derivation (child keys >= 0x80000000 are hardened after bip32)
+        masterKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
+
+        // derive m/0'/0' (external chain) OR m/0'/1' (internal chain)
+        assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
+        accountKey.Derive(hdChainKeys[internal], BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+        fHDChainKeyCached[internal] = true;
+    }
+    return hdChainKeys[internal];
+}
 
-    // derive m/0'
-    // use hardened derivation (child keys >= 0x80000000 are hardened after bip32)
-    masterKey.Derive(accountKey, BIP32_HARDENED_KEY_LIMIT);
+void CWallet::WipeHDChainKeys()
+{
+    AssertLockHeld(cs_wallet);
+    for (int i = 0; i < 2; i++) {
+        memory_cleanse(hdChainKeys[i].chaincode.begin(), hdChainKeys[i].chaincode.size());
+        hdChainKeys[i].key = CKey();
+        fHDChainKeyCached[i] = false;
+    }
+}
 
-    // derive m/0'/0' (external chain) OR m/0'/1' (internal chain)
-    assert(internal ? CanSupportFeature(FEATURE_HD_SPLIT) : true);
-    accountKey.Derive(chainChildKey, BIP32_HARDENED_KEY_LIMIT+(internal ? 1 : 0));
+void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal)
+{
+    CExtKey chainChildKey = GetHDChainKey(internal); //key at m/0'/0' (external) or m/0'/1' (internal)
+    CExtKey childKey;                                //key at m/0'/0'/<n>'
 
     // derive child key at next index, skip keys already known to the wallet
     do {
@@ -205,6 +247,55 @@ void CWallet::DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKe
         throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
 }
 
+std::vector<CPubKey> CWallet::GenerateNewKeys(CWalletDB& walletdb, size_t nKeys, bool internal)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata
+    std::vector<CPubKey> vPubKeys;
+    vPubKeys.reserve(nKeys);
+
+    if (!IsHDEnabled()) {
+        while (vPubKeys.size() < nKeys) {
+            vPubKeys.push_back(GenerateNewKey(walletdb, internal));
+        }
+        return vPubKeys;
+    }
+
+    internal = CanSupportFeature(FEATURE_HD_SPLIT) ? internal : false;
+    CExtKey chainChildKey = GetHDChainKey(internal);
+    uint32_t& nCounter = internal ? hdChain.nInternalChainCounter : hdChain.nExternalChainCounter;
+    const std::string strKeypath = internal ? "m/0'/1'/" : "m/0'/0'/";
+
+    // HD keys are always compressed
+    SetMinVersion(FEATURE_COMPRPUBKEY, &walletdb);
+
+    int64_t nCreationTime = GetTime();
+    while (vPubKeys.size() < nKeys) {
+        std::vector<std::pair<CKey, CPubKey>> vKeys(nKeys - vPubKeys.size());
+        DeriveHardenedChildKeys(chainChildKey, nCounter, vKeys);
+        for (const std::pair<CKey, CPubKey>& key : vKeys) {
+            CKeyMetadata metadata(nCreationTime);
+            metadata.hdKeypath = strKeypath + std::to_string(nCounter) + "'";
+            metadata.hdMasterKeyID = hdChain.masterKeyID;
+            nCounter++;
+            // skip keys already known to the wallet
+            if (HaveKey(key.second.GetID())) {
+                continue;
+            }
+            mapKeyMetadata[key.second.GetID()] = metadata;
+            if (!AddKeyPubKeyWithDB(walletdb, key.first, key.second)) {
+                throw std::runtime_error(std::string(__func__) + ": AddKey failed");
+            }
+            vPubKeys.push_back(key.second);
+        }
+    }
+    UpdateTimeFirstKey(nCreationTime);
+
+    // update the chain model in the database, once for all keys
+    if (!walletdb.WriteHDChain(hdChain))
+        throw std::runtime_error(std::string(__func__) + ": Writing HD chain model failed");
+    return vPubKeys;
+}
+
 bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey& secret, const CPubKey &pubkey)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
@@ -221,16 +312,17 @@ bool CWallet::AddKeyPubKeyWithDB(CWalletDB &walletdb, const CKey& secret, const
         return false;
     }
     if (needsDB) pwalletdbEncryption = nullptr;
+    nKeyStoreGeneration++;
 
     // check if we need to remove from watch-only
     CScript script;
     script = GetScriptForDestination(pubkey.GetID());
     if (HaveWatchOnly(script)) {
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(walletdb, script);
     }
     script = GetScriptForRawPubKey(pubkey);
     if (HaveWatchOnly(script)) {
-        RemoveWatchOnly(script);
+        RemoveWatchOnlyWithDB(walletdb, script);
     }
 
     if (!IsCrypted()) {
@@ -298,6 +390,9 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    nKeyStoreGeneration++;
+    // Outputs of transactions already in the wallet may be ours now
+    MarkDirty();
     return CWalletDB(*dbw).WriteCScript(Hash160(redeemScript), redeemScript);
 }
 
@@ -321,6 +416,7 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    nKeyStoreGeneration++;
     const CKeyMetadata& meta = mapKeyMetadata[CScriptID(dest)];
     UpdateTimeFirstKey(meta.nCreateTime);
     NotifyWatchonlyChanged(true);
@@ -334,13 +430,19 @@ bool CWallet::AddWatchOnly(const CScript& dest, int64_t nCreateTime)
 }
 
 bool CWallet::RemoveWatchOnly(const CScript &dest)
+{
+    CWalletDB walletdb(*dbw);
+    return RemoveWatchOnlyWithDB(walletdb, dest);
+}
+
+bool CWallet::RemoveWatchOnlyWithDB(CWalletDB& walletdb, const CScript& dest)
 {
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
-    if (!CWalletDB(*dbw).EraseWatchOnly(dest))
+    if (!walletdb.EraseWatchOnly(dest))
         return false;
 
     return true;
@@ -351,6 +453,15 @@ bool CWallet::LoadWatchOnly(const CScript &dest)
     return CCryptoKeyStore::AddWatchOnly(dest);
 }
 
+bool CWallet::Lock()
+{
+    {
+        LOCK(cs_wallet);
+        WipeHDChainKeys();
+    }
+    return CCryptoKeyStore::Lock();
+}
+
 bool CWallet::Unlock(const SecureString& strWalletPassphrase)
 {
     CCrypter crypter;
@@ -620,6 +731,9 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
     std::pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
+
+    // The spent transaction's available credit changed
+    MarkBalanceDirty(outpoint.hash);
 }
 
 
@@ -890,8 +1004,8 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
-        for (std::pair<const uint256, CWalletTx>& item : mapWallet)
-            item.second.MarkDirty();
+        nTxCacheGeneration++;
+        fBalanceFullRecalc = true;
     }
 }
 
@@ -940,6 +1054,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     if (fInsertedNew)
     {
         wtx.nTimeReceived = GetAdjustedTime();
+        wtx.fBalanceCounted = false;
         wtx.nOrderPos = IncOrderPosNext(&walletdb);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         wtx.nTimeSmart = ComputeTimeSmart(wtx);
@@ -949,16 +1064,19 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose)
     bool fUpdated = false;
     if (!fInsertedNew)
     {
-        // Merge
-        if (!wtxIn.hashUnset() && wtxIn.hashBlock != wtx.hashBlock)
+        // Merge. The block index entry may be picked up on its own, if the
+        // block was not in the index yet when the wallet was loaded (-reindex).
+        if (!wtxIn.hashUnset() && (wtxIn.hashBlock != wtx.hashBlock || (wtxIn.pindexBlock && wtxIn.pindexBlock != wtx.pindexBlock)))
         {
             wtx.hashBlock = wtxIn.hashBlock;
+            wtx.pindexBlock = wtxIn.pindexBlock;
             fUpdated = true;
         }
         // If no longer abandoned, update
         if (wtxIn.hashBlock.IsNull() && wtx.isAbandoned())
         {
             wtx.hashBlock = wtxIn.hashBlock;
+            wtx.pindexBlock = nullptr;
             fUpdated = true;
         }
         if (wtxIn.nIndex != -1 && (wtxIn.nIndex != wtx.nIndex))
@@ -1161,10 +1279,11 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
     LOCK2(cs_main, cs_wallet);
 
     int conflictconfirms = 0;
+    CBlockIndex* pindex = nullptr;
     if (mapBlockIndex.count(hashBlock)) {
-        CBlockIndex* pindex = mapBlockIndex[hashBlock];
-        if (chainActive.Contains(pindex)) {
-            conflictconfirms = -(chainActive.Height() - pindex->nHeight + 1);
+        pindex = mapBlockIndex[hashBlock];
+        if (pindexSnapshotTip && pindexSnapshotTip->GetAncestor(pindex->nHeight) == pindex) {
+            conflictconfirms = -(pindexSnapshotTip->nHeight - pindex->nHeight + 1);
         }
     }
     // If number of conflict confirms cannot be determined, this means
@@ -1194,6 +1313,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // Mark transaction as conflicted with this block.
             wtx.nIndex = -1;
             wtx.hashBlock = hashBlock;
+            wtx.pindexBlock = pindex;
             wtx.MarkDirty();
             walletdb.WriteTx(wtx);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
@@ -1238,6 +1358,9 @@ void CWallet::TransactionAddedToMempool(const CTransactionRef& ptx) {
 
 void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex *pindex, const std::vector<CTransactionRef>& vtxConflicted) {
     LOCK2(cs_main, cs_wallet);
+    // Notifications of several connected blocks may be made after the active
+    // chain has moved past all of them, so follow the blocks themselves.
+    pindexSnapshotTip = pindex;
     // TODO: Temporarily ensure that mempool removals are notified before
     // connected transactions.  This shouldn't matter, but the abandoned
     // state of transactions in our wallet is currently cleared when we
@@ -1256,6 +1379,9 @@ void CWallet::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const
 
 void CWallet::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock) {
     LOCK2(cs_main, cs_wallet);
+    BlockMap::const_iterator mi = mapBlockIndex.find(pblock->GetHash());
+    if (mi != mapBlockIndex.end())
+        pindexSnapshotTip = mi->second->pprev;
 
     for (const CTransactionRef& ptx : pblock->vtx) {
         SyncTransaction(ptx);
@@ -1596,6 +1722,128 @@ int64_t CWallet::RescanFromTime(int64_t startTime, bool update)
     return startTime;
 }
 
+/**
+ * Reads the blocks of a rescan on worker threads and checks which of their
+ * transactions have outputs that are ours. The workers follow the active
+ * chain from pindexStart, at most 2 * nThreads blocks ahead of the scan, and
+ * keep their results in a ring buffer of that many slots. Get() hands them
+ * out in chain order.
+ *
+ * Matching uses the wallet's keys at the time the block is read. Get() also
+ * returns the key store generation seen before matching, so keys added by
+ * the rescan itself (keypool top-ups) are not missed.
+ */
+class CRescanReader
+{
+public:
+    CRescanReader(const CWallet& walletIn, const CBlockIndex* pindexStart, int nThreads)
+        : wallet(walletIn), vResults(2 * nThreads), pindexNextRead(pindexStart), nNextRead(0), nNextGet(0), fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threads.emplace_back(&CRescanReader::ThreadRead, this);
+    }
+
+    ~CRescanReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStop = true;
+        }
+        cond.notify_all();
+        for (std::thread& t : threads)
+            t.join();
+    }
+
+    /** Wait for the next block in chain order, which must be pindex */
+    bool Get(const CBlockIndex* pindex, CBlock& block, std::vector<bool>& vMine, uint64_t& nGeneration)
+    {
+        std::unique_lock<std::mutex> lock(cs);
+        Result& slot = vResults[nNextGet % vResults.size()];
+        while (slot.nState == READ_PENDING)
+            cond.wait(lock);
+        assert(slot.pindex == pindex);
+        Result result = std::move(slot);
+        slot = Result();
+        nNextGet++;
+        lock.unlock();
+        cond.notify_all();
+
+        if (result.nState != READ_OK)
+            return false;
+        block = std::move(result.block);
+        vMine = std::move(result.vMine);
+        nGeneration = result.nGeneration;
+        return true;
+    }
+
+private:
+    enum { READ_PENDING, READ_OK, READ_FAILED };
+
+    struct Result
+    {
+        int nState;
+        const CBlockIndex* pindex;
+        CBlock block;
+        std::vector<bool> vMine;
+        uint64_t nGeneration;
+
+        Result() : nState(READ_PENDING), pindex(nullptr), nGeneration(0) {}
+    };
+
+    void ThreadRead()
+    {
+        while (true) {
+            size_t i;
+            Result result;
+            {
+                std::unique_lock<std::mutex> lock(cs);
+                while (!fStop && pindexNextRead && nNextRead >= nNextGet + vResults.size())
+                    cond.wait(lock);
+                if (fStop || !pindexNextRead)
+                    return;
+                i = nNextRead++;
+                result.pindex = pindexNextRead;
+                // The caller holds cs_main for the whole rescan, so neither
+                // the active chain nor the block index entries change while
+                // they are read here.
+                pindexNextRead = chainActive.Next(pindexNextRead);
+            }
+
+            result.nGeneration = wallet.GetKeyStoreGeneration();
+            try {
+                if (ReadBlockFromDisk(result.block, result.pindex->GetBlockPos(), result.pindex->GetBlockHash())) {
+                    result.vMine.reserve(result.block.vtx.size());
+                    for (const CTransactionRef& ptx : result.block.vtx)
+                        result.vMine.push_back(wallet.IsMine(*ptx));
+                    result.nState = READ_OK;
+                } else {
+                    result.nState = READ_FAILED;
+                }
+            } catch (const std::exception& e) {
+                LogPrintf("%s: %s\n", __func__, e.what());
+                result.nState = READ_FAILED;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(cs);
+                vResults[i % vResults.size()] = std::move(result);
+            }
+            cond.notify_all();
+        }
+    }
+
+    const CWallet& wallet;
+
+    std::mutex cs;
+    std::condition_variable cond;
+    std::vector<Result> vResults;
+    const CBlockIndex* pindexNextRead;
+    size_t nNextRead;
+    size_t nNextGet;
+    bool fStop;
+    std::vector<std::thread> threads;
+};
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
@@ -1604,40 +1852,55 @@ int64_t CWallet::RescanFromTime(int64_t startTime, bool update)
  * Returns null if scan was successful. Otherwise, if a complete rescan was not
  * possible (due to pruning or corruption), returns pointer to the most recent
  * block that could not be scanned.
+ *
+ * Blocks are read and matched against the wallet's keys by up to
+ * -rescanthreads threads ahead of the scan, and applied to the wallet in
+ * chain order.
  */
 CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int64_t nNow = GetTime();
     const CChainParams& chainParams = Params();
+    const int nThreads = std::max(1, std::min((int)gArgs.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS), MAX_RESCAN_THREADS));
 
-    CBlockIndex* pindex = pindexStart;
     CBlockIndex* ret = nullptr;
     {
         LOCK2(cs_main, cs_wallet);
         fAbortRescan = false;
         fScanningWallet = true;
+        pindexSnapshotTip = chainActive.Tip();
 
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
-        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindex);
+        double dProgressStart = GuessVerificationProgress(chainParams.TxData(), pindexStart);
         double dProgressTip = GuessVerificationProgress(chainParams.TxData(), chainActive.Tip());
-        while (pindex && !fAbortRescan)
+        CBlockIndex* pindex = pindexStart;
         {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
-            if (GetTime() >= nNow + 60) {
-                nNow = GetTime();
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
-            }
+            int nBlocks = pindexStart ? chainActive.Height() - pindexStart->nHeight + 1 : 0;
+            CRescanReader reader(*this, pindexStart, std::max(1, std::min(nThreads, nBlocks)));
+            for (; pindex && !fAbortRescan; pindex = chainActive.Next(pindex))
+            {
+                if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((GuessVerificationProgress(chainParams.TxData(), pindex) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+                if (GetTime() >= nNow + 60) {
+                    nNow = GetTime();
+                    LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
+                }
 
-            CBlock block;
-            if (ReadBlockFromDisk(block, pindex, Params().GetConsensus())) {
-                for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
-                    AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                CBlock block;
+                std::vector<bool> vMine;
+                uint64_t nGeneration;
+                if (reader.Get(pindex, block, vMine, nGeneration)) {
+                    // Keys added since the block was matched may make more of
+                    // its outputs ours, so check all of them again.
+                    bool fKeysAdded = nGeneration != nKeyStoreGeneration;
+                    for (size_t posInBlock = 0; posInBlock < block.vtx.size(); ++posInBlock) {
+                        if (fKeysAdded || vMine[posInBlock] || IsRelatedToWallet(*block.vtx[posInBlock]))
+                            AddToWalletIfInvolvingMe(block.vtx[posInBlock], pindex, posInBlock, fUpdate);
+                    }
+                } else {
+                    ret = pindex;
                 }
-            } else {
-                ret = pindex;
             }
-            pindex = chainActive.Next(pindex);
         }
         if (pindex && fAbortRescan) {
             LogPrintf("Rescan aborted at block %d. Progress=%f\n", pindex->nHeight, GuessVerificationProgress(chainParams.TxData(), pindex));
@@ -1649,6 +1912,18 @@ CBlockIndex* CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool f
     return ret;
 }
 
+bool CWallet::IsRelatedToWallet(const CTransaction& tx) const
+{
+    AssertLockHeld(cs_wallet);
+    if (mapWallet.count(tx.GetHash()))
+        return true;
+    for (const CTxIn& txin : tx.vin) {
+        if (mapWallet.count(txin.prevout.hash) || mapTxSpends.count(txin.prevout))
+            return true;
+    }
+    return false;
+}
+
 void CWallet::ReacceptWalletTransactions()
 {
     // If transactions aren't being broadcasted, don't let them into local mempool either
@@ -1718,6 +1993,7 @@ std::set<uint256> CWalletTx::GetConflicts() const
 
 CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 {
+    RefreshCacheGeneration();
     if (tx->vin.empty())
         return 0;
 
@@ -1749,6 +2025,7 @@ CAmount CWalletTx::GetDebit(const isminefilter& filter) const
 
 CAmount CWalletTx::GetCredit(const isminefilter& filter) const
 {
+    RefreshCacheGeneration();
     // Must wait until coinbase is safely deep enough in the chain before valuing it
     if (IsCoinBase() && GetBlocksToMaturity() > 0)
         return 0;
@@ -1782,6 +2059,7 @@ CAmount CWalletTx::GetCredit(const isminefilter& filter) const
 
 CAmount CWalletTx::GetImmatureCredit(bool fUseCache) const
 {
+    RefreshCacheGeneration();
     if (IsCoinBase() && GetBlocksToMaturity() > 0 && IsInMainChain())
     {
         if (fUseCache && fImmatureCreditCached)
@@ -1796,6 +2074,7 @@ CAmount CWalletTx::GetImmatureCredit(bool fUseCache) const
 
 CAmount CWalletTx::GetAvailableCredit(bool fUseCache) const
 {
+    RefreshCacheGeneration();
     if (pwallet == 0)
         return 0;
 
@@ -1826,6 +2105,7 @@ CAmount CWalletTx::GetAvailableCredit(bool fUseCache) const
 
 CAmount CWalletTx::GetImmatureWatchOnlyCredit(const bool& fUseCache) const
 {
+    RefreshCacheGeneration();
     if (IsCoinBase() && GetBlocksToMaturity() > 0 && IsInMainChain())
     {
         if (fUseCache && fImmatureWatchCreditCached)
@@ -1840,6 +2120,7 @@ CAmount CWalletTx::GetImmatureWatchOnlyCredit(const bool& fUseCache) const
 
 CAmount CWalletTx::GetAvailableWatchOnlyCredit(const bool& fUseCache) const
 {
+    RefreshCacheGeneration();
     if (pwallet == 0)
         return 0;
 
@@ -1867,8 +2148,55 @@ CAmount CWalletTx::GetAvailableWatchOnlyCredit(const bool& fUseCache) const
     return nCredit;
 }
 
+CWalletBalance CWalletTx::GetBalances() const
+{
+    CWalletBalance balance;
+    if (IsTrusted()) {
+        balance.nTrusted = GetAvailableCredit(false);
+        balance.nWatchTrusted = GetAvailableWatchOnlyCredit(false);
+    } else if (GetDepthInMainChain() == 0 && InMempool()) {
+        balance.nUntrustedPending = GetAvailableCredit(false);
+        balance.nWatchUntrustedPending = GetAvailableWatchOnlyCredit(false);
+    }
+    balance.nImmature = GetImmatureCredit(false);
+    balance.nWatchImmature = GetImmatureWatchOnlyCredit(false);
+    return balance;
+}
+
+void CWalletTx::RefreshCacheGeneration() const
+{
+    if (!pwallet || nCacheGeneration == pwallet->GetTxCacheGeneration())
+        return;
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    nCacheGeneration = pwallet->GetTxCacheGeneration();
+}
+
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
+}
+
 CAmount CWalletTx::GetChange() const
 {
+    RefreshCacheGeneration();
     if (fChangeCached)
         return nChangeCached;
     nChangeCached = pwallet->GetChange(*this);
@@ -1885,7 +2213,14 @@ bool CWalletTx::InMempool() const
 bool CWalletTx::IsTrusted() const
 {
     // Quick answer in most cases
-    if (!CheckFinalTx(*this))
+    bool fFinal;
+    if (pwallet) {
+        fFinal = pwallet->CheckFinalTxAtTip(*this);
+    } else {
+        LOCK(cs_main);
+        fFinal = CheckFinalTx(*this, STANDARD_LOCKTIME_VERIFY_FLAGS);
+    }
+    if (!fFinal)
         return false;
     int nDepth = GetDepthInMainChain();
     if (nDepth >= 1)
@@ -1981,94 +2316,267 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman
  */
 
 
-CAmount CWallet::GetBalance() const
+/** Balance states of a wallet transaction. Only BALANCE_STABLE transactions
+ * keep the same balances as the chain tip moves. */
+enum WalletBalanceState
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    BALANCE_CONFLICTED,
+    BALANCE_UNCONFIRMED,
+    BALANCE_IMMATURE,
+    BALANCE_STABLE,
+};
+
+static int GetBalanceState(const CWalletTx& wtx)
+{
+    int nDepth = wtx.GetDepthInMainChain();
+    if (nDepth < 0)
+        return BALANCE_CONFLICTED;
+    if (nDepth == 0)
+        return BALANCE_UNCONFIRMED;
+    if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0)
+        return BALANCE_IMMATURE;
+    return BALANCE_STABLE;
+}
+
+void CWallet::UpdateChainSnapshot()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    pindexSnapshotTip = chainActive.Tip();
+    for (std::pair<const uint256, CWalletTx>& item : mapWallet) {
+        CWalletTx& wtx = item.second;
+        const CBlockIndex* pindex = nullptr;
+        if (!wtx.hashUnset()) {
+            BlockMap::const_iterator mi = mapBlockIndex.find(wtx.hashBlock);
+            if (mi != mapBlockIndex.end())
+                pindex = mi->second;
+        }
+        if (pindex != wtx.pindexBlock) {
+            wtx.pindexBlock = pindex;
+            wtx.MarkDirty();
         }
     }
+}
+
+int CWallet::GetSnapshotDepth(const CMerkleTx& tx, const CBlockIndex* &pindexRet) const
+{
+    if (tx.hashUnset())
+        return 0;
+
+    LOCK(cs_wallet);
+
+    // The block it claims to be in must be on the chain up to the snapshot tip
+    const CBlockIndex* pindex = tx.pindexBlock;
+    if (!pindex || !pindexSnapshotTip || pindex->GetBlockHash() != tx.hashBlock)
+        return 0;
+    if (pindexSnapshotTip->GetAncestor(pindex->nHeight) != pindex)
+        return 0;
 
-    return nTotal;
+    pindexRet = pindex;
+    return ((tx.nIndex == -1) ? (-1) : 1) * (pindexSnapshotTip->nHeight - pindex->nHeight + 1);
 }
 
-CAmount CWallet::GetUnconfirmedBalance() const
+int CWallet::GetSnapshotHeight() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
+    LOCK(cs_wallet);
+    return pindexSnapshotTip ? pindexSnapshotTip->nHeight : -1;
+}
+
+bool CWallet::CheckFinalTxAtTip(const CTransaction& tx) const
+{
+    // As CheckFinalTx() with STANDARD_LOCKTIME_VERIFY_FLAGS, which the mempool
+    // accepts transactions by: time locks are compared against the median time
+    // past of the tip the next block would build on
+    LOCK(cs_wallet);
+    if (!pindexSnapshotTip)
+        return IsFinalTx(tx, 0, GetAdjustedTime());
+    return IsFinalTx(tx, pindexSnapshotTip->nHeight + 1, pindexSnapshotTip->GetMedianTimePast());
+}
+
+void CWallet::MarkBalanceDirty(const uint256& hash) const
+{
+    LOCK(cs_wallet);
+    if (!fBalanceFullRecalc)
+        setBalanceDirty.insert(hash);
+}
+
+void CWallet::UpdateTxBalance(const uint256& hash, const CWalletTx& wtx) const
+{
+    if (wtx.fBalanceCounted) {
+        balanceStable -= wtx.balanceCounted;
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++)
+            mapCoinsStable.erase(std::make_pair(wtx.tx->vout[i].nValue, COutPoint(hash, i)));
+        wtx.fBalanceCounted = false;
+    }
+
+    int nState = GetBalanceState(wtx);
+    if (nState == BALANCE_STABLE) {
+        mapBalanceVolatile.erase(hash);
+        wtx.balanceCounted = wtx.GetBalances();
+        wtx.fBalanceCounted = true;
+        balanceStable += wtx.balanceCounted;
+        for (unsigned int i = 0; i < wtx.tx->vout.size(); i++) {
+            if (IsSpent(hash, i))
+                continue;
+            isminetype mine = IsMine(wtx.tx->vout[i]);
+            if (mine != ISMINE_NO)
+                mapCoinsStable.emplace(std::make_pair(wtx.tx->vout[i].nValue, COutPoint(hash, i)), std::make_pair(&wtx, mine));
         }
+    } else {
+        mapBalanceVolatile[hash] = nState;
     }
-    return nTotal;
 }
 
-CAmount CWallet::GetImmatureBalance() const
+void CWallet::UpdateTxHeight(const CWalletTx& wtx) const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
+    if (wtx.nHeightIndexed >= 0) {
+        std::pair<TxsByHeight::iterator, TxsByHeight::iterator> range = mapTxsByHeight.equal_range(std::make_pair(wtx.nHeightIndexed, wtx.nOrderPos));
+        for (TxsByHeight::iterator it = range.first; it != range.second; ++it) {
+            if (it->second == &wtx) {
+                mapTxsByHeight.erase(it);
+                break;
+            }
         }
     }
-    return nTotal;
+
+    const CBlockIndex* pindex = nullptr;
+    int nDepth = wtx.GetDepthInMainChain(pindex);
+    wtx.nHeightIndexed = nDepth > 0 ? pindex->nHeight : std::numeric_limits<int>::max();
+    mapTxsByHeight.emplace(std::make_pair(wtx.nHeightIndexed, wtx.nOrderPos), &wtx);
 }
 
-CAmount CWallet::GetWatchOnlyBalance() const
+void CWallet::UpdateBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
+    AssertLockHeld(cs_wallet);
+
+    if (fBalanceFullRecalc) {
+        balanceStable = CWalletBalance();
+        mapCoinsStable.clear();
+        setBalanceDirty.clear();
+        mapBalanceVolatile.clear();
+        mapTxsByHeight.clear();
+        for (const std::pair<const uint256, CWalletTx>& item : mapWallet) {
+            item.second.fBalanceCounted = false;
+            item.second.nHeightIndexed = -1;
+            UpdateTxBalance(item.first, item.second);
+            UpdateTxHeight(item.second);
+        }
+        fBalanceFullRecalc = false;
+        pindexBalanceTip = pindexSnapshotTip;
+        return;
+    }
+
+    // A stable coinbase becomes immature again when the tip moves back to a
+    // lower height without its own block being disconnected (invalidateblock,
+    // or a reorg to a shorter chain). Re-evaluate those that are immature at
+    // the new tip; their heights in mapTxsByHeight are still current.
+    if (pindexBalanceTip && (!pindexSnapshotTip || pindexSnapshotTip->GetAncestor(pindexBalanceTip->nHeight) != pindexBalanceTip)) {
+        int nMatureHeight = (pindexSnapshotTip ? pindexSnapshotTip->nHeight : -1) - COINBASE_MATURITY;
+        TxsByHeight::const_iterator it = mapTxsByHeight.lower_bound(std::make_pair(nMatureHeight + 1, std::numeric_limits<int64_t>::min()));
+        for (; it != mapTxsByHeight.end(); ++it) {
+            if (it->second->IsCoinBase())
+                setBalanceDirty.insert(it->second->GetHash());
         }
     }
 
-    return nTotal;
+    // A volatile transaction can change state when the tip moves without the
+    // transaction itself being touched: a coinbase matures, or the block a
+    // conflict was mined in is disconnected. Whether it spends its inputs may
+    // have changed as well, so re-evaluate the transactions it spends from too.
+    for (std::map<uint256, int>::iterator it = mapBalanceVolatile.begin(); pindexBalanceTip != pindexSnapshotTip && it != mapBalanceVolatile.end(); ) {
+        std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(it->first);
+        if (mi == mapWallet.end()) {
+            it = mapBalanceVolatile.erase(it);
+            continue;
+        }
+        if (GetBalanceState(mi->second) != it->second) {
+            setBalanceDirty.insert(it->first);
+            for (const CTxIn& txin : mi->second.tx->vin)
+                setBalanceDirty.insert(txin.prevout.hash);
+        }
+        ++it;
+    }
+
+    for (const uint256& hash : setBalanceDirty) {
+        std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+        if (mi != mapWallet.end()) {
+            UpdateTxBalance(hash, mi->second);
+            UpdateTxHeight(mi->second);
+        }
+    }
+    setBalanceDirty.clear();
+    pindexBalanceTip = pindexSnapshotTip;
 }
 
-CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
+CWalletBalance CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
+    CWalletBalance balance;
     {
-        LOCK2(cs_main, cs_wallet);
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
+        LOCK(cs_wallet);
+        UpdateBalances();
+        balance = balanceStable;
+        for (const std::pair<const uint256, int>& item : mapBalanceVolatile)
+            balance += mapWallet.at(item.first).GetBalances();
+
+        if (fCheckWalletBalance)
+            assert(balance == ComputeBalances());
     }
-    return nTotal;
+    return balance;
 }
 
-CAmount CWallet::GetImmatureWatchOnlyBalance() const
+std::vector<const CWalletTx*> CWallet::GetTransactionsAfterHeight(int nHeight) const
+{
+    AssertLockHeld(cs_wallet);
+    UpdateBalances();
+
+    std::vector<const CWalletTx*> vTxs;
+    TxsByHeight::const_iterator it = mapTxsByHeight.lower_bound(std::make_pair(nHeight + 1, std::numeric_limits<int64_t>::min()));
+    for (; it != mapTxsByHeight.end(); ++it) {
+        vTxs.push_back(it->second);
+    }
+    return vTxs;
+}
+
+CWalletBalance CWallet::ComputeBalances() const
 {
-    CAmount nTotal = 0;
+    CWalletBalance balance;
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
         for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
+            balance += it->second.GetBalances();
     }
-    return nTotal;
+    return balance;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nTrusted;
+}
+
+CAmount CWallet::GetUnconfirmedBalance() const
+{
+    return GetBalances().nUntrustedPending;
+}
+
+CAmount CWallet::GetImmatureBalance() const
+{
+    return GetBalances().nImmature;
+}
+
+CAmount CWallet::GetWatchOnlyBalance() const
+{
+    return GetBalances().nWatchTrusted;
+}
+
+CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
+{
+    return GetBalances().nWatchUntrustedPending;
+}
+
+CAmount CWallet::GetImmatureWatchOnlyBalance() const
+{
+    return GetBalances().nWatchImmature;
 }
 
 // Calculate total balance in a different way from GetBalance. The biggest
@@ -2079,13 +2587,13 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
 // trusted.
 CAmount CWallet::GetLegacyBalance(const isminefilter& filter, int minDepth, const std::string* account) const
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     CAmount balance = 0;
     for (const auto& entry : mapWallet) {
         const CWalletTx& wtx = entry.second;
         const int depth = wtx.GetDepthInMainChain();
-        if (depth < 0 || !CheckFinalTx(*wtx.tx) || wtx.GetBlocksToMaturity() > 0) {
+        if (depth < 0 || !CheckFinalTxAtTip(*wtx.tx) || wtx.GetBlocksToMaturity() > 0) {
             continue;
         }
 
@@ -2116,7 +2624,7 @@ CAmount CWallet::GetLegacyBalance(const isminefilter& filter, int minDepth, cons
 
 CAmount CWallet::GetAvailableBalance(const CCoinControl* coinControl) const
 {
-    LOCK2(cs_main, cs_wallet);
+    LOCK(cs_wallet);
 
     CAmount balance = 0;
     std::vector<COutput> vCoins;
@@ -2134,16 +2642,61 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
     vCoins.clear();
 
     {
-        LOCK2(cs_main, cs_wallet);
+        LOCK(cs_wallet);
+        UpdateBalances();
 
         CAmount nTotal = 0;
 
-        for (std::map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        // Returns true once nMinimumSumAmount or nMaximumCount is reached
+        auto addCoin = [&](const CWalletTx* pcoin, unsigned int i, int nDepth, isminetype mine, bool safeTx) {
+            bool fSpendableIn = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
+            bool fSolvableIn = (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO;
+
+            vCoins.push_back(COutput(pcoin, i, nDepth, fSpendableIn, fSolvableIn, safeTx));
+
+            // Checks the sum amount of all UTXO's.
+            if (nMinimumSumAmount != MAX_MONEY) {
+                nTotal += pcoin->tx->vout[i].nValue;
+
+                if (nTotal >= nMinimumSumAmount) {
+                    return true;
+                }
+            }
+
+            // Checks the maximum number of UTXO's.
+            return nMaximumCount > 0 && vCoins.size() >= nMaximumCount;
+        };
+
+        // Unspent outputs of confirmed mature transactions, which are final
+        // and trusted, are indexed by amount.
+        for (CoinsByAmount::const_iterator it = mapCoinsStable.lower_bound(std::make_pair(nMinimumAmount, COutPoint(uint256(), 0)));
+             it != mapCoinsStable.end() && it->first.first <= nMaximumAmount; ++it)
+        {
+            const COutPoint& outpoint = it->first.second;
+            const CWalletTx* pcoin = it->second.first;
+
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(outpoint))
+                continue;
+
+            if (IsLockedCoin(outpoint.hash, outpoint.n))
+                continue;
+
+            int nDepth = pcoin->GetDepthInMainChain();
+            if (nDepth < nMinDepth || nDepth > nMaxDepth)
+                continue;
+
+            if (addCoin(pcoin, outpoint.n, nDepth, it->second.second, true))
+                return;
+        }
+
+        // The state of all other transactions depends on the chain tip and
+        // the mempool, so check them in full.
+        for (const std::pair<const uint256, int>& item : mapBalanceVolatile)
         {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+            const uint256& wtxid = item.first;
+            const CWalletTx* pcoin = &mapWallet.at(wtxid);
 
-            if (!CheckFinalTx(*pcoin))
+            if (!CheckFinalTxAtTip(*pcoin))
                 continue;
 
             if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
@@ -2202,10 +2755,10 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
                 if (pcoin->tx->vout[i].nValue < nMinimumAmount || pcoin->tx->vout[i].nValue > nMaximumAmount)
                     continue;
 
-                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint((*it).first, i)))
+                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(COutPoint(wtxid, i)))
                     continue;
 
-                if (IsLockedCoin((*it).first, i))
+                if (IsLockedCoin(wtxid, i))
                     continue;
 
                 if (IsSpent(wtxid, i))
@@ -2217,24 +2770,8 @@ void CWallet::AvailableCoins(std::vector<COutput> &vCoins, bool fOnlySafe, const
                     continue;
                 }
 
-                bool fSpendableIn = ((mine & ISMINE_SPENDABLE) != ISMINE_NO) || (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO);
-                bool fSolvableIn = (mine & (ISMINE_SPENDABLE | ISMINE_WATCH_SOLVABLE)) != ISMINE_NO;
-
-                vCoins.push_back(COutput(pcoin, i, nDepth, fSpendableIn, fSolvableIn, safeTx));
-
-                // Checks the sum amount of all UTXO's.
-                if (nMinimumSumAmount != MAX_MONEY) {
-                    nTotal += pcoin->tx->vout[i].nValue;
-
-                    if (nTotal >= nMinimumSumAmount) {
-                        return;
-                    }
-                }
-
-                // Checks the maximum number of UTXO's.
-                if (nMaximumCount > 0 && vCoins.size() >= nMaximumCount) {
+                if (addCoin(pcoin, i, nDepth, mine, safeTx))
                     return;
-                }
             }
         }
     }
@@ -2528,23 +3065,34 @@ bool CWallet::SignTransaction(CMutableTransaction &tx)
 {
     AssertLockHeld(cs_wallet); // mapWallet
 
-    // sign the new tx
-    CTransaction txNewConst(tx);
-    int nIn = 0;
+    std::vector<const CTxOut*> vSpent;
     for (const auto& input : tx.vin) {
         std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(input.prevout.hash);
         if(mi == mapWallet.end() || input.prevout.n >= mi->second.tx->vout.size()) {
             return false;
         }
-        const CScript& scriptPubKey = mi->second.tx->vout[input.prevout.n].scriptPubKey;
-        const CAmount& amount = mi->second.tx->vout[input.prevout.n].nValue;
-        SignatureData sigdata;
-        if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, amount, SIGHASH_ALL), scriptPubKey, sigdata)) {
-            return false;
-        }
-        UpdateTransaction(tx, nIn, sigdata);
-        nIn++;
+        vSpent.push_back(&mi->second.tx->vout[input.prevout.n]);
     }
+
+    // sign the new tx
+    CTransaction txNewConst(tx);
+    return SignInputs(txNewConst, vSpent, tx);
+}
+
+bool CWallet::SignInputs(const CTransaction& txTo, const std::vector<const CTxOut*>& vSpent, CMutableTransaction& txOut) const
+{
+    const PrecomputedTransactionData txdata(txTo);
+    std::vector<SignatureData> vSigData(txTo.vin.size());
+    std::atomic<bool> fSigned(true);
+    ForEachTxInput(txTo, [&](unsigned int nIn) {
+        if (!ProduceSignature(TransactionSignatureCreator(this, &txTo, nIn, vSpent[nIn]->nValue, SIGHASH_ALL, &txdata), vSpent[nIn]->scriptPubKey, vSigData[nIn]))
+            fSigned = false;
+    });
+    if (!fSigned)
+        return false;
+
+    for (unsigned int nIn = 0; nIn < txTo.vin.size(); nIn++)
+        UpdateTransaction(txOut, nIn, vSigData[nIn]);
     return true;
 }
 
@@ -2914,22 +3462,15 @@ bool CWallet::CreateTransaction(const std::vector<CRecipient>& vecSend, CWalletT
 
         if (sign)
         {
-            CTransaction txNewConst(txNew);
-            int nIn = 0;
+            std::vector<const CTxOut*> vSpent;
             for (const auto& coin : setCoins)
-            {
-                const CScript& scriptPubKey = coin.txout.scriptPubKey;
-                SignatureData sigdata;
+                vSpent.push_back(&coin.txout);
 
-                if (!ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, coin.txout.nValue, SIGHASH_ALL), scriptPubKey, sigdata))
-                {
-                    strFailReason = _("Signing transaction failed");
-                    return false;
-                } else {
-                    UpdateTransaction(txNew, nIn, sigdata);
-                }
-
-                nIn++;
+            CTransaction txNewConst(txNew);
+            if (!SignInputs(txNewConst, vSpent, txNew))
+            {
+                strFailReason = _("Signing transaction failed");
+                return false;
             }
         }
 
@@ -3137,6 +3678,9 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     DBErrors nZapSelectTxRet = CWalletDB(*dbw,"cr+").ZapSelectTx(vHashIn, vHashOut);
     for (uint256 hash : vHashOut)
         mapWallet.erase(hash);
+    // The incremental balance state and mapTxsByHeight point into mapWallet,
+    // rebuild them even if the database reported an error
+    MarkDirty();
 
     if (nZapSelectTxRet == DB_NEED_REWRITE)
     {
@@ -3154,8 +3698,6 @@ DBErrors CWallet::ZapSelectTx(std::vector<uint256>& vHashIn, std::vector<uint256
     if (nZapSelectTxRet != DB_LOAD_OK)
         return nZapSelectTxRet;
 
-    MarkDirty();
-
     return DB_LOAD_OK;
 
 }
@@ -3326,28 +3868,35 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
             // don't create extra internal keys
             missingInternal = 0;
         }
-        bool internal = false;
         CWalletDB walletdb(*dbw);
-        for (int64_t i = missingInternal + missingExternal; i--;)
-        {
-            if (i < missingInternal) {
-                internal = true;
-            }
-
-            assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
-            int64_t index = ++m_max_keypool_index;
-
-            CPubKey pubkey(GenerateNewKey(walletdb, internal));
-            if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
-                throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
-            }
+        for (bool internal : {false, true}) {
+            int64_t nMissing = internal ? missingInternal : missingExternal;
+            while (nMissing > 0) {
+                int64_t nBatch = std::min(nMissing, KEYPOOL_BATCH_SIZE);
+                nMissing -= nBatch;
+
+                // Write the keys, their metadata and pool entries of each batch in
+                // one transaction; bounded so it fits in the database lock table
+                bool fTxn = walletdb.TxnBegin();
+                for (const CPubKey& pubkey : GenerateNewKeys(walletdb, nBatch, internal)) {
+                    assert(m_max_keypool_index < std::numeric_limits<int64_t>::max()); // How in the hell did you use so many keys?
+                    int64_t index = ++m_max_keypool_index;
+
+                    if (!walletdb.WritePool(index, CKeyPool(pubkey, internal))) {
+                        throw std::runtime_error(std::string(__func__) + ": writing generated key failed");
+                    }
 
-            if (internal) {
-                setInternalKeyPool.insert(index);
-            } else {
-                setExternalKeyPool.insert(index);
+                    if (internal) {
+                        setInternalKeyPool.insert(index);
+                    } else {
+                        setExternalKeyPool.insert(index);
+                    }
+                    m_pool_key_to_index[pubkey.GetID()] = index;
+                }
+                if (fTxn && !walletdb.TxnCommit()) {
+                    throw std::runtime_error(std::string(__func__) + ": committing generated keys failed");
+                }
             }
-            m_pool_key_to_index[pubkey.GetID()] = index;
         }
         if (missingInternal + missingExternal > 0) {
             LogPrintf("keypool added %d keys (%d internal), size=%u (%u internal)\n", missingInternal + missingExternal, missingInternal, setInternalKeyPool.size() + setExternalKeyPool.size(), setInternalKeyPool.size());
@@ -3906,6 +4455,7 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     strUsage += HelpMessageOpt("-paytxfee=<amt>", strprintf(_("Fee (in %s/kB) to add to transactions you send (default: %s)"),
                                                             CURRENCY_UNIT, FormatMoney(payTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-rescan", _("Rescan the block chain for missing wallet transactions on startup"));
+    strUsage += HelpMessageOpt("-rescanthreads=<n>", strprintf(_("Number of threads reading blocks ahead of a rescan (1 to %d, default: %d)"), MAX_RESCAN_THREADS, DEFAULT_RESCAN_THREADS));
     strUsage += HelpMessageOpt("-salvagewallet", _("Attempt to recover private keys from a corrupt wallet on startup"));
     strUsage += HelpMessageOpt("-spendzeroconfchange", strprintf(_("Spend unconfirmed change when sending transactions (default: %u)"), DEFAULT_SPEND_ZEROCONF_CHANGE));
     strUsage += HelpMessageOpt("-txconfirmtarget=<n>", strprintf(_("If paytxfee is not set, include enough fee so transactions begin confirmation on average within n blocks (default: %u)"), DEFAULT_TX_CONFIRM_TARGET));
@@ -3922,9 +4472,11 @@ std::string CWallet::GetWalletHelpString(bool showDebug)
     {
         strUsage += HelpMessageGroup(_("Wallet debugging/testing options:"));
 
+        strUsage += HelpMessageOpt("-checkwalletbalance", strprintf("Check the incrementally maintained wallet balances against every wallet transaction on each balance query (default: %u, regtest: 1)", DEFAULT_CHECK_WALLET_BALANCE));
         strUsage += HelpMessageOpt("-dblogsize=<n>", strprintf("Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)", DEFAULT_WALLET_DBLOGSIZE));
         strUsage += HelpMessageOpt("-flushwallet", strprintf("Run a thread to flush wallet periodically (default: %u)", DEFAULT_FLUSHWALLET));
         strUsage += HelpMessageOpt("-privdb", strprintf("Sets the DB_PRIVATE flag in the wallet db environment (default: %u)", DEFAULT_WALLET_PRIVDB));
+        strUsage += HelpMessageOpt("-walletloadthreads=<n>", strprintf("Number of threads decoding wallet records on load (0 = one per core, default: %d)", DEFAULT_WALLET_LOAD_THREADS));
         strUsage += HelpMessageOpt("-walletrejectlongchains", strprintf(_("Wallet will not create transactions that violate mempool chain limits (default: %u)"), DEFAULT_WALLET_REJECT_LONG_CHAINS));
     }
 
@@ -4042,7 +4594,12 @@ CWallet* CWallet::CreateWalletFromFile(const std::string walletFile)
 
     LogPrintf(" wallet      %15dms\n", GetTimeMillis() - nStart);
 
-    RegisterValidationInterface(walletInstance);
+    RegisterValidationInterface(walletInstance, "wallet:" + walletFile);
+
+    {
+        LOCK2(cs_main, walletInstance->cs_wallet);
+        walletInstance->UpdateChainSnapshot();
+    }
 
     // Try to top up keypool. No-op if the wallet is locked.
     walletInstance->TopUpKeyPool();
@@ -4272,6 +4829,7 @@ bool CWallet::ParameterInteraction()
     nTxConfirmTarget = gArgs.GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     bSpendZeroConfChange = gArgs.GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     fWalletRbf = gArgs.GetBoolArg("-walletrbf", DEFAULT_WALLET_RBF);
+    fCheckWalletBalance = gArgs.GetBoolArg("-checkwalletbalance", Params().DefaultConsistencyChecks());
 
     return true;
 }
@@ -4304,6 +4862,7 @@ void CMerkleTx::SetMerkleBranch(const CBlockIndex* pindex, int posInBlock)
 {
     // Update the tx's hashBlock
     hashBlock = pindex->GetBlockHash();
+    pindexBlock = pindex;
 
     // set the position of the transaction in the block
     nIndex = posInBlock;
@@ -4328,6 +4887,14 @@ int CMerkleTx::GetDepthInMainChain(const CBlockIndex* &pindexRet) const
     return ((nIndex == -1) ? (-1) : 1) * (chainActive.Height() - pindex->nHeight + 1);
 }
 
+int CWalletTx::GetDepthInMainChain(const CBlockIndex* &pindexRet) const
+{
+    // Transactions not bound to a wallet have no chain snapshot to use
+    if (!pwallet)
+        return CMerkleTx::GetDepthInMainChain(pindexRet);
+    return pwallet->GetSnapshotDepth(*this, pindexRet);
+}
+
 int CMerkleTx::GetBlocksToMaturity() const
 {
     if (!IsCoinBase())
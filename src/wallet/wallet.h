@@ -40,8 +40,13 @@ extern CFeeRate payTxFee;
 extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 extern bool fWalletRbf;
+extern bool fCheckWalletBalance;
 
 static const unsigned int DEFAULT_KEYPOOL_SIZE = 1000;
+//! Maximum number of keys written in one database transaction when topping up the keypool
+static const int64_t KEYPOOL_BATCH_SIZE = 1000;
+//! Minimum number of HD keys per derivation thread
+static const size_t MIN_KEYS_PER_DERIVE_THREAD = 64;
 //! -paytxfee default
 static const CAmount DEFAULT_TRANSACTION_FEE = 0;
 //! -fallbackfee default
@@ -66,6 +71,12 @@ static const unsigned int DEFAULT_TX_CONFIRM_TARGET = 6;
 static const bool DEFAULT_WALLET_RBF = false;
 static const bool DEFAULT_WALLETBROADCAST = true;
 static const bool DEFAULT_DISABLE_WALLET = false;
+//! -rescanthreads default
+static const int DEFAULT_RESCAN_THREADS = 4;
+//! Maximum number of threads reading blocks ahead of a rescan
+static const int MAX_RESCAN_THREADS = 16;
+//! -checkwalletbalance default outside regtest
+static const bool DEFAULT_CHECK_WALLET_BALANCE = false;
 //! if set, all keys will be derived by using BIP32
 static const bool DEFAULT_USE_HD_WALLET = true;
 
@@ -185,6 +196,47 @@ struct COutputEntry
     int vout;
 };
 
+/** Wallet balance buckets, as reported by getwalletinfo */
+struct CWalletBalance
+{
+    CAmount nTrusted;               //!< available credit of trusted transactions
+    CAmount nUntrustedPending;      //!< available credit of untrusted transactions in the mempool
+    CAmount nImmature;              //!< credit of immature coinbase transactions
+    CAmount nWatchTrusted;
+    CAmount nWatchUntrustedPending;
+    CAmount nWatchImmature;
+
+    CWalletBalance() : nTrusted(0), nUntrustedPending(0), nImmature(0), nWatchTrusted(0), nWatchUntrustedPending(0), nWatchImmature(0) {}
+
+    CWalletBalance& operator+=(const CWalletBalance& b)
+    {
+        nTrusted += b.nTrusted;
+        nUntrustedPending += b.nUntrustedPending;
+        nImmature += b.nImmature;
+        nWatchTrusted += b.nWatchTrusted;
+        nWatchUntrustedPending += b.nWatchUntrustedPending;
+        nWatchImmature += b.nWatchImmature;
+        return *this;
+    }
+
+    CWalletBalance& operator-=(const CWalletBalance& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUntrustedPending -= b.nUntrustedPending;
+        nImmature -= b.nImmature;
+        nWatchTrusted -= b.nWatchTrusted;
+        nWatchUntrustedPending -= b.nWatchUntrustedPending;
+        nWatchImmature -= b.nWatchImmature;
+        return *this;
+    }
+
+    friend bool operator==(const CWalletBalance& a, const CWalletBalance& b)
+    {
+        return a.nTrusted == b.nTrusted && a.nUntrustedPending == b.nUntrustedPending && a.nImmature == b.nImmature &&
+               a.nWatchTrusted == b.nWatchTrusted && a.nWatchUntrustedPending == b.nWatchUntrustedPending && a.nWatchImmature == b.nWatchImmature;
+    }
+};
+
 /** A transaction with a merkle branch linking it to the block chain. */
 class CMerkleTx
 {
@@ -203,6 +255,9 @@ public:
      */
     int nIndex;
 
+    //! block index entry of hashBlock, set along with it; not serialized
+    const CBlockIndex* pindexBlock;
+
     CMerkleTx()
     {
         SetTx(MakeTransactionRef());
@@ -223,6 +278,7 @@ public:
     {
         hashBlock = uint256();
         nIndex = -1;
+        pindexBlock = nullptr;
     }
 
     void SetTx(CTransactionRef arg)
@@ -239,6 +295,8 @@ public:
         READWRITE(hashBlock);
         READWRITE(vMerkleBranch);
         READWRITE(nIndex);
+        if (ser_action.ForRead())
+            pindexBlock = nullptr;
     }
 
     void SetMerkleBranch(const CBlockIndex* pIndex, int posInBlock);
@@ -249,7 +307,7 @@ public:
      *  0  : in memory pool, waiting to be included in a block
      * >=1 : this many blocks deep in the main chain
      */
-    int GetDepthInMainChain(const CBlockIndex* &pindexRet) const;
+    virtual int GetDepthInMainChain(const CBlockIndex* &pindexRet) const;
     int GetDepthInMainChain() const { const CBlockIndex *pindexRet; return GetDepthInMainChain(pindexRet); }
     bool IsInMainChain() const { const CBlockIndex *pindexRet; return GetDepthInMainChain(pindexRet) > 0; }
     int GetBlocksToMaturity() const;
@@ -257,7 +315,7 @@ public:
     bool AcceptToMemoryPool(const CAmount& nAbsurdFee, CValidationState& state);
     bool hashUnset() const { return (hashBlock.IsNull() || hashBlock == ABANDON_HASH); }
     bool isAbandoned() const { return (hashBlock == ABANDON_HASH); }
-    void setAbandoned() { hashBlock = ABANDON_HASH; }
+    void setAbandoned() { hashBlock = ABANDON_HASH; pindexBlock = nullptr; }
 
     const uint256& GetHash() const { return tx->GetHash(); }
     bool IsCoinBase() const { return tx->IsCoinBase(); }
@@ -340,6 +398,13 @@ public:
     mutable CAmount nImmatureWatchCreditCached;
     mutable CAmount nAvailableWatchCreditCached;
     mutable CAmount nChangeCached;
+    //! wallet cache generation the cached amounts above belong to, see CWallet::MarkDirty()
+    mutable uint64_t nCacheGeneration;
+    //! balanceCounted and our unspent outputs are included in the wallet's stable totals and coins
+    mutable bool fBalanceCounted;
+    mutable CWalletBalance balanceCounted;
+    //! height this transaction is indexed at in the wallet's mapTxsByHeight, -1 if not indexed
+    mutable int nHeightIndexed;
 
     CWalletTx()
     {
@@ -379,6 +444,10 @@ public:
         nAvailableWatchCreditCached = 0;
         nImmatureWatchCreditCached = 0;
         nChangeCached = 0;
+        nCacheGeneration = 0;
+        fBalanceCounted = false;
+        balanceCounted = CWalletBalance();
+        nHeightIndexed = -1;
         nOrderPos = -1;
     }
 
@@ -426,18 +495,9 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty();
+    //! drop cached amounts left over from before the last CWallet::MarkDirty()
+    void RefreshCacheGeneration() const;
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -453,6 +513,8 @@ public:
     CAmount GetImmatureWatchOnlyCredit(const bool& fUseCache=true) const;
     CAmount GetAvailableWatchOnlyCredit(const bool& fUseCache=true) const;
     CAmount GetChange() const;
+    //! this transaction's contribution to each wallet balance bucket, never cached
+    CWalletBalance GetBalances() const;
 
     void GetAmounts(std::list<COutputEntry>& listReceived,
                     std::list<COutputEntry>& listSent, CAmount& nFee, std::string& strSentAccount, const isminefilter& filter) const;
@@ -465,6 +527,13 @@ public:
     // True if only scriptSigs are different
     bool IsEquivalentTo(const CWalletTx& tx) const;
 
+    /**
+     * Depth in the chain as the wallet was last notified of it, see
+     * CWallet::GetSnapshotDepth(). Only needs the wallet's cs_wallet.
+     */
+    using CMerkleTx::GetDepthInMainChain;
+    int GetDepthInMainChain(const CBlockIndex* &pindexRet) const override;
+
     bool InMempool() const;
     bool IsTrusted() const;
 
@@ -658,6 +727,10 @@ private:
     static std::atomic<bool> fFlushScheduled;
     std::atomic<bool> fAbortRescan;
     std::atomic<bool> fScanningWallet;
+    //! Incremented whenever keys, scripts or watch-only scripts are added
+    std::atomic<uint64_t> nKeyStoreGeneration;
+    //! Incremented by MarkDirty() to invalidate every transaction's cached amounts
+    std::atomic<uint64_t> nTxCacheGeneration;
 
     /**
      * Select a set of coins such that nValueRet >= nTargetValue and at least
@@ -697,12 +770,30 @@ private:
      * Should be called with pindexBlock and posInBlock if this is for a transaction that is included in a block. */
     void SyncTransaction(const CTransactionRef& tx, const CBlockIndex *pindex = nullptr, int posInBlock = 0);
 
+    /* Whether tx is in the wallet, spends from it or conflicts with it. With
+     * IsMine(tx), this covers every transaction AddToWalletIfInvolvingMe adds. */
+    bool IsRelatedToWallet(const CTransaction& tx) const;
+
     /* the HD chain data model (external chain counters) */
     CHDChain hdChain;
 
     /* HD derive new child key (on internal or external chain) */
     void DeriveNewChildKey(CWalletDB &walletdb, CKeyMetadata& metadata, CKey& secret, bool internal = false);
 
+    /* m/0'/0' and m/0'/1' of hdChainKeysMaster, cached while the wallet is unlocked */
+    CExtKey hdChainKeys[2];
+    bool fHDChainKeyCached[2];
+    CKeyID hdChainKeysMaster;
+
+    /* Get the (cached) key of the internal or external chain */
+    CExtKey GetHDChainKey(bool internal);
+    /* Erase the cached chain keys from memory */
+    void WipeHDChainKeys();
+    /* Generate and store nKeys new keys in one go, deriving HD keys on multiple threads */
+    std::vector<CPubKey> GenerateNewKeys(CWalletDB& walletdb, size_t nKeys, bool internal);
+
+    bool RemoveWatchOnlyWithDB(CWalletDB& walletdb, const CScript& dest);
+
     std::set<int64_t> setInternalKeyPool;
     std::set<int64_t> setExternalKeyPool;
     int64_t m_max_keypool_index;
@@ -710,6 +801,45 @@ private:
 
     int64_t nTimeFirstKey;
 
+    /**
+     * Incrementally maintained balances and spendable coins, see GetBalances()
+     * and AvailableCoins(). Confirmed mature transactions are summed into
+     * balanceStable, their unspent outputs indexed in mapCoinsStable, and they
+     * are only re-evaluated when marked dirty. All other transactions are kept
+     * in mapBalanceVolatile with their balance state and re-evaluated on every
+     * query, as they change with the chain tip and the mempool.
+     *
+     * The same dirty tracking maintains mapTxsByHeight, which orders every
+     * transaction by the height of the block confirming it and its order
+     * position. Unconfirmed and conflicted transactions sort last.
+     */
+    mutable CWalletBalance balanceStable;
+    typedef std::map<std::pair<CAmount, COutPoint>, std::pair<const CWalletTx*, isminetype>> CoinsByAmount;
+    mutable CoinsByAmount mapCoinsStable;
+    mutable std::set<uint256> setBalanceDirty;
+    mutable std::map<uint256, int> mapBalanceVolatile;
+    mutable bool fBalanceFullRecalc;
+    typedef std::multimap<std::pair<int, int64_t>, const CWalletTx*> TxsByHeight;
+    mutable TxsByHeight mapTxsByHeight;
+    //! snapshot tip volatile balance states were last evaluated at
+    mutable const CBlockIndex* pindexBalanceTip;
+
+    /**
+     * Tip of the chain as of the last block the wallet was notified of.
+     * Transaction depths are computed from it and the block index entry each
+     * transaction keeps of its block, so that reading wallet state does not
+     * need cs_main. Block index entries are never freed while wallets are
+     * loaded, and the fields used are not changed once an entry is added.
+     */
+    const CBlockIndex* pindexSnapshotTip;
+
+    /** Move a transaction between balanceStable/mapCoinsStable and mapBalanceVolatile */
+    void UpdateTxBalance(const uint256& hash, const CWalletTx& wtx) const;
+    /** Re-index a transaction in mapTxsByHeight */
+    void UpdateTxHeight(const CWalletTx& wtx) const;
+    /** Process dirty transactions and balance state changes of volatile ones */
+    void UpdateBalances() const;
+
     /**
      * Private version of AddWatchOnly method which does not accept a
      * timestamp, and which will reset the wallet's nTimeFirstKey value to 1 if
@@ -788,11 +918,17 @@ public:
         nNextResend = 0;
         nLastResend = 0;
         m_max_keypool_index = 0;
+        fBalanceFullRecalc = true;
+        nTxCacheGeneration = 0;
+        pindexBalanceTip = nullptr;
+        pindexSnapshotTip = nullptr;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
         nRelockTime = 0;
         fAbortRescan = false;
         fScanningWallet = false;
+        nKeyStoreGeneration = 0;
+        fHDChainKeyCached[0] = fHDChainKeyCached[1] = false;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -854,6 +990,8 @@ public:
     void AbortRescan() { fAbortRescan = true; }
     bool IsAbortingRescan() { return fAbortRescan; }
     bool IsScanning() { return fScanningWallet; }
+    uint64_t GetKeyStoreGeneration() const { return nKeyStoreGeneration; }
+    uint64_t GetTxCacheGeneration() const { return nTxCacheGeneration; }
 
     /**
      * keystore implementation
@@ -898,6 +1036,7 @@ public:
     //! Holds a timestamp at which point the wallet is scheduled (externally) to be relocked. Caller must arrange for actual relocking to occur via Lock().
     int64_t nRelockTime;
 
+    bool Lock() override;
     bool Unlock(const SecureString& strWalletPassphrase);
     bool ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase, const SecureString& strNewWalletPassphrase);
     bool EncryptWallet(const SecureString& strWalletPassphrase);
@@ -914,6 +1053,8 @@ public:
     bool AccountMove(std::string strFrom, std::string strTo, CAmount nAmount, std::string strComment = "");
     bool GetAccountPubkey(CPubKey &pubKey, std::string strAccount, bool bForceNew = false);
 
+    /** Invalidate all cached amounts and balances. Constant time: each
+     * transaction drops its cached amounts the next time they are read. */
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFlushOnClose=true);
     bool LoadToWallet(const CWalletTx& wtxIn);
@@ -927,6 +1068,26 @@ public:
     void ResendWalletTransactions(int64_t nBestBlockTime, CConnman* connman) override;
     // ResendWalletTransactionsBefore may only be called if fBroadcastTransactions!
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime, CConnman* connman);
+    /** Set the chain snapshot tip to the active chain's and look up the block of every transaction. Requires cs_main */
+    void UpdateChainSnapshot();
+    /** Depth of a transaction on the wallet's chain snapshot, see CMerkleTx::GetDepthInMainChain() */
+    int GetSnapshotDepth(const CMerkleTx& tx, const CBlockIndex* &pindexRet) const;
+    /** Height of the chain snapshot's tip, -1 if there is none */
+    int GetSnapshotHeight() const;
+    /** CheckFinalTx() for the block after the chain snapshot's tip */
+    bool CheckFinalTxAtTip(const CTransaction& tx) const;
+    /** Queue a wallet transaction's balance to be re-evaluated by the next GetBalances() */
+    void MarkBalanceDirty(const uint256& hash) const;
+    /** All balance buckets, updated in O(changed transactions) */
+    CWalletBalance GetBalances() const;
+    /** All balance buckets, summed over every wallet transaction. Used by -checkwalletbalance */
+    CWalletBalance ComputeBalances() const;
+    /**
+     * Transactions with fewer confirmations than a transaction in the block at
+     * nHeight would have: those confirmed in later blocks, unconfirmed and
+     * conflicted ones. Ordered by height and order position, unconfirmed last.
+     */
+    std::vector<const CWalletTx*> GetTransactionsAfterHeight(int nHeight) const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
@@ -942,6 +1103,8 @@ public:
      */
     bool FundTransaction(CMutableTransaction& tx, CAmount& nFeeRet, int& nChangePosInOut, std::string& strFailReason, bool lockUnspents, const std::set<int>& setSubtractFeeFromOutputs, CCoinControl);
     bool SignTransaction(CMutableTransaction& tx);
+    /** Sign every input of txTo, spending *vSpent[i] in input i, on multiple threads; store the signatures in txOut */
+    bool SignInputs(const CTransaction& txTo, const std::vector<const CTxOut*>& vSpent, CMutableTransaction& txOut) const;
 
     /**
      * Create a new transaction paying the recipients with a set of coins
@@ -246,15 +246,126 @@ public:
     }
 };
 
-bool
-ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
+/** A wallet database record, with the parts DecodeRecord could decode on its own */
+struct CWalletRecord
+{
+    CDataStream ssKey;
+    CDataStream ssValue;
+    std::string strType;
+    //! decoding failed, the record is corrupt
+    bool fCorrupt;
+    std::string strErr;
+    //! "tx": the checked transaction
+    uint256 hash;
+    CWalletTx wtx;
+    //! "key" and "wkey": the checked key pair
+    CPubKey vchPubKey;
+    CKey key;
+
+    CWalletRecord(CDataStream&& ssKeyIn, CDataStream&& ssValueIn) : ssKey(std::move(ssKeyIn)), ssValue(std::move(ssValueIn)), fCorrupt(false) {}
+};
+
+/**
+ * Read the type of a record and decode transactions and keys, which dominate
+ * wallet load time. Touches no wallet state, so records can be decoded on
+ * multiple threads.
+ */
+static void DecodeRecord(CWalletRecord& rec)
+{
+    try {
+        rec.ssKey >> rec.strType;
+        if (rec.strType == "tx")
+        {
+            rec.ssKey >> rec.hash;
+            rec.ssValue >> rec.wtx;
+            CValidationState state;
+            if (!(CheckTransaction(rec.wtx, state) && (rec.wtx.GetHash() == rec.hash) && state.IsValid()))
+                rec.fCorrupt = true;
+        }
+        else if (rec.strType == "key" || rec.strType == "wkey")
+        {
+            rec.ssKey >> rec.vchPubKey;
+            if (!rec.vchPubKey.IsValid())
+            {
+                rec.strErr = "Error reading wallet database: CPubKey corrupt";
+                rec.fCorrupt = true;
+                return;
+            }
+            CPrivKey pkey;
+            uint256 hash;
+
+            if (rec.strType == "key")
+            {
+                rec.ssValue >> pkey;
+            } else {
+                CWalletKey wkey;
+                rec.ssValue >> wkey;
+                pkey = wkey.vchPrivKey;
+            }
+
+            // Old wallets store keys as "key" [pubkey] => [privkey]
+            // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
+            // using EC operations as a checksum.
+            // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
+            // remaining backwards-compatible.
+            try
+            {
+                rec.ssValue >> hash;
+            }
+            catch (...) {}
+
+            bool fSkipCheck = false;
+
+            if (!hash.IsNull())
+            {
+                // hash pubkey/privkey to accelerate wallet load
+                std::vector<unsigned char> vchKey;
+                vchKey.reserve(rec.vchPubKey.size() + pkey.size());
+                vchKey.insert(vchKey.end(), rec.vchPubKey.begin(), rec.vchPubKey.end());
+                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
+
+                if (Hash(vchKey.begin(), vchKey.end()) != hash)
+                {
+                    rec.strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+                    rec.fCorrupt = true;
+                    return;
+                }
+
+                fSkipCheck = true;
+            }
+
+            if (!rec.key.Load(pkey, rec.vchPubKey, fSkipCheck))
+            {
+                rec.strErr = "Error reading wallet database: CPrivKey corrupt";
+                rec.fCorrupt = true;
+            }
+        }
+    } catch (...) {
+        rec.fCorrupt = true;
+    }
+}
+
+/** Decode records on as many threads as are worthwhile, up to nMaxThreads (0 for no limit) */
+static void DecodeRecords(std::vector<CWalletRecord>& vRecords, size_t nMaxThreads)
+{
+    ParallelFor("walletload", vRecords.size(), MIN_RECORDS_PER_LOAD_THREAD, nMaxThreads, [&vRecords](size_t i) {
+        DecodeRecord(vRecords[i]);
+    });
+}
+
+/** Load a decoded record into the wallet */
+static bool
+ReadKeyValue(CWallet* pwallet, CWalletRecord& rec,
              CWalletScanState &wss, std::string& strType, std::string& strErr)
 {
+    strType = rec.strType;
+    strErr = rec.strErr;
+    if (rec.fCorrupt)
+        return false;
+
+    CDataStream& ssKey = rec.ssKey;
+    CDataStream& ssValue = rec.ssValue;
     try {
-        // Unserialize
-        // Taking advantage of the fact that pair serialization
-        // is just the two items serialized one after the other
-        ssKey >> strType;
         if (strType == "name")
         {
             std::string strAddress;
@@ -269,13 +380,8 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
-            CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
-                return false;
+            const uint256& hash = rec.hash;
+            CWalletTx& wtx = rec.wtx;
 
             // Undo serialize changes in 31600
             if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
@@ -332,63 +438,9 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "key" || strType == "wkey")
         {
-            CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            if (!vchPubKey.IsValid())
-            {
-                strErr = "Error reading wallet database: CPubKey corrupt";
-                return false;
-            }
-            CKey key;
-            CPrivKey pkey;
-            uint256 hash;
-
             if (strType == "key")
-            {
                 wss.nKeys++;
-                ssValue >> pkey;
-            } else {
-                CWalletKey wkey;
-                ssValue >> wkey;
-                pkey = wkey.vchPrivKey;
-            }
-
-            // Old wallets store keys as "key" [pubkey] => [privkey]
-            // ... which was slow for wallets with lots of keys, because the public key is re-derived from the private key
-            // using EC operations as a checksum.
-            // Newer wallets store keys as "key"[pubkey] => [privkey][hash(pubkey,privkey)], which is much faster while
-            // remaining backwards-compatible.
-            try
-            {
-                ssValue >> hash;
-            }
-            catch (...) {}
-
-            bool fSkipCheck = false;
-
-            if (!hash.IsNull())
-            {
-                // hash pubkey/privkey to accelerate wallet load
-                std::vector<unsigned char> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
-                vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
-
-                if (Hash(vchKey.begin(), vchKey.end()) != hash)
-                {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                    return false;
-                }
-
-                fSkipCheck = true;
-            }
-
-            if (!key.Load(pkey, vchPubKey, fSkipCheck))
-            {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
-                return false;
-            }
-            if (!pwallet->LoadKey(key, vchPubKey))
+            if (!pwallet->LoadKey(rec.key, rec.vchPubKey))
             {
                 strErr = "Error reading wallet database: LoadKey failed";
                 return false;
@@ -515,6 +567,15 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+bool
+ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
+             CWalletScanState &wss, std::string& strType, std::string& strErr)
+{
+    CWalletRecord rec(std::move(ssKey), std::move(ssValue));
+    DecodeRecord(rec);
+    return ReadKeyValue(pwallet, rec, wss, strType, strErr);
+}
+
 bool CWalletDB::IsKeyType(const std::string& strType)
 {
     return (strType== "key" || strType == "wkey" ||
@@ -546,39 +607,57 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
-        while (true)
+        // Read records in batches, decode the transactions and keys of each
+        // batch on multiple threads, then load them in database order
+        int nLoadThreads = std::max(0, (int)gArgs.GetArg("-walletloadthreads", DEFAULT_WALLET_LOAD_THREADS));
+        bool fDone = false;
+        while (!fDone)
         {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-            int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue);
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0)
+            std::vector<CWalletRecord> vRecords;
+            vRecords.reserve(WALLET_LOAD_BATCH_SIZE);
+            while (vRecords.size() < WALLET_LOAD_BATCH_SIZE)
             {
-                LogPrintf("Error reading next record from wallet database\n");
-                return DB_CORRUPT;
+                // Read next record
+                CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+                CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+                int ret = batch.ReadAtCursor(pcursor, ssKey, ssValue);
+                if (ret == DB_NOTFOUND)
+                {
+                    fDone = true;
+                    break;
+                }
+                else if (ret != 0)
+                {
+                    LogPrintf("Error reading next record from wallet database\n");
+                    return DB_CORRUPT;
+                }
+                vRecords.emplace_back(std::move(ssKey), std::move(ssValue));
             }
 
-            // Try to be tolerant of single corrupt records:
-            std::string strType, strErr;
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
+            DecodeRecords(vRecords, nLoadThreads);
+
+            for (CWalletRecord& rec : vRecords)
             {
-                // losing keys is considered a catastrophic error, anything else
-                // we assume the user can live with:
-                if (IsKeyType(strType))
-                    result = DB_CORRUPT;
-                else
+                // Try to be tolerant of single corrupt records:
+                std::string strType, strErr;
+                if (!ReadKeyValue(pwallet, rec, wss, strType, strErr))
                 {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx")
-                        // Rescan if there is a bad transaction record:
-                        gArgs.SoftSetBoolArg("-rescan", true);
+                    // losing keys is considered a catastrophic error, anything else
+                    // we assume the user can live with:
+                    if (IsKeyType(strType))
+                        result = DB_CORRUPT;
+                    else
+                    {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (strType == "tx")
+                            // Rescan if there is a bad transaction record:
+                            gArgs.SoftSetBoolArg("-rescan", true);
+                    }
                 }
+                if (!strErr.empty())
+                    LogPrintf("%s\n", strErr);
             }
-            if (!strErr.empty())
-                LogPrintf("%s\n", strErr);
         }
         pcursor->close();
     }
@@ -34,6 +34,12 @@
  */
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Number of records read from the wallet database before decoding them in parallel
+static const size_t WALLET_LOAD_BATCH_SIZE = 10000;
+//! Minimum number of records per decoding thread
+static const size_t MIN_RECORDS_PER_LOAD_THREAD = 500;
+//! -walletloadthreads default, 0 for one thread per core
+static const int DEFAULT_WALLET_LOAD_THREADS = 0;
 
 class CAccount;
 class CAccountingEntry;
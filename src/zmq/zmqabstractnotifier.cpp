@@ -21,3 +21,8 @@ bool CZMQAbstractNotifier::NotifyTransaction(const CTransaction &/*transaction*/
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyFloData(const CTransaction &/*transaction*/, const uint256 &/*hashBlock*/)
+{
+    return true;
+}
@@ -8,15 +8,21 @@
 
 #include "zmqconfig.h"
 
+#include <atomic>
+
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class uint256;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+/** Default ZMQ_SNDHWM of a notifier's socket */
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    CZMQAbstractNotifier() : nNextSequence(0), nQueued(0), psocket(0), nSequence(0), nHighWaterMark(DEFAULT_ZMQ_SNDHWM), nDropped(0) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -29,17 +35,41 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    int GetOutboundMessageHighWaterMark() const { return nHighWaterMark; }
+    void SetOutboundMessageHighWaterMark(int hwm) { if (hwm >= 0) nHighWaterMark = hwm; }
+    /** Set the sequence number of the message published next */
+    void SetSequence(uint32_t n) { nSequence = n; }
+    uint64_t GetDropped() const { return nDropped; }
+    void AddDropped() { nDropped++; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
+    /** Whether NotifyBlock and NotifyTransaction publish anything; notifications
+     * are only queued for notifiers that handle them */
+    virtual bool NotifiesBlocks() const { return false; }
+    virtual bool NotifiesTransactions() const { return false; }
+    virtual bool NotifiesFloData() const { return false; }
+
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    /** Called for transactions with floData, once when they enter the mempool
+     * (hashBlock is null) and once when a block containing them is connected */
+    virtual bool NotifyFloData(const CTransaction &transaction, const uint256 &hashBlock);
+
+    //! Sequence number given to the next queued message, guarded by the notification interface's queue lock
+    uint32_t nNextSequence;
+    //! Number of messages waiting in the publish queue, guarded by the notification interface's queue lock
+    size_t nQueued;
 
 protected:
     void *psocket;
     std::string type;
     std::string address;
+    uint32_t nSequence; //!< sequence number of the message being published
+    int nHighWaterMark;
+    //! Messages dropped because the publish queue or the socket was full
+    std::atomic<uint64_t> nDropped;
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
@@ -11,12 +11,16 @@
 #include "streams.h"
 #include "util.h"
 
+#include <algorithm>
+
+CZMQNotificationInterface* g_zmq_notification_interface = nullptr;
+
 void zmqError(const char *str)
 {
     LogPrint(BCLog::ZMQ, "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr)
+CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(nullptr), nMaxQueueSize(DEFAULT_ZMQ_QUEUE_SIZE), fStopping(false)
 {
 }
 
@@ -40,6 +44,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     factories["pubhashtx"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionNotifier>;
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
+    factories["pubhashflodata"] = CZMQAbstractNotifier::Create<CZMQPublishHashFloDataNotifier>;
+    factories["pubrawflodata"] = CZMQAbstractNotifier::Create<CZMQPublishRawFloDataNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -51,6 +57,7 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(i->first);
             notifier->SetAddress(address);
+            notifier->SetOutboundMessageHighWaterMark(gArgs.GetArg(arg + "hwm", DEFAULT_ZMQ_SNDHWM));
             notifiers.push_back(notifier);
         }
     }
@@ -59,6 +66,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::Create()
     {
         notificationInterface = new CZMQNotificationInterface();
         notificationInterface->notifiers = notifiers;
+        notificationInterface->nMaxQueueSize = std::max(gArgs.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE), (int64_t)1);
+        notificationInterface->vFloDataPrefixes = gArgs.GetArgs("-zmqflodataprefix");
 
         if (!notificationInterface->Initialize())
         {
@@ -104,6 +113,7 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    threadPublish = std::thread(&TraceThread<std::function<void()> >, "zmqpub", std::function<void()>(std::bind(&CZMQNotificationInterface::ThreadPublish, this)));
     return true;
 }
 
@@ -111,6 +121,15 @@ bool CZMQNotificationInterface::Initialize()
 void CZMQNotificationInterface::Shutdown()
 {
     LogPrint(BCLog::ZMQ, "zmq: Shutdown notification interface\n");
+    if (threadPublish.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(cs);
+            fStopping = true;
+        }
+        cond.notify_all();
+        threadPublish.join();
+    }
     if (pcontext)
     {
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
@@ -125,59 +144,126 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CZMQNotificationInterface::Enqueue(HandlesFunc handles, const NotifyFunc& notify)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
-
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        std::lock_guard<std::mutex> lock(cs);
+        for (CZMQAbstractNotifier* notifier : notifiers)
         {
-            i++;
-        }
-        else
-        {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            if (!(notifier->*handles)())
+                continue;
+            uint32_t nSequence = notifier->nNextSequence++;
+            if (queue.size() >= nMaxQueueSize)
+            {
+                notifier->AddDropped();
+                continue;
+            }
+            notifier->nQueued++;
+            queue.push_back(QueuedNotification{notifier, nSequence, notify});
         }
     }
+    cond.notify_one();
 }
 
-void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+void CZMQNotificationInterface::EnqueueTransaction(const CTransactionRef& ptx)
 {
-    // Used by BlockConnected and BlockDisconnected as well, because they're
-    // all the same external callback.
-    const CTransaction& tx = *ptx;
+    Enqueue(&CZMQAbstractNotifier::NotifiesTransactions, [ptx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransaction(*ptx); });
+}
+
+void CZMQNotificationInterface::EnqueueFloData(const CTransactionRef& ptx, const uint256& hashBlock)
+{
+    const std::string& strFloData = ptx->strFloData;
+    if (strFloData.empty())
+        return;
+    if (!vFloDataPrefixes.empty() && std::none_of(vFloDataPrefixes.begin(), vFloDataPrefixes.end(),
+            [&strFloData](const std::string& prefix) { return strFloData.compare(0, prefix.size(), prefix) == 0; }))
+        return;
+
+    Enqueue(&CZMQAbstractNotifier::NotifiesFloData, [ptx, hashBlock](CZMQAbstractNotifier* notifier) { return notifier->NotifyFloData(*ptx, hashBlock); });
+}
 
-    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+void CZMQNotificationInterface::ThreadPublish()
+{
+    while (true)
     {
-        CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyTransaction(tx))
+        QueuedNotification entry;
         {
-            i++;
+            std::unique_lock<std::mutex> lock(cs);
+            while (!fStopping && queue.empty())
+                cond.wait(lock);
+            // Publish what was queued before shutdown, like sending synchronously would have
+            if (queue.empty())
+                return;
+            entry = std::move(queue.front());
+            queue.pop_front();
+            entry.notifier->nQueued--;
         }
-        else
+
+        CZMQAbstractNotifier *notifier = entry.notifier;
+        notifier->SetSequence(entry.nSequence);
+        if (entry.notify(notifier))
+            continue;
+
+        // Stop using a failed notifier, and drop what was queued for it
         {
-            notifier->Shutdown();
-            i = notifiers.erase(i);
+            std::lock_guard<std::mutex> lock(cs);
+            notifiers.remove(notifier);
+            queue.erase(std::remove_if(queue.begin(), queue.end(),
+                [notifier](const QueuedNotification& n) { return n.notifier == notifier; }), queue.end());
         }
+        notifier->Shutdown();
+        delete notifier;
+    }
+}
+
+std::vector<CZMQNotificationInterface::NotifierInfo> CZMQNotificationInterface::GetNotifierInfo() const
+{
+    std::vector<NotifierInfo> result;
+    std::lock_guard<std::mutex> lock(cs);
+    for (const CZMQAbstractNotifier* notifier : notifiers)
+    {
+        NotifierInfo info;
+        info.type = notifier->GetType();
+        info.address = notifier->GetAddress();
+        info.nHighWaterMark = notifier->GetOutboundMessageHighWaterMark();
+        info.nNextSequence = notifier->nNextSequence;
+        info.nQueued = notifier->nQueued;
+        info.nDropped = notifier->GetDropped();
+        result.push_back(info);
     }
+    return result;
+}
+
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
+        return;
+
+    // Block index entries live until shutdown, so the publisher thread can read the block later
+    Enqueue(&CZMQAbstractNotifier::NotifiesBlocks, [pindexNew](CZMQAbstractNotifier* notifier) { return notifier->NotifyBlock(pindexNew); });
+}
+
+void CZMQNotificationInterface::TransactionAddedToMempool(const CTransactionRef& ptx)
+{
+    EnqueueTransaction(ptx);
+    EnqueueFloData(ptx, uint256());
 }
 
 void CZMQNotificationInterface::BlockConnected(const std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindexConnected, const std::vector<CTransactionRef>& vtxConflicted)
 {
+    const uint256 hashBlock = pblock->GetHash();
     for (const CTransactionRef& ptx : pblock->vtx) {
         // Do a normal notify for each transaction added in the block
-        TransactionAddedToMempool(ptx);
+        EnqueueTransaction(ptx);
+        EnqueueFloData(ptx, hashBlock);
     }
 }
 
 void CZMQNotificationInterface::BlockDisconnected(const std::shared_ptr<const CBlock>& pblock)
 {
     for (const CTransactionRef& ptx : pblock->vtx) {
-        // Do a normal notify for each transaction removed in block disconnection
-        TransactionAddedToMempool(ptx);
+        // Do a normal notify for each transaction removed in block disconnection;
+        // floData is published again if the transaction returns to the mempool
+        EnqueueTransaction(ptx);
     }
 }
@@ -7,12 +7,22 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include "validationinterface.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include <string>
 #include <map>
 #include <list>
+#include <thread>
+#include <vector>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
+class uint256;
+
+/** Default maximum number of notifications waiting to be published */
+static const size_t DEFAULT_ZMQ_QUEUE_SIZE = 10000;
 
 class CZMQNotificationInterface : public CValidationInterface
 {
@@ -21,6 +31,18 @@ public:
 
     static CZMQNotificationInterface* Create();
 
+    /** State of one notifier, as reported by getzmqnotifications */
+    struct NotifierInfo
+    {
+        std::string type;
+        std::string address;
+        int nHighWaterMark;
+        uint32_t nNextSequence;
+        size_t nQueued;
+        uint64_t nDropped;
+    };
+    std::vector<NotifierInfo> GetNotifierInfo() const;
+
 protected:
     bool Initialize();
     void Shutdown();
@@ -34,8 +56,42 @@ protected:
 private:
     CZMQNotificationInterface();
 
+    typedef std::function<bool(CZMQAbstractNotifier*)> NotifyFunc;
+    typedef bool (CZMQAbstractNotifier::*HandlesFunc)() const;
+
+    /** A notification waiting to be published by one notifier */
+    struct QueuedNotification
+    {
+        CZMQAbstractNotifier* notifier;
+        uint32_t nSequence;
+        NotifyFunc notify;
+    };
+
+    /** Queue a notification for each notifier for which handles returns true.
+     * Never blocks: when the queue is full the notification is dropped, still
+     * using up its sequence number. */
+    void Enqueue(HandlesFunc handles, const NotifyFunc& notify);
+    /** Queue hashtx and rawtx notifications */
+    void EnqueueTransaction(const CTransactionRef& ptx);
+    /** Queue floData notifications if the floData matches -zmqflodataprefix */
+    void EnqueueFloData(const CTransactionRef& ptx, const uint256& hashBlock);
+    /** Publisher thread: sends queued notifications until Shutdown */
+    void ThreadPublish();
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+    //! floData prefixes to publish, all floData if empty
+    std::vector<std::string> vFloDataPrefixes;
+
+    //! Protects notifiers (once publishing started), queue and fStopping
+    mutable std::mutex cs;
+    std::condition_variable cond;
+    std::deque<QueuedNotification> queue;
+    size_t nMaxQueueSize;
+    bool fStopping;
+    std::thread threadPublish;
 };
 
+extern CZMQNotificationInterface* g_zmq_notification_interface;
+
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -17,6 +17,8 @@ static const char *MSG_HASHBLOCK = "hashblock";
 static const char *MSG_HASHTX    = "hashtx";
 static const char *MSG_RAWBLOCK  = "rawblock";
 static const char *MSG_RAWTX     = "rawtx";
+static const char *MSG_HASHFLODATA = "hashflodata";
+static const char *MSG_RAWFLODATA  = "rawflodata";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -41,10 +43,11 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 
         data = va_arg(args, const void*);
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
+        rc = zmq_msg_send(&msg, sock, (data ? ZMQ_SNDMORE : 0) | ZMQ_DONTWAIT);
         if (rc == -1)
         {
-            zmqError("Unable to send ZMQ msg");
+            if (errno != EAGAIN)
+                zmqError("Unable to send ZMQ msg");
             zmq_msg_close(&msg);
             va_end(args);
             return -1;
@@ -77,7 +80,17 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        LogPrint(BCLog::ZMQ, "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, nHighWaterMark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &nHighWaterMark, sizeof(nHighWaterMark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -138,12 +151,14 @@ bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* d
     unsigned char msgseq[sizeof(uint32_t)];
     WriteLE32(&msgseq[0], nSequence);
     int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
-        return false;
-
-    /* increment memory only sequence number after sending */
-    nSequence++;
+    if (rc == -1) {
+        if (errno != EAGAIN)
+            return false;
+        // Socket is at its high water mark; subscribers see the gap in sequence numbers
+        AddDropped();
+    }
 
+    /* the sequence number was assigned when the message was queued, see CZMQNotificationInterface */
     return true;
 }
 
@@ -196,3 +211,33 @@ bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &tr
     ss << transaction;
     return SendMessage(MSG_RAWTX, &(*ss.begin()), ss.size());
 }
+
+// Body shared by the floData notifiers: txid followed by the hash of the
+// containing block, or 32 zero bytes for a mempool transaction, both reversed
+// like hashtx and hashblock
+static void WriteFloDataHashes(char *data, const CTransaction &transaction, const uint256 &hashBlock)
+{
+    uint256 hash = transaction.GetHash();
+    for (unsigned int i = 0; i < 32; i++)
+    {
+        data[31 - i] = hash.begin()[i];
+        data[63 - i] = hashBlock.begin()[i];
+    }
+}
+
+bool CZMQPublishHashFloDataNotifier::NotifyFloData(const CTransaction &transaction, const uint256 &hashBlock)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish hashflodata %s (block %s)\n", transaction.GetHash().GetHex(), hashBlock.IsNull() ? "mempool" : hashBlock.GetHex());
+    char data[64];
+    WriteFloDataHashes(data, transaction, hashBlock);
+    return SendMessage(MSG_HASHFLODATA, data, 64);
+}
+
+bool CZMQPublishRawFloDataNotifier::NotifyFloData(const CTransaction &transaction, const uint256 &hashBlock)
+{
+    LogPrint(BCLog::ZMQ, "zmq: Publish rawflodata %s (block %s)\n", transaction.GetHash().GetHex(), hashBlock.IsNull() ? "mempool" : hashBlock.GetHex());
+    std::vector<char> data(64 + transaction.strFloData.size());
+    WriteFloDataHashes(data.data(), transaction, hashBlock);
+    std::copy(transaction.strFloData.begin(), transaction.strFloData.end(), data.begin() + 64);
+    return SendMessage(MSG_RAWFLODATA, data.data(), data.size());
+}
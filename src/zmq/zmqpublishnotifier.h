@@ -12,9 +12,6 @@ class CBlockIndex;
 
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
-private:
-    uint32_t nSequence; //!< upcounting per message sequence number
-
 public:
 
     /* send zmq multipart message
@@ -22,6 +19,7 @@ public:
           * command
           * data
           * message sequence number
+       The message is dropped, not waited for, if the socket is at its high water mark.
     */
     bool SendMessage(const char *command, const void* data, size_t size);
 
@@ -32,25 +30,43 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    bool NotifiesBlocks() const override { return true; }
     bool NotifyBlock(const CBlockIndex *pindex) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    bool NotifiesTransactions() const override { return true; }
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    bool NotifiesBlocks() const override { return true; }
     bool NotifyBlock(const CBlockIndex *pindex) override;
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier
 {
 public:
+    bool NotifiesTransactions() const override { return true; }
     bool NotifyTransaction(const CTransaction &transaction) override;
 };
 
+class CZMQPublishHashFloDataNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifiesFloData() const override { return true; }
+    bool NotifyFloData(const CTransaction &transaction, const uint256 &hashBlock) override;
+};
+
+class CZMQPublishRawFloDataNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifiesFloData() const override { return true; }
+    bool NotifyFloData(const CTransaction &transaction, const uint256 &hashBlock) override;
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
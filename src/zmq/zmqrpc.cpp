@@ -0,0 +1,64 @@
+// Copyright (c) 2018 The Bitcoin Core developers
+// Copyright (c) Flo Developers 2013-2018
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zmq/zmqrpc.h"
+
+#include "rpc/server.h"
+#include "utilstrencodings.h"
+#include "zmq/zmqnotificationinterface.h"
+
+#include <univalue.h>
+
+UniValue getzmqnotifications(const JSONRPCRequest& request)
+{
+    if (request.fHelp || request.params.size() != 0)
+        throw std::runtime_error(
+            "getzmqnotifications\n"
+            "\nReturns information about the active ZeroMQ notifications.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {                        (json object)\n"
+            "    \"type\": \"pubhashtx\",   (string) Type of notification\n"
+            "    \"address\": \"...\",      (string) Address of the publisher\n"
+            "    \"hwm\": n,              (numeric) Outbound message high water mark\n"
+            "    \"sequence\": n,         (numeric) Sequence number the next notification will get\n"
+            "    \"queued\": n,           (numeric) Notifications waiting to be published\n"
+            "    \"dropped\": n           (numeric) Notifications dropped because the publish queue or socket was full\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getzmqnotifications", "")
+            + HelpExampleRpc("getzmqnotifications", "")
+        );
+
+    UniValue result(UniValue::VARR);
+    if (g_zmq_notification_interface != nullptr) {
+        for (const CZMQNotificationInterface::NotifierInfo& info : g_zmq_notification_interface->GetNotifierInfo()) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("type", info.type));
+            obj.push_back(Pair("address", info.address));
+            obj.push_back(Pair("hwm", info.nHighWaterMark));
+            obj.push_back(Pair("sequence", (int64_t)info.nNextSequence));
+            obj.push_back(Pair("queued", (uint64_t)info.nQueued));
+            obj.push_back(Pair("dropped", info.nDropped));
+            result.push_back(obj);
+        }
+    }
+
+    return result;
+}
+
+static const CRPCCommand commands[] =
+{ //  category              name                      actor (function)         okSafeMode
+  //  --------------------- ------------------------  -----------------------  ----------
+    { "zmq",                "getzmqnotifications",    &getzmqnotifications,    true,  {} },
+};
+
+void RegisterZMQRPCCommands(CRPCTable& t)
+{
+    for (unsigned int vcidx = 0; vcidx < ARRAYLEN(commands); vcidx++)
+        t.appendCommand(commands[vcidx].name, &commands[vcidx]);
+}
@@ -99,6 +99,38 @@ class ListTransactionsTest(BitcoinTestFramework):
                            {"txid":txid, "account" : "watchonly"} )
 
         self.run_rbf_opt_in_test()
+        self.run_paging_test()
+
+    # Check that paging with before_txid returns every entry exactly once, in
+    # the same order as a single call, including account moves, which have no
+    # txid to page by.
+    def run_paging_test(self):
+        node = self.nodes[1]
+        # each move lists a debit and a credit entry
+        node.move("", "paging", Decimal("0.1"))
+        node.move("paging", "", Decimal("0.1"))
+        node.sendtoaddress(self.nodes[0].getnewaddress(), 0.1)
+        node.move("", "paging", Decimal("0.2"))
+        everything = node.listtransactions("*", 1000)
+        assert_equal([entry["category"] for entry in everything[-7:]], ["move"] * 4 + ["send"] + ["move"] * 2)
+        listed = []
+        page = node.listtransactions("*", 3)
+        while page:
+            listed = page + listed
+            # a page only ends on a move once it reached the oldest entry
+            if "txid" not in page[0]:
+                break
+            page = node.listtransactions("*", 3, 0, False, page[0]["txid"])
+        assert_equal(listed, everything)
+        # the first page ends on the newest transaction, the next one takes
+        # all the moves before it and ends on a transaction again
+        assert_equal(node.listtransactions("*", 3), everything[-3:])
+        page = node.listtransactions("*", 3, 0, False, everything[-3]["txid"])
+        assert_equal(page[-4:], everything[-7:-3])
+        assert("txid" in page[0])
+        # skip still counts entries from the newest one
+        assert_equal(node.listtransactions("*", 3, 2), everything[-5:-2])
+        assert_raises_jsonrpc(-5, "Invalid or non-wallet transaction id", node.listtransactions, "*", 3, 0, False, "00" * 32)
 
     # Check that the opt-in-rbf flag works properly, for sent and received
     # transactions.
@@ -196,6 +196,14 @@ class RESTTest (BitcoinTestFramework):
         response = http_post_call(url.hostname, url.port, '/rest/getutxos'+json_request+self.FORMAT_SEPARATOR+'json', '', True)
         assert_equal(response.status, 200) #must be a 200 because we are within the limits
 
+        #posted binary requests may batch more outpoints than fit in the URI
+        binaryRequest = b'\x01' + pack("B", 20)
+        for x in range(0, 20):
+            binaryRequest += hex_str_to_bytes(txid)[::-1] + pack("i", n)
+        response = http_post_call(url.hostname, url.port, '/rest/getutxos'+self.FORMAT_SEPARATOR+'bin', binaryRequest, True)
+        assert_equal(response.status, 200)
+        assert_equal(response.read()[36:40], b'\x03\xff\xff\x0f') #all 20 outpoints are unspent in the mempool
+
         self.nodes[0].generate(1) #generate block to not affect upcoming tests
         self.sync_all()
 
@@ -267,6 +275,27 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(response_header_json_str)
         assert_equal(len(json_obj), 5) #now we should have 5 header objects
 
+        #get bb_hash and the 6 blocks after it in one response, by hash and by height
+        response_blocks = http_get_call(url.hostname, url.port, '/rest/blocks/'+bb_hash+'/10'+self.FORMAT_SEPARATOR+"bin", True)
+        assert_equal(response_blocks.status, 200)
+        assert_equal(response_blocks.getheader('transfer-encoding'), 'chunked')
+        response_blocks_str = response_blocks.read()
+        assert_equal(response_blocks_str[0:len(response_str)], response_str)
+        json_string = http_get_call(url.hostname, url.port, '/rest/blocks/height/'+str(block_json_obj['height'])+'/10'+self.FORMAT_SEPARATOR+"json")
+        json_obj = json.loads(json_string)
+        assert_equal(len(json_obj), 7) #the range ends at the tip
+        assert_equal(json_obj[0]['hash'], bb_hash)
+        assert_equal(json_obj[6]['hash'], self.nodes[0].getbestblockhash())
+
+        #look up block hashes by height
+        json_string = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/'+str(block_json_obj['height'])+self.FORMAT_SEPARATOR+"json")
+        assert_equal(json.loads(json_string)['blockhash'], bb_hash)
+        response = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/'+str(block_json_obj['height'])+self.FORMAT_SEPARATOR+"bin", True)
+        assert_equal(response.status, 200)
+        assert_equal(response.read(), hex_str_to_bytes(bb_hash)[::-1])
+        response = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/1000000'+self.FORMAT_SEPARATOR+"json", True)
+        assert_equal(response.status, 404)
+
         # do tx test
         tx_hash = block_json_obj['tx'][0]['txid']
         json_string = http_get_call(url.hostname, url.port, '/rest/tx/'+tx_hash+self.FORMAT_SEPARATOR+"json")
@@ -317,6 +346,35 @@ class RESTTest (BitcoinTestFramework):
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
 
+        # bulk floData extraction, over RPC and REST
+        flo_hash = self.nodes[1].generatetoaddress(1, self.nodes[1].getnewaddress(), 1000000, "rest floData")[0]
+        self.sync_all()
+        flo_height = self.nodes[0].getblockcount()
+        flo_txid = self.nodes[0].getblock(flo_hash)['tx'][0]
+        flodata = self.nodes[0].getblockflodata(flo_height - 10, flo_height)
+        assert_equal(len(flodata), 1)
+        assert_equal(flodata[0]['height'], flo_height)
+        assert_equal(flodata[0]['txid'], flo_txid)
+        assert_equal(flodata[0]['floData'], "rest floData")
+        assert_equal(self.nodes[0].getblockflodata(0, flo_height, 4), self.nodes[0].getblockflodata(0, flo_height))
+        assert_raises_jsonrpc(-8, "Block height out of range", self.nodes[0].getblockflodata, 0, flo_height + 1)
+        assert_raises_jsonrpc(-8, "Block range too large", self.nodes[0].getblockflodata, 0, 10000)
+
+        json_string = http_get_call(url.hostname, url.port, '/rest/blockflodata/'+str(flo_height - 10)+'/'+str(flo_height)+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string, parse_float=Decimal), flodata)
+        response = http_get_call(url.hostname, url.port, '/rest/blockflodata/'+str(flo_height - 10)+'/'+str(flo_height)+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        entry = BytesIO(response.read())
+        assert_equal(unpack("<i", entry.read(4))[0], flo_height)
+        assert_equal(entry.read(32), hex_str_to_bytes(flo_txid)[::-1])
+        entry.read(4 + 8) # outputs and value
+        assert_equal(entry.read(1 + len("rest floData")), b"\x0crest floData")
+        assert_equal(entry.read(), b"")
+        response = http_get_call(url.hostname, url.port, '/rest/blockflodata/0/'+str(flo_height + 1)+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+        response = http_get_call(url.hostname, url.port, '/rest/blockflodata/0/10000'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 400)
+
         #test rest bestblock
         bb_hash = self.nodes[0].getbestblockhash()
 
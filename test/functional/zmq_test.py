@@ -42,7 +42,14 @@ class ZMQTest (BitcoinTestFramework):
         self.zmqSubSocket.setsockopt(zmq.SUBSCRIBE, b"hashtx")
         ip_address = "tcp://127.0.0.1:28332"
         self.zmqSubSocket.connect(ip_address)
-        extra_args = [['-zmqpubhashtx=%s' % ip_address, '-zmqpubhashblock=%s' % ip_address], []]
+        # floData goes to its own socket, filtered on the node by prefix
+        self.zmqFloDataSocket = self.zmqContext.socket(zmq.SUB)
+        self.zmqFloDataSocket.set(zmq.RCVTIMEO, 60000)
+        self.zmqFloDataSocket.setsockopt(zmq.SUBSCRIBE, b"rawflodata")
+        flodata_address = "tcp://127.0.0.1:28333"
+        self.zmqFloDataSocket.connect(flodata_address)
+        extra_args = [['-zmqpubhashtx=%s' % ip_address, '-zmqpubhashblock=%s' % ip_address,
+                       '-zmqpubrawflodata=%s' % flodata_address, '-zmqflodataprefix=test:'], []]
         self.nodes = self.start_nodes(self.num_nodes, self.options.tmpdir, extra_args)
 
     def run_test(self):
@@ -111,5 +118,29 @@ class ZMQTest (BitcoinTestFramework):
 
         assert_equal(hashRPC, hashZMQ)  # txid from sendtoaddress must be equal to the hash received over zmq
 
+        self.log.info("Wait for floData from mempool and block")
+        self.nodes[1].sendtoaddress(address=self.nodes[0].getnewaddress(), amount=1.0, floData="other:skipped")
+        hashRPC = self.nodes[1].sendtoaddress(address=self.nodes[0].getnewaddress(), amount=1.0, floData="test:published")
+        self.sync_all()
+
+        # only the transaction matching -zmqflodataprefix is published, first from the mempool
+        msg = self.zmqFloDataSocket.recv_multipart()
+        assert_equal(msg[0], b"rawflodata")
+        body = msg[1]
+        assert_equal(bytes_to_hex_str(body[:32]), hashRPC)
+        assert_equal(body[32:64], b"\x00" * 32)
+        assert_equal(body[64:], b"test:published")
+        assert_equal(struct.unpack('<I', msg[-1])[-1], 0)
+
+        # and again when it is mined
+        genhashes = self.nodes[1].generate(1)
+        self.sync_all()
+        msg = self.zmqFloDataSocket.recv_multipart()
+        body = msg[1]
+        assert_equal(bytes_to_hex_str(body[:32]), hashRPC)
+        assert_equal(bytes_to_hex_str(body[32:64]), genhashes[0])
+        assert_equal(body[64:], b"test:published")
+        assert_equal(struct.unpack('<I', msg[-1])[-1], 1)
+
 if __name__ == '__main__':
     ZMQTest().main()